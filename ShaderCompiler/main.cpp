@@ -77,8 +77,6 @@ static const std::array SHADER_DEFS = std::to_array<ShaderDef>({
     { "DEF_SUBDIVISION", std::to_string(Constants::SUBDIVISION) },
     { "DEF_SOLID_DECAY", std::to_string(Constants::LightDecay(true)) },
     { "DEF_AIR_DECAY", std::to_string(Constants::LightDecay(false)) },
-    { "CHUNK_WIDTH", std::to_string(Constants::RENDER_CHUNK_SIZE_U) },
-    { "CHUNK_HEIGHT", std::to_string(Constants::RENDER_CHUNK_SIZE_U) },
     { "TILE_SIZE", std::to_string(Constants::TILE_SIZE) },
     { "WALL_SIZE", std::to_string(Constants::WALL_SIZE) },
 });
@@ -189,6 +189,7 @@ const std::pair<ShaderAsset, AssetShader> SHADER_ASSETS[] = {
     { ShaderAsset::ParticleShader,       AssetShader("particle",     ShaderStages::Vertex | ShaderStages::Fragment, { VertexFormatAsset::ParticleVertex,  VertexFormatAsset::ParticleInstance  }) },
     { ShaderAsset::StaticLightMapShader, AssetShader("lightmap",     ShaderStages::Vertex | ShaderStages::Fragment, VertexFormatAsset::StaticLightMapVertex ) },
     { ShaderAsset::FontShader,           AssetShader("font",         ShaderStages::Fragment,                        {}) },
+    { ShaderAsset::ChunkImpostorShader,  AssetShader("impostor",     ShaderStages::Vertex | ShaderStages::Fragment, { VertexFormatAsset::TilemapVertex,   VertexFormatAsset::ChunkImpostorInstance }) },
 };
 
 const std::pair<ComputeShaderAsset, AssetComputeShader> COMPUTE_SHADER_ASSETS[] = {
@@ -418,12 +419,17 @@ void Assets::InitVertexFormats() {
     });
 
     LLGL::VertexFormat tilemap_instance_format = sge::Attributes(backend, tilemap_vertex_format.attributes.size(), {
-        sge::Attribute::Instance(LLGL::Format::RG32Float, "i_atlas_pos", "I_AtlasPos", 1),
-        sge::Attribute::Instance(LLGL::Format::RG32Float, "i_world_pos", "I_WorldPos", 1),
-        sge::Attribute::Instance(LLGL::Format::R16UInt, "i_position", "I_Position", 1),
+        sge::Attribute::Instance(LLGL::Format::RG16UInt, "i_tile_pos", "I_TilePos", 1),
+        sge::Attribute::Instance(LLGL::Format::RG8UInt, "i_atlas_pos", "I_AtlasPos", 1),
         sge::Attribute::Instance(LLGL::Format::R16UInt, "i_tile_data", "I_TileData", 1),
     });
 
+    LLGL::VertexFormat chunk_impostor_instance_format = sge::Attributes(backend, tilemap_vertex_format.attributes.size(), {
+        sge::Attribute::Instance(LLGL::Format::RG16UInt, "i_tile_pos", "I_TilePos", 1),
+        sge::Attribute::Instance(LLGL::Format::R16UInt, "i_size", "I_Size", 1),
+        sge::Attribute::Instance(LLGL::Format::R16UInt, "i_layer", "I_Layer", 1),
+    });
+
     LLGL::VertexFormat background_vertex_format = sge::Attributes(backend, {
         sge::Attribute::Vertex(LLGL::Format::RG32Float, "a_position", "Position"),
         sge::Attribute::Vertex(LLGL::Format::RG32Float, "a_texture_size", "TextureSize")
@@ -470,6 +476,7 @@ void Assets::InitVertexFormats() {
     state.vertex_formats[VertexFormatAsset::ParticleInstance] = particle_instance_format;
     state.vertex_formats[VertexFormatAsset::PostProcessVertex] = postprocess_vertex_format;
     state.vertex_formats[VertexFormatAsset::StaticLightMapVertex] = static_lightmap_vertex_format;
+    state.vertex_formats[VertexFormatAsset::ChunkImpostorInstance] = chunk_impostor_instance_format;
 }
 
 void Assets::DestroyTextures() {
@@ -73,7 +73,8 @@ enum class ShaderAsset : uint8_t {
     BackgroundShader,
     ParticleShader,
     StaticLightMapShader,
-    FontShader
+    FontShader,
+    ChunkImpostorShader
 };
 
 enum class ComputeShaderAsset : uint8_t {
@@ -97,6 +98,7 @@ enum class VertexFormatAsset : uint8_t {
     ParticleInstance,
     PostProcessVertex,
     StaticLightMapVertex,
+    ChunkImpostorInstance,
 };
 
 constexpr uint32_t PARTICLES_ATLAS_COLUMNS = 100;
@@ -22,12 +22,12 @@ namespace Constants {
 #else
     constexpr float CAMERA_MIN_ZOOM = 1.5f;
 #endif
+    // From this zoom out the chunks are drawn as impostors with a texel per tile
+    constexpr float CHUNK_LOD_ZOOM = 3.0f;
 
     constexpr float TILE_TEXTURE_PADDING = 2.0f;
     constexpr float WALL_TEXTURE_PADDING = 4.0f;
 
-    constexpr float RENDER_CHUNK_SIZE = 50.0f;
-    constexpr uint8_t RENDER_CHUNK_SIZE_U = 50u;
     constexpr int SUBDIVISION = 8;
     constexpr float LIGHT_EPSILON = 0.01;
 
@@ -0,0 +1,144 @@
+#include "chunk_benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+#include <fmt/base.h>
+
+#include "../constants.hpp"
+#include "../world/chunk_mesh_builder.hpp"
+#include "../world/chunk_size.hpp"
+
+static constexpr int STEADY_ITERATIONS = 1000;
+
+// The free camera speed at 60 FPS
+static constexpr float PAN_STEP = 2000.0f / 60.0f;
+
+struct Timings {
+    double total = 0.0;
+    double max = 0.0;
+    int count = 0;
+
+    void add(double seconds) {
+        total += seconds;
+        max = std::max(max, seconds);
+        count++;
+    }
+};
+
+static double time_manage_chunks(ChunkManager& chunk_manager, const WorldData& world, const sge::Camera& camera) {
+    const auto start = std::chrono::steady_clock::now();
+    chunk_manager.manage_chunks(world, camera);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static void print_timings(const char* name, const Timings& timings) {
+    fmt::println("  {:<8} {:>6} calls   mean {:8.2f} us   max {:8.2f} us",
+        name, timings.count, timings.total / timings.count * 1e6, timings.max * 1e6);
+}
+
+// Counts the walls of the visible chunks that are culled because blocks cover them
+static void print_wall_culling(const ChunkManager& chunk_manager, const WorldData& world) {
+    using Constants::WALL_SIZE;
+
+    const uint32_t chunk_size = ChunkSize::Get();
+
+    uint32_t walls = 0;
+    uint32_t hidden_walls = 0;
+
+    for (const RenderChunk* chunk : chunk_manager.visible_chunks()) {
+        const glm::uvec2 offset = chunk->index() * chunk_size;
+
+        for (uint32_t y = 0; y < chunk_size; ++y) {
+            for (uint32_t x = 0; x < chunk_size; ++x) {
+                const TilePos pos = TilePos(offset.x + x, offset.y + y);
+                if (!world.get_wall(pos).has_value()) continue;
+
+                walls++;
+                if (wall_is_hidden(world, pos)) hidden_walls++;
+            }
+        }
+    }
+
+    const float culled_percent = walls > 0 ? hidden_walls * 100.0f / walls : 0.0f;
+    const float saved_mpx = hidden_walls * WALL_SIZE * WALL_SIZE / 1e6f;
+
+    fmt::println("walls in view: {} instances, {} culled ({:.1f}%), {} drawn, {:.2f} Mpx of wall quads saved per frame at zoom 1",
+        walls, hidden_walls, culled_percent, walls - hidden_walls, saved_mpx);
+}
+
+// Compares the instances drawn for the visible chunks with the tiles and with the impostors
+static void print_lod(const ChunkManager& chunk_manager, const ChunkImpostorStats& prev_stats) {
+    uint32_t tile_instances = 0;
+    for (const RenderChunk* chunk : chunk_manager.visible_chunks()) {
+        tile_instances += chunk->block_count() + chunk->wall_count();
+    }
+
+    const ChunkImpostorStats& stats = chunk_manager.impostor_stats();
+    const ChunkImpostorAtlasStats& atlas = chunk_manager.impostor_atlas().stats();
+    const uint32_t layer_size = chunk_manager.impostor_atlas().layer_size();
+    const uint32_t atlas_kib = atlas.layers * layer_size * layer_size * sizeof(Color) / 1024;
+
+    fmt::println("  lod      {}, tiles: {} instances in 2 indirect draws, impostors: {} quads in 1 draw",
+        chunk_manager.lod_active() ? "active" : "inactive", tile_instances, chunk_manager.visible_chunks().size());
+    fmt::println("           impostor atlas {} / {} layers ({} KiB), {} impostors built in {:.2f} us during the benchmark",
+        atlas.in_use, atlas.layers, atlas_kib, stats.updated - prev_stats.updated, (stats.update_time - prev_stats.update_time) * 1e6);
+}
+
+void ChunkBenchmark::Run(ChunkManager& chunk_manager, const WorldData& world, const sge::Camera& original_camera) {
+    print_wall_culling(chunk_manager, world);
+
+    sge::Camera camera = original_camera;
+    camera.set_zoom(Constants::CAMERA_MIN_ZOOM);
+    camera.update();
+
+    const ChunkImpostorStats prev_impostor = chunk_manager.impostor_stats();
+
+    // Load every chunk in the range first, so the steady pass only measures the bookkeeping
+    chunk_manager.manage_chunks(world, camera);
+    chunk_manager.flush_meshes();
+
+    Timings steady;
+    for (int i = 0; i < STEADY_ITERATIONS; ++i) {
+        steady.add(time_manage_chunks(chunk_manager, world, camera));
+    }
+
+    const size_t visible_chunks = chunk_manager.visible_chunks().size();
+    const uint32_t loaded_chunks = chunk_manager.loaded_chunks();
+
+    // Sweep across the world, chunks enter and leave the range like when flying with the free camera
+    const sge::Rect& camera_area = camera.get_projection_area();
+    const float world_width = world.area.width() * Constants::TILE_SIZE;
+    const float start_x = -camera_area.min.x;
+    const float end_x = std::max(start_x, world_width - camera_area.max.x);
+
+    const ChunkPrefetchStats prev_prefetch = chunk_manager.prefetch_stats();
+
+    Timings pan;
+    for (float x = start_x; x <= end_x; x += PAN_STEP) {
+        camera.set_position(glm::vec2(x, camera.position().y));
+        camera.update();
+
+        pan.add(time_manage_chunks(chunk_manager, world, camera));
+    }
+
+    fmt::println("manage_chunks at zoom {}: {} visible chunks, {} loaded", Constants::CAMERA_MIN_ZOOM, visible_chunks, loaded_chunks);
+    print_timings("steady", steady);
+    if (pan.count > 0) print_timings("pan", pan);
+
+    const ChunkPrefetchStats& prefetch = chunk_manager.prefetch_stats();
+    fmt::println("  prefetch {} hits, {} misses, {} prefetched",
+        prefetch.hits - prev_prefetch.hits, prefetch.misses - prev_prefetch.misses, prefetch.prefetched - prev_prefetch.prefetched);
+
+    const ChunkBufferPoolStats& pool = chunk_manager.buffer_pool().stats();
+    fmt::println("  buffers  {} / {} pages in use, {} created, {} released, {} reused, {} grows, {} shrinks, {} pages moved",
+        pool.in_use, pool.pages, pool.created, pool.released, pool.reused, pool.grows, pool.shrinks, pool.relocated);
+
+    print_lod(chunk_manager, prev_impostor);
+
+    // Go back to the chunks of the real camera
+    chunk_manager.flush_meshes();
+    chunk_manager.manage_chunks(world, original_camera);
+    chunk_manager.flush_meshes();
+}
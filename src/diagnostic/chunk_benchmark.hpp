@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef DIAGNOSTIC_CHUNK_BENCHMARK_HPP_
+#define DIAGNOSTIC_CHUNK_BENCHMARK_HPP_
+
+#include <SGE/renderer/camera.hpp>
+
+#include "../world/chunk_manager.hpp"
+#include "../world/world_data.hpp"
+
+// Reports the wall culling of the current view and times ChunkManager::manage_chunks at the max zoom-out,
+// where the most chunks are in the range. Needs a live renderer since new chunks upload their meshes.
+namespace ChunkBenchmark {
+    void Run(ChunkManager& chunk_manager, const WorldData& world, const sge::Camera& camera);
+};
+
+#endif
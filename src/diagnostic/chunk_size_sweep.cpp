@@ -0,0 +1,157 @@
+#include "chunk_size_sweep.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include <fmt/base.h>
+
+#include "../constants.hpp"
+#include "../world/chunk_size.hpp"
+
+static constexpr uint32_t CHUNK_SIZES[] = { 16, 32, 50, 64, 100 };
+
+// The zoom the game starts with
+static constexpr float SWEEP_ZOOM = 1.0f;
+
+// The free camera speed at 60 FPS
+static constexpr float PATH_STEP = 2000.0f / 60.0f;
+
+struct SweepResult {
+    uint32_t chunk_size = 0;
+    uint32_t frames = 0;
+    // The main thread time of manage_chunks, in seconds
+    double manage_time = 0.0;
+    // The time spent waiting for the workers and uploading the meshes, in seconds
+    double build_time = 0.0;
+    uint64_t draws = 0;
+    uint64_t instances = 0;
+    uint32_t rebuilds = 0;
+    uint64_t rebuild_bytes = 0;
+
+    [[nodiscard]]
+    double frame_time() const {
+        return (manage_time + build_time) / frames;
+    }
+};
+
+// Pans across the world at the height of the camera, then goes down at the right edge
+static std::vector<glm::vec2> camera_path(const WorldData& world, const sge::Camera& camera) {
+    const sge::Rect& camera_area = camera.get_projection_area();
+    const glm::vec2 world_size = glm::vec2(world.area.size()) * Constants::TILE_SIZE;
+
+    const float start_x = -camera_area.min.x;
+    const float end_x = std::max(start_x, world_size.x - camera_area.max.x);
+    const float start_y = camera.position().y;
+    const float end_y = std::max(start_y, world_size.y - camera_area.max.y);
+
+    std::vector<glm::vec2> path;
+
+    for (float x = start_x; x <= end_x; x += PATH_STEP) {
+        path.emplace_back(x, start_y);
+    }
+
+    for (float y = start_y; y <= end_y; y += PATH_STEP) {
+        path.emplace_back(end_x, y);
+    }
+
+    return path;
+}
+
+static double elapsed_since(std::chrono::steady_clock::time_point start) {
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+static SweepResult run_path(ChunkManager& chunk_manager, const WorldData& world, sge::Camera& camera, const std::vector<glm::vec2>& path) {
+    SweepResult result;
+    result.chunk_size = ChunkSize::Get();
+
+    camera.set_position(path.front());
+    camera.update();
+
+    // The first view is loaded up front, like when the world is entered
+    chunk_manager.manage_chunks(world, camera);
+    chunk_manager.flush_meshes();
+
+    const ChunkMeshStats prev_stats = chunk_manager.mesh_stats();
+
+    for (const glm::vec2& position : path) {
+        camera.set_position(position);
+        camera.update();
+
+        const auto manage_start = std::chrono::steady_clock::now();
+        chunk_manager.manage_chunks(world, camera);
+        result.manage_time += elapsed_since(manage_start);
+
+        const auto build_start = std::chrono::steady_clock::now();
+        chunk_manager.flush_meshes();
+        result.build_time += elapsed_since(build_start);
+
+        // One indirect draw per non-empty layer, like WorldRenderer::render
+        for (const RenderChunk* chunk : chunk_manager.visible_chunks()) {
+            if (chunk->wall_count() > 0) result.draws++;
+            if (chunk->block_count() > 0) result.draws++;
+            result.instances += chunk->wall_count() + chunk->block_count();
+        }
+
+        result.frames++;
+    }
+
+    const ChunkMeshStats& stats = chunk_manager.mesh_stats();
+    result.rebuilds = stats.full_rebuilds - prev_stats.full_rebuilds;
+    result.rebuild_bytes = stats.rebuild_bytes - prev_stats.rebuild_bytes;
+
+    return result;
+}
+
+void ChunkSizeSweep::Run(ChunkManager& chunk_manager, const WorldData& world, const sge::Camera& original_camera) {
+    const uint32_t original_size = ChunkSize::Get();
+
+    sge::Camera camera = original_camera;
+    camera.set_zoom(SWEEP_ZOOM);
+    camera.update();
+
+    const std::vector<glm::vec2> path = camera_path(world, camera);
+
+    std::vector<SweepResult> results;
+
+    for (const uint32_t chunk_size : CHUNK_SIZES) {
+        chunk_manager.reset();
+        ChunkSize::Set(chunk_size);
+
+        results.push_back(run_path(chunk_manager, world, camera, path));
+    }
+
+    fmt::println("chunk size sweep: {} camera steps at zoom {}", path.size(), SWEEP_ZOOM);
+    fmt::println("  {:>4}   {:>12}   {:>12}   {:>8}   {:>11}   {:>11}   {:>15}",
+        "size", "manage us/f", "build us/f", "rebuilds", "rebuilt KiB", "draws/frame", "instances/frame");
+
+    for (const SweepResult& result : results) {
+        fmt::println("  {:>4}   {:>12.2f}   {:>12.2f}   {:>8}   {:>11}   {:>11.1f}   {:>15.0f}",
+            result.chunk_size,
+            result.manage_time / result.frames * 1e6,
+            result.build_time / result.frames * 1e6,
+            result.rebuilds,
+            result.rebuild_bytes / 1024,
+            static_cast<double>(result.draws) / result.frames,
+            static_cast<double>(result.instances) / result.frames);
+    }
+
+    const SweepResult& fastest = *std::min_element(results.begin(), results.end(), [](const SweepResult& a, const SweepResult& b) {
+        return a.frame_time() < b.frame_time();
+    });
+    const SweepResult& fewest_draws = *std::min_element(results.begin(), results.end(), [](const SweepResult& a, const SweepResult& b) {
+        return a.draws < b.draws;
+    });
+
+    fmt::println("fastest: --chunk-size {} ({:.2f} us per frame), fewest draws: --chunk-size {} ({:.1f} per frame)",
+        fastest.chunk_size, fastest.frame_time() * 1e6,
+        fewest_draws.chunk_size, static_cast<double>(fewest_draws.draws) / fewest_draws.frames);
+
+    // Go back to the chunks of the real camera
+    chunk_manager.reset();
+    ChunkSize::Set(original_size);
+    chunk_manager.manage_chunks(world, original_camera);
+    chunk_manager.flush_meshes();
+}
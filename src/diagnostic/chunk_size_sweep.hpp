@@ -0,0 +1,18 @@
+#pragma once
+
+#ifndef DIAGNOSTIC_CHUNK_SIZE_SWEEP_HPP_
+#define DIAGNOSTIC_CHUNK_SIZE_SWEEP_HPP_
+
+#include <SGE/renderer/camera.hpp>
+
+#include "../world/chunk_manager.hpp"
+#include "../world/world_data.hpp"
+
+// Moves the camera along a scripted path once for every candidate chunk size and prints
+// the chunk management and mesh rebuild cost against the draw count of each, then the fastest size.
+// Needs a live renderer since the meshes are uploaded. The chunk size is restored afterwards.
+namespace ChunkSizeSweep {
+    void Run(ChunkManager& chunk_manager, const WorldData& world, const sge::Camera& camera);
+};
+
+#endif
@@ -1,6 +1,8 @@
 #include "frametime.hpp"
 #include "SGE/time/time.hpp"
 
+#include <algorithm>
+
 #include <LLGL/Container/DynamicArray.h>
 
 static constexpr uint16_t FRAMETIME_RECORD_MAX_COUNT = 120;
@@ -28,4 +30,11 @@ float FrameTime::GetCurrentFPS() {
         return 1.0f / dt;
 
     return 0.0f;
-}
\ No newline at end of file
+}
+float FrameTime::GetWorstFrameTime() {
+    float worst = 0.0f;
+    for (uint16_t i = 0; i < FRAMETIME_RECORD_MAX_COUNT; ++i) {
+        worst = std::max(worst, state.frametime_records[i]);
+    }
+    return worst;
+}
@@ -7,6 +7,8 @@ namespace FrameTime {
     void Update(float frametime);
     float GetAverageFPS();
     float GetCurrentFPS();
+    // The longest frame time of the recorded frames, in seconds
+    float GetWorstFrameTime();
 };
 
 #endif
\ No newline at end of file
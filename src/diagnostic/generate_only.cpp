@@ -0,0 +1,80 @@
+#include "generate_only.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <SGE/defines.hpp>
+#include <fmt/base.h>
+
+#if SGE_PLATFORM_WINDOWS
+    #define NOMINMAX
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <sys/resource.h>
+#endif
+
+#include "../world/world_data.hpp"
+#include "../world/world_gen.h"
+
+#include "world_hash.hpp"
+
+// In bytes, 0 if unknown
+static uint64_t peak_rss() {
+#if SGE_PLATFORM_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    #if SGE_PLATFORM_MACOS
+        // Bytes on macOS
+        return static_cast<uint64_t>(usage.ru_maxrss);
+    #else
+        // Kilobytes on Linux
+        return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+    #endif
+#endif
+}
+
+int GenerateOnly::Run(uint32_t width, uint32_t height, uint32_t seed, uint32_t thread_count, std::optional<uint64_t> expected_hash) {
+    const uint32_t threads = thread_count != 0 ? thread_count : std::max(std::thread::hardware_concurrency(), 1u);
+
+    fmt::println("world_generate {}x{}, seed {}, {} threads", width, height, seed, threads);
+
+    WorldData world;
+    std::vector<WorldGenPassTime> passes;
+
+    const auto start = std::chrono::steady_clock::now();
+    world_generate(world, width, height, seed, { .thread_count = threads, .pass_times = &passes });
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    fmt::println("");
+    for (const WorldGenPassTime& pass : passes) {
+        fmt::println("  {:<16} {:9.2f} ms", pass.name, pass.time * 1e3);
+    }
+    fmt::println("  {:<16} {:9.2f} ms", "total", elapsed.count() * 1e3);
+
+    fmt::println("");
+    fmt::println("Peak RSS: {:.1f} MiB", peak_rss() / (1024.0 * 1024.0));
+
+    const WorldHash hash = hash_world_parts(world);
+
+    fmt::println("");
+    fmt::println("  blocks   {:016x}", hash.blocks);
+    fmt::println("  walls    {:016x}", hash.walls);
+    fmt::println("  lightmap {:016x}", hash.lightmap);
+    fmt::println("  world    {:016x}", hash.world);
+
+    if (!expected_hash.has_value()) return 0;
+
+    const bool matches = hash.world == expected_hash.value();
+
+    fmt::println("");
+    fmt::println("Expected world hash {:016x}: {}", expected_hash.value(), matches ? "PASS" : "FAIL");
+
+    return matches ? 0 : 1;
+}
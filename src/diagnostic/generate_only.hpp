@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef DIAGNOSTIC_GENERATE_ONLY_HPP_
+#define DIAGNOSTIC_GENERATE_ONLY_HPP_
+
+#include <cstdint>
+#include <optional>
+
+// Generates the world without a window or a renderer and prints the time of every pass,
+// the peak memory usage and the hashes of the result. Meant to be the regression gate
+// for both the generation performance and its determinism.
+namespace GenerateOnly {
+    // Returns the process exit code: 1 if `expected_hash` is set and the world hash differs
+    int Run(uint32_t width, uint32_t height, uint32_t seed, uint32_t thread_count, std::optional<uint64_t> expected_hash);
+};
+
+#endif
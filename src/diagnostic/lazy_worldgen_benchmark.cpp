@@ -0,0 +1,125 @@
+#include "lazy_worldgen_benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <fmt/base.h>
+
+#include "../world/world_data.hpp"
+#include "../world/world_gen.h"
+
+#include "world_hash.hpp"
+
+struct StripTimes {
+    double init = 0.0;
+    // The time of every strip generated after init, in seconds
+    std::vector<double> strips;
+};
+
+// Generates the strips left over by init one at a time, from left to right or the other way around
+static StripTimes generate_lazily(WorldData& world, uint32_t width, uint32_t height, uint32_t seed, uint32_t thread_count, bool reverse) {
+    LazyWorldGenerator generator;
+    StripTimes times;
+
+    const auto start = std::chrono::steady_clock::now();
+    generator.init(world, width, height, seed, thread_count);
+    times.init = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const int strip_count = (world.area.width() + LazyWorldGenerator::STRIP_WIDTH - 1) / LazyWorldGenerator::STRIP_WIDTH;
+
+    for (int i = 0; i < strip_count; ++i) {
+        const int strip = reverse ? strip_count - 1 - i : i;
+        const int x = strip * LazyWorldGenerator::STRIP_WIDTH;
+
+        if (generator.is_generated(x)) continue;
+
+        const auto strip_start = std::chrono::steady_clock::now();
+        generator.generate_columns(world, x, x + 1);
+        times.strips.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - strip_start).count());
+    }
+
+    return times;
+}
+
+// The tiles whose block or wall is not the same type in both worlds
+static size_t count_different_tiles(const WorldData& a, const WorldData& b) {
+    const size_t tile_count = static_cast<size_t>(a.area.width()) * a.area.height();
+
+    size_t count = 0;
+    for (size_t i = 0; i < tile_count; ++i) {
+        const std::optional<Block>& block_a = a.blocks[i];
+        const std::optional<Block>& block_b = b.blocks[i];
+        const std::optional<Wall>& wall_a = a.walls[i];
+        const std::optional<Wall>& wall_b = b.walls[i];
+
+        const bool same_block = block_a.has_value() == block_b.has_value() && (!block_a.has_value() || block_a->type == block_b->type);
+        const bool same_wall = wall_a.has_value() == wall_b.has_value() && (!wall_a.has_value() || wall_a->type == wall_b->type);
+
+        if (!same_block || !same_wall) count++;
+    }
+    return count;
+}
+
+static double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    std::sort(values.begin(), values.end());
+    const size_t index = std::min(static_cast<size_t>(p * values.size()), values.size() - 1);
+    return values[index];
+}
+
+int LazyWorldGenBenchmark::Run(uint32_t width, uint32_t height, uint32_t seed, uint32_t thread_count) {
+    const uint32_t threads = thread_count != 0 ? thread_count : std::max(std::thread::hardware_concurrency(), 1u);
+
+    fmt::println("LazyWorldGenerator {}x{}, seed {}, {} threads, strips of {} columns with a halo of {}",
+        width, height, seed, threads, LazyWorldGenerator::STRIP_WIDTH, LazyWorldGenerator::HALO);
+
+    WorldData eager;
+
+    const auto start = std::chrono::steady_clock::now();
+    world_generate(eager, width, height, seed, { .thread_count = threads });
+    const double eager_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    WorldData forward;
+    const StripTimes times = generate_lazily(forward, width, height, seed, threads, false);
+
+    WorldData backward;
+    generate_lazily(backward, width, height, seed, threads, true);
+
+    double strips_time = 0.0;
+    for (const double time : times.strips) strips_time += time;
+
+    const double mean = times.strips.empty() ? 0.0 : strips_time / times.strips.size();
+
+    fmt::println("");
+    fmt::println("  {:<22} {:9.2f} ms", "world_generate", eager_time * 1e3);
+    fmt::println("  {:<22} {:9.2f} ms   {:5.2f}x faster to the first frame", "init", times.init * 1e3, eager_time / times.init);
+    fmt::println("  {:<22} {:9}", "strips after init", times.strips.size());
+    fmt::println("  {:<22} {:9.2f} ms mean {:9.2f} ms p50 {:9.2f} ms p95 {:9.2f} ms max",
+        "strip", mean * 1e3, percentile(times.strips, 0.5) * 1e3, percentile(times.strips, 0.95) * 1e3, percentile(times.strips, 1.0) * 1e3);
+    fmt::println("  {:<22} {:9.2f} ms   {:5.2f}x of world_generate", "init and every strip",
+        (times.init + strips_time) * 1e3, (times.init + strips_time) / eager_time);
+
+    // Only the blocks and the walls, init bakes the lightmap of the spawn area alone
+    const WorldHash eager_hash = hash_world_parts(eager);
+    const WorldHash forward_hash = hash_world_parts(forward);
+    const WorldHash backward_hash = hash_world_parts(backward);
+
+    const bool order_independent = forward_hash.blocks == backward_hash.blocks && forward_hash.walls == backward_hash.walls;
+    const bool same_as_eager = forward_hash.blocks == eager_hash.blocks && forward_hash.walls == eager_hash.walls;
+
+    const size_t different_tiles = count_different_tiles(forward, eager);
+    const size_t tile_count = static_cast<size_t>(width) * height;
+
+    fmt::println("");
+    fmt::println("  {:<22} blocks {:016x} walls {:016x}", "left to right", forward_hash.blocks, forward_hash.walls);
+    fmt::println("  {:<22} blocks {:016x} walls {:016x} {}", "right to left", backward_hash.blocks, backward_hash.walls, order_independent ? "" : "MISMATCH");
+    fmt::println("  {:<22} blocks {:016x} walls {:016x} {}", "world_generate", eager_hash.blocks, eager_hash.walls, same_as_eager ? "" : "differs");
+    fmt::println("  {} of {} tiles ({:.4f}%) differ from world_generate", different_tiles, tile_count, 100.0 * different_tiles / tile_count);
+
+    fmt::println("");
+    fmt::println(order_independent ? "The strips don't depend on the order they are generated in" : "The strips depend on the order they are generated in");
+
+    return order_independent ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#ifndef DIAGNOSTIC_LAZY_WORLDGEN_BENCHMARK_HPP_
+#define DIAGNOSTIC_LAZY_WORLDGEN_BENCHMARK_HPP_
+
+#include <cstdint>
+
+// Generates the world with LazyWorldGenerator and prints the time to the first playable frame,
+// the time of every strip and how the whole lazily generated world compares with world_generate.
+namespace LazyWorldGenBenchmark {
+    // Returns the process exit code: 1 if the strips depend on the order they are generated in
+    int Run(uint32_t width, uint32_t height, uint32_t seed, uint32_t thread_count);
+};
+
+#endif
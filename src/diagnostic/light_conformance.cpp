@@ -0,0 +1,431 @@
+#include "light_conformance.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <fmt/base.h>
+
+#include "../renderer/dynamic_lighting.hpp"
+#include "../world/world_data.hpp"
+#include "../world/lightmap.hpp"
+#include "../types/light.hpp"
+#include "../constants.hpp"
+
+using Constants::SUBDIVISION;
+
+// Must be kept in sync with assets/shaders/light.slang
+static constexpr float SHADER_LIGHT_EPSILON = 0.0185f;
+static constexpr uint32_t SHADER_NUM_THREADS = 32;
+
+// Must be kept in sync with AcceleratedDynamicLighting (non-Metal backends)
+static constexpr uint32_t SHADER_WORKGROUP_SIZE = 16;
+
+// The max per channel difference in 1/255 steps that is still considered a match
+static constexpr int TOLERANCE = 2;
+
+static constexpr int ITERATIONS = 5;
+
+struct Patch {
+    const char* name;
+    int width = 0;
+    int height = 0;
+    // 1 if there is a block, the same as the tile texture
+    std::vector<uint8_t> tiles;
+    std::vector<Light> lights;
+
+    Patch(const char* name, int width, int height, uint8_t fill) :
+        name(name), width(width), height(height), tiles(width * height, fill) {}
+
+    void fill(int x0, int y0, int x1, int y1, uint8_t value) {
+        for (int y = glm::max(y0, 0); y < glm::min(y1, height); ++y) {
+            for (int x = glm::max(x0, 0); x < glm::min(x1, width); ++x) {
+                tiles[y * width + x] = value;
+            }
+        }
+    }
+
+    void add_light(int tile_x, int tile_y, const glm::vec3& color) {
+        lights.push_back(Light {
+            .color = color,
+            .pos = TilePos(tile_x * SUBDIVISION + SUBDIVISION / 2, tile_y * SUBDIVISION + SUBDIVISION / 2),
+            .size = glm::uvec2(2)
+        });
+    }
+};
+
+// Emulates the textures and the compute passes of light.slang
+class ShaderEmulator {
+public:
+    ShaderEmulator(const Patch& patch, float epsilon) :
+        m_patch(patch),
+        m_pixels(patch.width * SUBDIVISION * patch.height * SUBDIVISION),
+        m_width(patch.width * SUBDIVISION),
+        m_height(patch.height * SUBDIVISION),
+        m_epsilon(epsilon) {}
+
+    // Mirrors AcceleratedDynamicLighting::compute_light with the whole patch as the blur area
+    void run() {
+        std::memset(m_pixels.data(), 0, m_pixels.size() * sizeof(Color));
+
+        const uint32_t grid_w = m_width / SHADER_WORKGROUP_SIZE;
+        const uint32_t grid_h = m_height / SHADER_WORKGROUP_SIZE;
+
+        set_light_sources();
+
+        // The horizontal pass is dispatched with grid_w and the vertical one with grid_h
+        for (int i = 0; i < 2; ++i) {
+            blur_horizontal(grid_w * SHADER_NUM_THREADS);
+            blur_vertical(grid_h * SHADER_NUM_THREADS);
+        }
+        blur_horizontal(grid_w * SHADER_NUM_THREADS);
+    }
+
+    [[nodiscard]]
+    inline const Color* pixels() const noexcept {
+        return m_pixels.data();
+    }
+
+private:
+    // Out of bounds reads return zero
+    [[nodiscard]]
+    glm::vec4 load(glm::uvec2 pos) const {
+        if (pos.x >= m_width || pos.y >= m_height) return glm::vec4(0.0f);
+        const Color& c = m_pixels[pos.y * m_width + pos.x];
+        return glm::vec4(c.r, c.g, c.b, c.a) / 255.0f;
+    }
+
+    // Out of bounds writes are discarded, unorm conversion rounds to the nearest value
+    void store(glm::uvec2 pos, const glm::vec4& value) {
+        if (pos.x >= m_width || pos.y >= m_height) return;
+        const glm::vec4 v = glm::round(glm::clamp(value, 0.0f, 1.0f) * 255.0f);
+        m_pixels[pos.y * m_width + pos.x] = Color(v.r, v.g, v.b, v.a);
+    }
+
+    [[nodiscard]]
+    float get_decay(glm::uvec2 pos) const {
+        const glm::uvec2 tile = pos / glm::uvec2(SUBDIVISION);
+        const bool solid = tile.x < static_cast<uint32_t>(m_patch.width) && tile.y < static_cast<uint32_t>(m_patch.height)
+            && m_patch.tiles[tile.y * m_patch.width + tile.x] == 1;
+        return Constants::LightDecay(solid);
+    }
+
+    void blur(glm::uvec2 pos, glm::vec3& prev_light, float& prev_decay) {
+        glm::vec4 this_light = load(pos);
+
+        prev_light.x = prev_light.x < m_epsilon ? 0.0f : prev_light.x;
+        prev_light.y = prev_light.y < m_epsilon ? 0.0f : prev_light.y;
+        prev_light.z = prev_light.z < m_epsilon ? 0.0f : prev_light.z;
+
+        for (int c = 0; c < 3; ++c) {
+            if (prev_light[c] < this_light[c]) {
+                prev_light[c] = this_light[c];
+            } else {
+                this_light[c] = prev_light[c];
+            }
+        }
+
+        store(pos, this_light);
+
+        prev_light = prev_light * prev_decay;
+        prev_decay = get_decay(pos);
+    }
+
+    void set_light_sources() {
+        for (const Light& light : m_patch.lights) {
+            for (uint32_t x = 0; x < light.size.x; ++x) {
+                for (uint32_t y = 0; y < light.size.y; ++y) {
+                    store(glm::uvec2(glm::ivec2(light.pos)) + glm::uvec2(x, y), glm::vec4(light.color, 1.0f));
+                }
+            }
+        }
+    }
+
+    void blur_vertical(uint32_t thread_count) {
+        for (uint32_t thread_id = 0; thread_id < thread_count; ++thread_id) {
+            const uint32_t x = thread_id;
+
+            glm::vec3 prev_light = glm::vec3(0.0f);
+            float prev_decay = 0.0f;
+
+            glm::vec3 prev_light2 = glm::vec3(0.0f);
+            float prev_decay2 = 0.0f;
+
+            for (uint32_t y = 0; y < m_height; ++y) {
+                blur(glm::uvec2(x, y), prev_light, prev_decay);
+                blur(glm::uvec2(x, m_height - 1 - y), prev_light2, prev_decay2);
+            }
+        }
+    }
+
+    void blur_horizontal(uint32_t thread_count) {
+        for (uint32_t thread_id = 0; thread_id < thread_count; ++thread_id) {
+            const uint32_t y = thread_id;
+
+            glm::vec3 prev_light = glm::vec3(0.0f);
+            float prev_decay = 0.0f;
+
+            glm::vec3 prev_light2 = glm::vec3(0.0f);
+            float prev_decay2 = 0.0f;
+
+            for (uint32_t x = 0; x < m_width; ++x) {
+                blur(glm::uvec2(x, y), prev_light, prev_decay);
+                blur(glm::uvec2(m_width - 1 - x, y), prev_light2, prev_decay2);
+            }
+        }
+    }
+
+private:
+    const Patch& m_patch;
+    std::vector<Color> m_pixels;
+    uint32_t m_width;
+    uint32_t m_height;
+    float m_epsilon;
+};
+
+struct ChannelError {
+    int max[3] = { 0, 0, 0 };
+    double mean[3] = { 0.0, 0.0, 0.0 };
+
+    [[nodiscard]]
+    inline bool within(int tolerance) const noexcept {
+        return max[0] <= tolerance && max[1] <= tolerance && max[2] <= tolerance;
+    }
+};
+
+static ChannelError compare(const Color* reference, const Color* pixels, size_t count) {
+    ChannelError error;
+    uint64_t sum[3] = { 0, 0, 0 };
+
+    for (size_t i = 0; i < count; ++i) {
+        const int diff[3] = {
+            std::abs(int(reference[i].r) - int(pixels[i].r)),
+            std::abs(int(reference[i].g) - int(pixels[i].g)),
+            std::abs(int(reference[i].b) - int(pixels[i].b)),
+        };
+
+        for (int c = 0; c < 3; ++c) {
+            error.max[c] = glm::max(error.max[c], diff[c]);
+            sum[c] += diff[c];
+        }
+    }
+
+    for (int c = 0; c < 3; ++c) {
+        error.mean[c] = count > 0 ? double(sum[c]) / double(count) : 0.0;
+    }
+
+    return error;
+}
+
+static void init_lightmap(LightMap& lightmap, const Patch& patch) {
+    for (int y = 0; y < lightmap.height; ++y) {
+        for (int x = 0; x < lightmap.width; ++x) {
+            const TilePos tile_pos = TilePos(x, y) / SUBDIVISION;
+            lightmap.set_mask(TilePos(x, y), patch.tiles[tile_pos.y * patch.width + tile_pos.x] == 1);
+        }
+    }
+
+    std::memset(lightmap.colors, 0, lightmap.width * lightmap.height * sizeof(Color));
+
+    for (const Light& light : patch.lights) {
+        for (uint32_t y = 0; y < light.size.y; ++y) {
+            for (uint32_t x = 0; x < light.size.x; ++x) {
+                lightmap.set_color(light.pos + TilePos(x, y), light.color);
+            }
+        }
+    }
+}
+
+// The float blur the CPU engines used before the decay tables, kept as the speedup baseline
+static void float_blur(LightMap& lightmap, int index, glm::vec3& prev_light, float& prev_decay) {
+    using Constants::LIGHT_EPSILON;
+
+    glm::vec3 this_light = lightmap.get_color(index);
+
+    prev_light.r = prev_light.r < LIGHT_EPSILON ? 0.0f : prev_light.r;
+    prev_light.g = prev_light.g < LIGHT_EPSILON ? 0.0f : prev_light.g;
+    prev_light.b = prev_light.b < LIGHT_EPSILON ? 0.0f : prev_light.b;
+
+    for (int c = 0; c < 3; ++c) {
+        if (prev_light[c] < this_light[c]) {
+            prev_light[c] = this_light[c];
+        } else {
+            this_light[c] = prev_light[c];
+        }
+    }
+
+    lightmap.set_color(index, this_light);
+
+    prev_light = prev_light * prev_decay;
+    prev_decay = Constants::LightDecay(lightmap.get_mask(index));
+}
+
+static void float_blur_line(LightMap& lightmap, int start, int end, int stride) {
+    glm::vec3 prev_light = lightmap.get_color(start);
+    float prev_decay = Constants::LightDecay(lightmap.get_mask(start - stride));
+
+    glm::vec3 prev_light2 = lightmap.get_color(end);
+    float prev_decay2 = Constants::LightDecay(lightmap.get_mask(end + stride));
+
+    const int length = end - start;
+    for (int index = 0; index < length; index += stride) {
+        float_blur(lightmap, start + index, prev_light, prev_decay);
+        float_blur(lightmap, end - index, prev_light2, prev_decay2);
+    }
+}
+
+static void float_blur_area(LightMap& lightmap, const sge::IRect& area) {
+    const auto blur_horizontal = [&] {
+        #pragma omp parallel for
+        for (int y = area.min.y; y < area.max.y; ++y) {
+            float_blur_line(lightmap, y * lightmap.width + area.min.x, y * lightmap.width + (area.max.x - 1), 1);
+        }
+    };
+
+    const auto blur_vertical = [&] {
+        #pragma omp parallel for
+        for (int x = area.min.x; x < area.max.x; ++x) {
+            float_blur_line(lightmap, area.min.y * lightmap.width + x, (area.max.y - 1) * lightmap.width + x, lightmap.width);
+        }
+    };
+
+    for (int i = 0; i < 2; ++i) {
+        blur_horizontal();
+        blur_vertical();
+    }
+    blur_horizontal();
+}
+
+// Returns the throughput in megapixels per second
+template <typename F>
+static double measure(size_t pixel_count, F&& run) {
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        run();
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return (double(pixel_count) * ITERATIONS) / elapsed.count() / 1'000'000.0;
+}
+
+static bool report(const char* engine, const ChannelError& error, double throughput, bool checked) {
+    const bool pass = error.within(TOLERANCE);
+
+    fmt::println("  {:<28} max {:>3} {:>3} {:>3}   mean {:6.3f} {:6.3f} {:6.3f}   {:8.2f} Mpx/s   {}",
+        engine,
+        error.max[0], error.max[1], error.max[2],
+        error.mean[0], error.mean[1], error.mean[2],
+        throughput,
+        checked ? (pass ? "PASS" : "FAIL") : "info"
+    );
+
+    return !checked || pass;
+}
+
+static std::vector<Patch> create_patches() {
+    std::vector<Patch> patches;
+
+    {
+        Patch& patch = patches.emplace_back("open_air", 64, 64, 0);
+        patch.add_light(32, 32, glm::vec3(1.0f, 1.0f, 1.0f));
+    }
+
+    {
+        Patch& patch = patches.emplace_back("solid", 64, 64, 1);
+        patch.add_light(32, 32, glm::vec3(1.0f, 0.8f, 0.5f));
+    }
+
+    {
+        Patch& patch = patches.emplace_back("cave", 64, 64, 1);
+        patch.fill(8, 8, 30, 24, 0);
+        patch.fill(30, 14, 50, 18, 0);
+        patch.fill(44, 18, 56, 52, 0);
+        patch.add_light(16, 16, glm::vec3(1.0f, 0.9f, 0.6f));
+        patch.add_light(50, 40, glm::vec3(0.2f, 0.4f, 1.0f));
+    }
+
+    {
+        // Deterministic noise, independent of rand()
+        Patch& patch = patches.emplace_back("noise", 96, 96, 0);
+        uint32_t state = 0x9E3779B9u;
+        for (uint8_t& tile : patch.tiles) {
+            state = state * 1664525u + 1013904223u;
+            tile = (state >> 24) < 115 ? 1 : 0;
+        }
+        for (int i = 0; i < 8; ++i) {
+            state = state * 1664525u + 1013904223u;
+            const int x = (state >> 8) % patch.width;
+            const int y = (state >> 16) % patch.height;
+            const glm::vec3 color = glm::vec3((i & 1) ? 1.0f : 0.5f, (i & 2) ? 1.0f : 0.3f, (i & 4) ? 1.0f : 0.1f);
+            patch.add_light(x, y, color);
+        }
+    }
+
+    {
+        // Taller than wide, checks that every row is covered by the horizontal pass
+        Patch& patch = patches.emplace_back("tall_shaft", 16, 160, 1);
+        patch.fill(6, 0, 10, 160, 0);
+        patch.add_light(8, 4, glm::vec3(1.0f, 1.0f, 1.0f));
+        patch.add_light(8, 150, glm::vec3(1.0f, 0.5f, 0.0f));
+    }
+
+    return patches;
+}
+
+int LightConformance::Run() {
+    fmt::println("Light conformance: shader epsilon {}, CPU epsilon {}, tolerance {}/255, {} iterations",
+        SHADER_LIGHT_EPSILON, Constants::LIGHT_EPSILON, TOLERANCE, ITERATIONS);
+
+    bool passed = true;
+
+    for (const Patch& patch : create_patches()) {
+        const int width = patch.width * SUBDIVISION;
+        const int height = patch.height * SUBDIVISION;
+        const size_t pixel_count = size_t(width) * size_t(height);
+
+        fmt::println("");
+        fmt::println("{} ({}x{} tiles, {}x{} px, {} lights)", patch.name, patch.width, patch.height, width, height, patch.lights.size());
+
+        ShaderEmulator reference(patch, SHADER_LIGHT_EPSILON);
+        const double reference_throughput = measure(pixel_count, [&] { reference.run(); });
+        report("light.slang (reference)", ChannelError(), reference_throughput, false);
+
+        // The same passes with the CPU epsilon, isolates the error caused by the epsilon mismatch
+        ShaderEmulator cpu_epsilon(patch, Constants::LIGHT_EPSILON);
+        const double cpu_epsilon_throughput = measure(pixel_count, [&] { cpu_epsilon.run(); });
+        report("light.slang (CPU epsilon)", compare(reference.pixels(), cpu_epsilon.pixels(), pixel_count), cpu_epsilon_throughput, false);
+
+        LightMap lightmap(patch.width, patch.height);
+        const sge::IRect lightmap_area = sge::IRect({0, 0}, {width, height});
+        const double dynamic_throughput = measure(pixel_count, [&] {
+            init_lightmap(lightmap, patch);
+            DynamicLighting::blur_area(lightmap, lightmap_area);
+        });
+        passed &= report("DynamicLighting", compare(reference.pixels(), lightmap.colors, pixel_count), dynamic_throughput, true);
+
+        LightMap float_lightmap(patch.width, patch.height);
+        const double float_throughput = measure(pixel_count, [&] {
+            init_lightmap(float_lightmap, patch);
+            float_blur_area(float_lightmap, lightmap_area);
+        });
+        report("float blur (baseline)", compare(reference.pixels(), float_lightmap.colors, pixel_count), float_throughput, false);
+        report("decay tables vs float blur", compare(float_lightmap.colors, lightmap.colors, pixel_count), dynamic_throughput, false);
+        fmt::println("  decay table blur speedup: {:.2f}x", dynamic_throughput / float_throughput);
+
+        WorldData world {};
+        world.area = sge::IRect({0, 0}, {patch.width, patch.height});
+        world.lightmap = LightMap(patch.width, patch.height);
+        const double world_throughput = measure(pixel_count, [&] {
+            init_lightmap(world.lightmap, patch);
+            world.lightmap_blur_area_sync(world.area);
+        });
+        passed &= report("WorldData::lightmap_blur", compare(reference.pixels(), world.lightmap.colors, pixel_count), world_throughput, true);
+    }
+
+    fmt::println("");
+    fmt::println("Light conformance: {}", passed ? "PASS" : "FAIL");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#ifndef DIAGNOSTIC_LIGHT_CONFORMANCE_HPP_
+#define DIAGNOSTIC_LIGHT_CONFORMANCE_HPP_
+
+// Headless check that the CPU lighting engines agree with light.slang.
+// The compute passes are emulated on the CPU, so no GPU or window is required.
+namespace LightConformance {
+    // Returns the process exit code: 0 if every engine matches the shader within the tolerance
+    int Run();
+};
+
+#endif
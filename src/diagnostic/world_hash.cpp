@@ -0,0 +1,65 @@
+#include "world_hash.hpp"
+
+static constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+static constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+static inline void hash_value(uint64_t& hash, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= FNV_PRIME;
+    }
+}
+
+// The fields are hashed one by one, std::optional has padding bytes
+WorldHash hash_world_parts(const WorldData& world) {
+    WorldHash result = {
+        .blocks = FNV_OFFSET,
+        .walls = FNV_OFFSET,
+        .lightmap = FNV_OFFSET,
+        .world = FNV_OFFSET
+    };
+
+    const size_t tile_count = static_cast<size_t>(world.area.width()) * world.area.height();
+
+    for (size_t i = 0; i < tile_count; ++i) {
+        const std::optional<Block>& block = world.blocks[i];
+        hash_value(result.blocks, block.has_value());
+
+        if (block.has_value()) {
+            hash_value(result.blocks, static_cast<uint8_t>(block->type));
+            hash_value(result.blocks, block->variant);
+            hash_value(result.blocks, block->atlas_pos.x | (block->atlas_pos.y << 16));
+            hash_value(result.blocks, static_cast<uint16_t>(block->hp));
+            if (block->type == BlockType::Tree) {
+                hash_value(result.blocks, static_cast<uint8_t>(block->data.tree.type) | (static_cast<uint8_t>(block->data.tree.frame) << 8));
+            }
+        }
+
+        const std::optional<Wall>& wall = world.walls[i];
+        hash_value(result.walls, wall.has_value());
+
+        if (wall.has_value()) {
+            hash_value(result.walls, static_cast<uint8_t>(wall->type));
+            hash_value(result.walls, wall->variant);
+            hash_value(result.walls, wall->atlas_pos.x | (wall->atlas_pos.y << 16));
+        }
+    }
+
+    const size_t light_count = static_cast<size_t>(world.lightmap.width) * world.lightmap.height;
+    for (size_t i = 0; i < light_count; ++i) {
+        const Color& color = world.lightmap.colors[i];
+        hash_value(result.lightmap, color.r | (color.g << 8) | (color.b << 16) | (static_cast<uint32_t>(color.a) << 24));
+    }
+
+    hash_value(result.world, static_cast<uint32_t>(world.area.width()) | (static_cast<uint64_t>(world.area.height()) << 32));
+    hash_value(result.world, result.blocks);
+    hash_value(result.world, result.walls);
+    hash_value(result.world, result.lightmap);
+    hash_value(result.world, world.spawn_point.x | (static_cast<uint64_t>(world.spawn_point.y) << 32));
+
+    return result;
+}
+
+uint64_t hash_world(const WorldData& world) {
+    return hash_world_parts(world).world;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#ifndef DIAGNOSTIC_WORLD_HASH_HPP_
+#define DIAGNOSTIC_WORLD_HASH_HPP_
+
+#include <cstdint>
+
+#include "../world/world_data.hpp"
+
+// FNV-1a hashes of the generated world
+struct WorldHash {
+    uint64_t blocks;
+    uint64_t walls;
+    uint64_t lightmap;
+    // Combines the other three with the size and the spawn point.
+    // Two worlds with the same hash are the same for the game.
+    uint64_t world;
+};
+
+WorldHash hash_world_parts(const WorldData& world);
+
+uint64_t hash_world(const WorldData& world);
+
+#endif
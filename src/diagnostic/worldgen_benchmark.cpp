@@ -0,0 +1,218 @@
+#include "worldgen_benchmark.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+#include <FastNoiseLite/FastNoiseLite.hpp>
+
+#include "../world/batch_noise.hpp"
+#include "../world/world_data.hpp"
+#include "../world/world_gen.h"
+
+#include "world_hash.hpp"
+
+static constexpr uint32_t THREAD_COUNTS[] = { 1, 2, 4, 8, 16 };
+
+// The seed the game uses
+static constexpr uint32_t SEED = 0;
+
+// The size of the area the noise is sampled on
+static constexpr int NOISE_SAMPLE_WIDTH = 1024;
+static constexpr int NOISE_SAMPLE_HEIGHT = 512;
+
+// The flood fills and the autotiling are compared on a world as wide as a medium Terraria world,
+// so most of the flood fill work is on the surface
+static constexpr uint32_t WIDE_WORLD_WIDTH = 6400;
+
+// The passes that flood fill from the surface
+static constexpr const char* FLOOD_FILL_PASSES[] = { "grassify", "surface walls" };
+
+static FastNoiseLite make_scalar_noise(const BatchNoiseSettings& settings) {
+    FastNoiseLite noise;
+    noise.SetNoiseType(settings.type == BatchNoiseType::Perlin ? FastNoiseLite::NoiseType_Perlin : FastNoiseLite::NoiseType_OpenSimplex2);
+    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
+    noise.SetSeed(settings.seed);
+    noise.SetFrequency(settings.frequency);
+    noise.SetFractalOctaves(settings.octaves);
+    noise.SetFractalLacunarity(settings.lacunarity);
+    noise.SetFractalGain(settings.gain);
+    noise.SetFractalWeightedStrength(settings.weighted_strength);
+    return noise;
+}
+
+// Single threaded throughput of the batched rows against FastNoiseLite::GetNoise per tile
+static void print_noise(const char* name, const BatchNoiseSettings& settings) {
+    const FastNoiseLite scalar = make_scalar_noise(settings);
+    const BatchNoise batch(settings);
+
+    std::vector<float> expected(static_cast<size_t>(NOISE_SAMPLE_WIDTH) * NOISE_SAMPLE_HEIGHT);
+    std::vector<float> actual(expected.size());
+
+    const auto scalar_start = std::chrono::steady_clock::now();
+    for (int y = 0; y < NOISE_SAMPLE_HEIGHT; ++y) {
+        for (int x = 0; x < NOISE_SAMPLE_WIDTH; ++x) {
+            expected[y * NOISE_SAMPLE_WIDTH + x] = scalar.GetNoise(static_cast<float>(x), static_cast<float>(y));
+        }
+    }
+    const std::chrono::duration<double> scalar_time = std::chrono::steady_clock::now() - scalar_start;
+
+    const auto batch_start = std::chrono::steady_clock::now();
+    for (int y = 0; y < NOISE_SAMPLE_HEIGHT; ++y) {
+        batch.row(0, y, NOISE_SAMPLE_WIDTH, &actual[y * NOISE_SAMPLE_WIDTH]);
+    }
+    const std::chrono::duration<double> batch_time = std::chrono::steady_clock::now() - batch_start;
+
+    float max_error = 0.0f;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        max_error = std::max(max_error, std::abs(expected[i] - actual[i]));
+    }
+
+    const double tiles = static_cast<double>(expected.size()) * 1e-6;
+
+    fmt::println("  {:<14} scalar {:7.2f} Mtiles/s   batch {:7.2f} Mtiles/s   speedup {:5.2f}x   max error {:.2e}",
+        name, tiles / scalar_time.count(), tiles / batch_time.count(), scalar_time.count() / batch_time.count(), max_error);
+}
+
+struct SweepTotals {
+    double time = 0.0;
+    uint64_t tile_bytes = 0;
+};
+
+static SweepTotals sum_noise_sweeps(const std::vector<WorldGenPassTime>& passes) {
+    SweepTotals totals;
+    for (const WorldGenPassTime& pass : passes) {
+        if (pass.tile_bytes == 0) continue;
+        totals.time += pass.time;
+        totals.tile_bytes += pass.tile_bytes;
+    }
+    return totals;
+}
+
+static double pass_time(const std::vector<WorldGenPassTime>& passes, const char* name) {
+    for (const WorldGenPassTime& pass : passes) {
+        if (std::strcmp(pass.name, name) == 0) return pass.time;
+    }
+    return 0.0;
+}
+
+static void print_pass_times(const std::vector<WorldGenPassTime>& serial, const std::vector<WorldGenPassTime>& parallel, uint32_t thread_count) {
+    fmt::println("  {:<14} {:>10} {:>10}", "pass", "1 thread", fmt::format("{} threads", thread_count));
+
+    for (size_t i = 0; i < serial.size() && i < parallel.size(); ++i) {
+        fmt::println("  {:<14} {:>7.2f} ms {:>7.2f} ms", serial[i].name, serial[i].time * 1e3, parallel[i].time * 1e3);
+    }
+}
+
+int WorldGenBenchmark::Run(uint32_t width, uint32_t height) {
+    fmt::println("world_generate {}x{}, seed {}, {} hardware threads", width, height, SEED, std::thread::hardware_concurrency());
+
+    fmt::println("");
+    fmt::println("Noise, {}x{} tiles:", NOISE_SAMPLE_WIDTH, NOISE_SAMPLE_HEIGHT);
+    print_noise("perlin 1 oct", { .type = BatchNoiseType::Perlin, .seed = SEED, .frequency = 0.05f, .octaves = 1 });
+    print_noise("perlin 3 oct", { .type = BatchNoiseType::Perlin, .seed = SEED, .frequency = 0.15f, .octaves = 3, .lacunarity = 2.0f, .gain = 0.4f });
+    print_noise("perlin weighted", { .type = BatchNoiseType::Perlin, .seed = SEED, .frequency = 0.4f, .octaves = 3, .lacunarity = 0.5f, .gain = 2.0f, .weighted_strength = -0.63f });
+    print_noise("simplex 3 oct", { .type = BatchNoiseType::OpenSimplex2, .seed = SEED, .frequency = 0.05f, .octaves = 3, .lacunarity = 2.5f, .gain = 0.65f });
+
+    fmt::println("");
+
+    WorldData world;
+
+    std::vector<WorldGenPassTime> serial_passes;
+    std::vector<WorldGenPassTime> parallel_passes;
+    uint32_t parallel_thread_count = 1;
+
+    double serial_time = 0.0;
+    uint64_t serial_hash = 0;
+    bool identical = true;
+
+    for (const uint32_t thread_count : THREAD_COUNTS) {
+        std::vector<WorldGenPassTime> passes;
+
+        const auto start = std::chrono::steady_clock::now();
+        world_generate(world, width, height, SEED, { .thread_count = thread_count, .pass_times = &passes });
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const uint64_t hash = hash_world(world);
+
+        if (thread_count == 1) {
+            serial_time = elapsed.count();
+            serial_hash = hash;
+            serial_passes = passes;
+        } else if (thread_count <= std::max(std::thread::hardware_concurrency(), 1u)) {
+            parallel_passes = passes;
+            parallel_thread_count = thread_count;
+        }
+
+        const bool matches = hash == serial_hash;
+        identical = identical && matches;
+
+        fmt::println("  {:>2} threads   {:9.2f} ms   speedup {:5.2f}x   hash {:016x} {}",
+            thread_count, elapsed.count() * 1e3, serial_time / elapsed.count(), hash, matches ? "" : "MISMATCH");
+    }
+
+    fmt::println("");
+    print_pass_times(serial_passes, parallel_passes.empty() ? serial_passes : parallel_passes, parallel_thread_count);
+
+    // The same single threaded world with one sweep per noise pass
+    std::vector<WorldGenPassTime> separate_passes;
+    world_generate(world, width, height, SEED, { .thread_count = 1, .fuse_noise_passes = false, .pass_times = &separate_passes });
+
+    const bool fused_matches = hash_world(world) == serial_hash;
+    identical = identical && fused_matches;
+
+    const SweepTotals separate = sum_noise_sweeps(separate_passes);
+    const SweepTotals fused = sum_noise_sweeps(serial_passes);
+
+    fmt::println("");
+    fmt::println("Noise sweeps, 1 thread:");
+    fmt::println("  separate {:8.2f} ms {:8.2f} MiB of blocks streamed", separate.time * 1e3, separate.tile_bytes / (1024.0 * 1024.0));
+    fmt::println("  fused    {:8.2f} ms {:8.2f} MiB of blocks streamed   {:5.2f}x faster, {:.0f}% less traffic {}",
+        fused.time * 1e3, fused.tile_bytes / (1024.0 * 1024.0), separate.time / fused.time,
+        100.0 * (1.0 - static_cast<double>(fused.tile_bytes) / separate.tile_bytes), fused_matches ? "" : "MISMATCH");
+
+    // The same wide world with the flood fills done a tile at a time
+    std::vector<WorldGenPassTime> scanline_passes;
+    world_generate(world, WIDE_WORLD_WIDTH, height, SEED, { .pass_times = &scanline_passes });
+    const uint64_t scanline_hash = hash_world(world);
+
+    std::vector<WorldGenPassTime> per_tile_passes;
+    world_generate(world, WIDE_WORLD_WIDTH, height, SEED, { .scanline_flood_fills = false, .pass_times = &per_tile_passes });
+
+    const bool scanline_matches = hash_world(world) == scanline_hash;
+    identical = identical && scanline_matches;
+
+    fmt::println("");
+    fmt::println("Flood fills, {}x{}:", WIDE_WORLD_WIDTH, height);
+    for (const char* name : FLOOD_FILL_PASSES) {
+        const double per_tile = pass_time(per_tile_passes, name);
+        const double scanline = pass_time(scanline_passes, name);
+        fmt::println("  {:<14} per tile {:8.2f} ms   scanline {:8.2f} ms   {:5.2f}x faster",
+            name, per_tile * 1e3, scanline * 1e3, per_tile / scanline);
+    }
+    fmt::println("  {}", scanline_matches ? "same world" : "MISMATCH");
+
+    // The same wide world autotiled by the serial sweep
+    std::vector<WorldGenPassTime> serial_autotile_passes;
+    world_generate(world, WIDE_WORLD_WIDTH, height, SEED, { .two_phase_autotile = false, .pass_times = &serial_autotile_passes });
+
+    const bool autotile_matches = hash_world(world) == scanline_hash;
+    identical = identical && autotile_matches;
+
+    const double serial_autotile = pass_time(serial_autotile_passes, "autotile");
+    const double two_phase_autotile = pass_time(scanline_passes, "autotile");
+
+    fmt::println("");
+    fmt::println("Autotile, {}x{}:", WIDE_WORLD_WIDTH, height);
+    fmt::println("  serial {:8.2f} ms   two phase {:8.2f} ms   {:5.2f}x faster {}",
+        serial_autotile * 1e3, two_phase_autotile * 1e3, serial_autotile / two_phase_autotile, autotile_matches ? "" : "MISMATCH");
+
+    fmt::println("");
+    fmt::println(identical ? "Every thread count, the separate noise sweeps, the per tile flood fills and the serial autotiling produced the same world" : "The worlds differ");
+
+    return identical ? 0 : 1;
+}
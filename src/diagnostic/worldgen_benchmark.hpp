@@ -0,0 +1,17 @@
+#pragma once
+
+#ifndef DIAGNOSTIC_WORLDGEN_BENCHMARK_HPP_
+#define DIAGNOSTIC_WORLDGEN_BENCHMARK_HPP_
+
+#include <cstdint>
+
+// Headless scaling check of world_generate. The world is generated with 1, 2, 4, 8 and 16 threads,
+// every run is timed and compared with the single threaded one. The batched noise is compared with
+// FastNoiseLite, the time of every pass is printed for 1 thread and the most hardware threads, and
+// the fused noise sweep is compared with one sweep per noise pass.
+namespace WorldGenBenchmark {
+    // Returns the process exit code: 0 if every run produced the same world
+    int Run(uint32_t width, uint32_t height);
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "worldgen_determinism.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include <fmt/format.h>
+
+#include "../math/hash_rng.hpp"
+#include "../world/world_data.hpp"
+#include "../world/world_gen.h"
+
+#include "world_hash.hpp"
+
+static constexpr uint32_t SEED = 0;
+
+// The size of the area the distribution of the hash is measured on
+static constexpr int RNG_SAMPLE_SIZE = 512;
+static constexpr double RNG_TOLERANCE = 0.01;
+
+static bool report(const char* name, bool passed, const std::string& details) {
+    fmt::println("  {:<10} {:<6} {}", name, passed ? "ok" : "FAILED", details);
+    return passed;
+}
+
+static uint64_t generate(WorldData& world, uint32_t width, uint32_t height, uint32_t seed, uint32_t thread_count) {
+    world_generate(world, width, height, seed, { .thread_count = thread_count });
+    return hash_world(world);
+}
+
+// The same seed gives the same world whatever state rand() is in
+static bool check_repeat(WorldData& world, uint32_t width, uint32_t height) {
+    srand(1);
+    const uint64_t first = generate(world, width, height, SEED, 0);
+
+    srand(2);
+    for (int i = 0; i < 1000; ++i) (void) rand();
+    const uint64_t second = generate(world, width, height, SEED, 0);
+
+    return report("repeat", first == second, fmt::format("{:016x} {:016x}", first, second));
+}
+
+static bool check_threads(WorldData& world, uint32_t width, uint32_t height) {
+    const uint32_t thread_count = std::max(std::thread::hardware_concurrency(), 2u);
+
+    const uint64_t serial = generate(world, width, height, SEED, 1);
+    const uint64_t parallel = generate(world, width, height, SEED, thread_count);
+
+    return report("threads", serial == parallel, fmt::format("1 thread {:016x}, {} threads {:016x}", serial, thread_count, parallel));
+}
+
+// Fusing the noise passes into one sweep doesn't change the world
+static bool check_fusion(WorldData& world, uint32_t width, uint32_t height) {
+    world_generate(world, width, height, SEED, { .fuse_noise_passes = true });
+    const uint64_t fused = hash_world(world);
+
+    world_generate(world, width, height, SEED, { .fuse_noise_passes = false });
+    const uint64_t separate = hash_world(world);
+
+    return report("fusion", fused == separate, fmt::format("fused {:016x}, separate {:016x}", fused, separate));
+}
+
+static bool check_seed(WorldData& world, uint32_t width, uint32_t height) {
+    const uint64_t first = generate(world, width, height, SEED, 0);
+    const uint64_t second = generate(world, width, height, SEED + 1, 0);
+
+    return report("seed", first != second, fmt::format("seed {} {:016x}, seed {} {:016x}", SEED, first, SEED + 1, second));
+}
+
+// Every variant is the one keyed by the position of the tile, so it comes out the same
+// however the tile got there
+static bool check_variants(WorldData& world, uint32_t width, uint32_t height) {
+    generate(world, width, height, SEED, 0);
+
+    size_t tiles = 0;
+    size_t mismatches = 0;
+
+    for (int y = 0; y < world.area.height(); ++y) {
+        for (int x = 0; x < world.area.width(); ++x) {
+            const TilePos pos = TilePos(x, y);
+            const std::optional<Block>& block = world.blocks[world.get_tile_index(pos)];
+            const std::optional<Wall>& wall = world.walls[world.get_tile_index(pos)];
+
+            if (block.has_value()) {
+                tiles++;
+                if (block->variant != world.block_variant(pos)) mismatches++;
+            }
+
+            if (wall.has_value()) {
+                tiles++;
+                if (wall->variant != world.wall_variant(pos)) mismatches++;
+            }
+        }
+    }
+
+    return report("variants", mismatches == 0, fmt::format("{} of {} tiles don't match their position", mismatches, tiles));
+}
+
+// The hash is close enough to uniform for the variants and the tree chances
+static bool check_rng() {
+    uint32_t buckets[3] = {};
+    uint32_t hits = 0;
+
+    for (int y = 0; y < RNG_SAMPLE_SIZE; ++y) {
+        for (int x = 0; x < RNG_SAMPLE_SIZE; ++x) {
+            buckets[hash_rng_below(SEED, x, y, RngPurpose::BlockVariant, 3)]++;
+            hits += hash_rng_chance(SEED, x, y, RngPurpose::TreeGrow, 0.1f);
+        }
+    }
+
+    const double total = static_cast<double>(RNG_SAMPLE_SIZE) * RNG_SAMPLE_SIZE;
+    const double variants[3] = { buckets[0] / total, buckets[1] / total, buckets[2] / total };
+    const double chance = hits / total;
+
+    bool passed = std::abs(chance - 0.1) < RNG_TOLERANCE;
+    for (const double variant : variants) {
+        passed = passed && std::abs(variant - 1.0 / 3.0) < RNG_TOLERANCE;
+    }
+
+    return report("rng", passed, fmt::format("variants {:.4f} {:.4f} {:.4f}, chance 0.1 -> {:.4f}", variants[0], variants[1], variants[2], chance));
+}
+
+int WorldGenDeterminism::Run(uint32_t width, uint32_t height) {
+    fmt::println("world_generate determinism {}x{}, seed {}", width, height, SEED);
+
+    WorldData world;
+
+    bool passed = check_rng();
+    passed = check_repeat(world, width, height) && passed;
+    passed = check_threads(world, width, height) && passed;
+    passed = check_fusion(world, width, height) && passed;
+    passed = check_seed(world, width, height) && passed;
+    passed = check_variants(world, width, height) && passed;
+
+    fmt::println("World generation determinism: {}", passed ? "PASS" : "FAIL");
+
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#ifndef DIAGNOSTIC_WORLDGEN_DETERMINISM_HPP_
+#define DIAGNOSTIC_WORLDGEN_DETERMINISM_HPP_
+
+#include <cstdint>
+
+// Headless checks that world_generate only depends on the seed: not on rand(), on the thread count,
+// on the fusion of the noise passes or on the order the tiles are generated in, so a part of the world
+// can be regenerated on its own.
+namespace WorldGenDeterminism {
+    // Returns the process exit code: 0 if every check passes
+    int Run(uint32_t width, uint32_t height);
+};
+
+#endif
@@ -15,7 +15,10 @@
 #include <SGE/profile.hpp>
 
 #include "diagnostic/frametime.hpp"
+#include "diagnostic/chunk_benchmark.hpp"
+#include "diagnostic/chunk_size_sweep.hpp"
 #include "renderer/renderer.hpp"
+#include "renderer/deferred_release.hpp"
 #include "ui/ui.hpp"
 #include "world/autotile.hpp"
 
@@ -34,6 +37,8 @@ static struct GameState {
     });
     std::vector<Light> lights;
     bool free_camera = false;
+    // The world is being generated, only the progress is shown
+    bool loading = true;
 } g;
 
 static glm::vec2 camera_follow_player() {
@@ -93,6 +98,8 @@ static void pre_update() {
     }
 #endif
 
+    if (g.loading) return;
+
     ParticleManager::DeleteExpired();
 
     UI::PreUpdate(g.player.inventory());
@@ -108,6 +115,8 @@ static void pre_update() {
 static void fixed_update() {
     ZoneScoped;
 
+    if (g.loading) return;
+
 #if DEBUG_TOOLS
     const bool handle_input = !g.free_camera;
 #else
@@ -124,9 +133,31 @@ static void fixed_update() {
     ParticleManager::Update(g.world);
 }
 
+// Sets up everything that needs the generated world
+static void finish_loading() {
+    ZoneScoped;
+
+    g.world.wait_for_generation();
+
+    GameRenderer::InitWorldRenderer(g.world.data());
+
+    g.player.set_position(g.world, glm::vec2(g.world.spawn_point()) * Constants::TILE_SIZE);
+    g.camera.set_position(g.player.draw_position());
+
+    Background::SetupWorldBackground(g.world);
+
+    g.loading = false;
+}
+
 static void update() {
     ZoneScoped;
 
+    if (g.loading) {
+        g.camera.update();
+        if (!g.world.is_generating()) finish_loading();
+        return;
+    }
+
     float scale_speed = 2.f;
 
     if (sge::Input::Pressed(sge::Key::LeftShift)) scale_speed *= 4.f;
@@ -181,6 +212,10 @@ static void update() {
     }
 
 #if DEBUG_TOOLS
+    if (sge::Input::JustPressed(sge::Key::F9)) {
+        ChunkBenchmark::Run(g.world.chunk_manager(), g.world.data(), g.camera);
+    }
+
     if (sge::Input::Pressed(sge::Key::K)) {
         const glm::vec2 position = g.camera.screen_to_world(sge::Input::MouseScreenPosition());
 
@@ -200,12 +235,23 @@ static void update() {
 static void post_update() {
     ZoneScoped;
 
+    if (g.loading) return;
+
     UI::PostUpdate();
 }
 
 static void render() {
     ZoneScoped;
 
+    if (g.loading) {
+        const WorldGenProgress& progress = g.world.generation_progress();
+
+        GameRenderer::BeginLoading(g.camera);
+        UI::DrawLoading(g.camera, progress.pass.load(std::memory_order_relaxed), progress.fraction());
+        GameRenderer::RenderLoading();
+        return;
+    }
+
     GameRenderer::Begin(g.camera, g.world);
 
     Background::Draw();
@@ -224,10 +270,7 @@ static void render() {
 static void post_render() {
     ZoneScoped;
 
-    if (g.world.chunk_manager().any_chunks_to_destroy()) {
-        sge::Engine::Renderer().CommandQueue()->WaitIdle();
-        g.world.chunk_manager().destroy_hidden_chunks();
-    }
+    DeferredRelease::EndFrame();
 
 #if DEBUG
     if (sge::Input::Pressed(sge::Key::C)) {
@@ -242,7 +285,13 @@ static void window_resized(uint32_t width, uint32_t height, uint32_t scaled_widt
     g.camera.set_viewport(glm::uvec2(width, height));
     g.camera.update();
 
+    if (g.loading) {
+        render();
+        return;
+    }
+
     g.world.chunk_manager().manage_chunks(g.world.data(), g.camera);
+    g.world.chunk_manager().flush_meshes();
 
     Background::Update(g.camera, g.world);
 
@@ -267,11 +316,13 @@ bool load_assets() {
 }
 
 static void destroy() {
+    g.world.stop_generation();
     g.world.data().lightmap_tasks_wait();
+    DeferredRelease::Terminate();
     g.world.chunk_manager().destroy();
 }
 
-bool Game::Init(sge::RenderBackend backend, AppConfig config, int16_t world_width, int16_t world_height) {
+bool Game::Init(sge::RenderBackend backend, AppConfig config, uint32_t world_width, uint32_t world_height, uint32_t seed) {
     ZoneScoped;
 
     sge::Engine::SetLoadAssetsCallback(load_assets);
@@ -301,26 +352,23 @@ bool Game::Init(sge::RenderBackend backend, AppConfig config, int16_t world_widt
 
     if (!GameRenderer::Init(resolution)) return false;
 
+    DeferredRelease::Init();
+
     sge::Time::SetFixedTimestepSeconds(Constants::FIXED_UPDATE_INTERVAL);
 
     init_tile_rules();
 
+    // The window shows the progress until the world is generated, then update calls finish_loading
     g.world.init();
-    g.world.generate(world_width, world_height, 0);
+    g.world.generate_async(world_width, world_height, seed, config.lazy_world, config.world_cache);
 
     g.camera.set_viewport(glm::uvec2(resolution.width, resolution.height));
     g.camera.set_zoom(1.0f);
 
-    GameRenderer::InitWorldRenderer(g.world.data());
-
     ParticleManager::Init();
     UI::Init();
 
     g.player.init();
-    g.player.set_position(g.world, glm::vec2(g.world.spawn_point()) * Constants::TILE_SIZE);
-    g.camera.set_position(g.player.draw_position());
-
-    Background::SetupWorldBackground(g.world);
 
     Inventory& inventory = g.player.inventory();
     inventory.add_item_stack(ITEM_COPPER_AXE);
@@ -343,6 +391,12 @@ void Game::Run() {
     sge::Engine::Run();
 }
 
+void Game::RunChunkSizeSweep() {
+    if (g.loading) finish_loading();
+
+    ChunkSizeSweep::Run(g.world.chunk_manager(), g.world.data(), g.camera);
+}
+
 void Game::Destroy() {
     GameRenderer::Terminate();
     ParticleManager::Terminate();
@@ -9,11 +9,17 @@ struct AppConfig {
     bool vsync = false;
     bool fullscreen = false;
     uint8_t samples = 1;
+    // Generate the world a strip at a time as the camera gets to it
+    bool lazy_world = false;
+    // Load the world from WorldCache instead of generating it when it's there
+    bool world_cache = true;
 };
 
 namespace Game {
-    bool Init(sge::RenderBackend backend, AppConfig config, int16_t world_width, int16_t world_height);
+    bool Init(sge::RenderBackend backend, AppConfig config, uint32_t world_width, uint32_t world_height, uint32_t seed);
     void Run();
+    // Runs ChunkSizeSweep on the generated world instead of the game loop
+    void RunChunkSizeSweep();
     void Destroy();
 };
 
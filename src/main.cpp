@@ -1,10 +1,19 @@
+#include <algorithm>
 #include <cstring>
 #include <cstdio>
+#include <optional>
 #include <string>
 #include <SGE/defines.hpp>
 #include <fmt/base.h>
 
 #include "game.hpp"
+#include "diagnostic/generate_only.hpp"
+#include "diagnostic/lazy_worldgen_benchmark.hpp"
+#include "diagnostic/light_conformance.hpp"
+#include "diagnostic/worldgen_benchmark.hpp"
+#include "diagnostic/worldgen_determinism.hpp"
+#include "world/chunk_size.hpp"
+#include "world/world_gen.h"
 
 inline void print_render_backends() {
     #if SGE_PLATFORM_WINDOWS
@@ -28,11 +37,21 @@ int main(int argc, char** argv) {
 #endif
     AppConfig config;
 
-    int16_t world_width = 200;
-    int16_t world_height = 500;
+    uint32_t world_width = 200;
+    uint32_t world_height = 500;
+    bool chunk_size_sweep = false;
+    bool worldgen_benchmark = false;
+    bool lazy_worldgen_benchmark = false;
+    bool worldgen_determinism = false;
+    bool generate_only = false;
+    uint32_t seed = 0;
+    uint32_t thread_count = 0;
+    std::optional<uint64_t> expected_hash = std::nullopt;
 
     for (int i = 1; i < argc; i++) {
-        if (str_eq(argv[i], "--wait-key")) {
+        if (str_eq(argv[i], "--light-conformance")) {
+            return LightConformance::Run();
+        } else if (str_eq(argv[i], "--wait-key")) {
             fmt::println("Press any key to continue...");
             getchar();
         } else if (str_eq(argv[i], "--backend")) {
@@ -73,6 +92,10 @@ int main(int argc, char** argv) {
             }
         } else if (str_eq(argv[i], "--vsync")) {
             config.vsync = true;
+        } else if (str_eq(argv[i], "--lazy-world")) {
+            config.lazy_world = true;
+        } else if (str_eq(argv[i], "--no-world-cache")) {
+            config.world_cache = false;
         } else if (str_eq(argv[i], "--fullscreen")) {
             config.fullscreen = true;
         } else if (str_eq(argv[i], "--samples")) {
@@ -90,7 +113,8 @@ int main(int argc, char** argv) {
             }
 
             const char* arg = argv[i + 1];
-            world_width = std::stoul(arg);
+            // Anything past uint32_t is rejected by world_size_is_valid instead of wrapping
+            world_width = std::min<unsigned long>(std::stoul(arg), UINT32_MAX);
         } else if (str_eq(argv[i], "--world-height")) {
             if (i >= argc-1) {
                 fmt::println("Specify the height of the world.");
@@ -98,12 +122,86 @@ int main(int argc, char** argv) {
             }
 
             const char* arg = argv[i + 1];
-            world_height = std::stoul(arg);
+            world_height = std::min<unsigned long>(std::stoul(arg), UINT32_MAX);
+        } else if (str_eq(argv[i], "--chunk-size")) {
+            if (i >= argc-1) {
+                fmt::println("Specify the size of the render chunks.");
+                return 1;
+            }
+
+            const char* arg = argv[i + 1];
+            const uint32_t chunk_size = std::stoul(arg);
+
+            if (!ChunkSize::IsValid(chunk_size)) {
+                fmt::println("The size of the render chunks must be between {} and {}.", ChunkSize::MIN, ChunkSize::MAX);
+                return 1;
+            }
+
+            ChunkSize::Set(chunk_size);
+        } else if (str_eq(argv[i], "--chunk-size-sweep")) {
+            chunk_size_sweep = true;
+        } else if (str_eq(argv[i], "--worldgen-benchmark")) {
+            worldgen_benchmark = true;
+        } else if (str_eq(argv[i], "--lazy-worldgen-benchmark")) {
+            lazy_worldgen_benchmark = true;
+        } else if (str_eq(argv[i], "--worldgen-determinism")) {
+            worldgen_determinism = true;
+        } else if (str_eq(argv[i], "--generate-only")) {
+            generate_only = true;
+        } else if (str_eq(argv[i], "--seed")) {
+            if (i >= argc-1) {
+                fmt::println("Specify the seed of the world.");
+                return 1;
+            }
+
+            const char* arg = argv[i + 1];
+            seed = std::stoul(arg);
+        } else if (str_eq(argv[i], "--threads")) {
+            if (i >= argc-1) {
+                fmt::println("Specify the number of world generation threads.");
+                return 1;
+            }
+
+            const char* arg = argv[i + 1];
+            thread_count = std::stoul(arg);
+        } else if (str_eq(argv[i], "--expect-hash")) {
+            if (i >= argc-1) {
+                fmt::println("Specify the expected world hash.");
+                return 1;
+            }
+
+            const char* arg = argv[i + 1];
+            expected_hash = std::stoull(arg, nullptr, 16);
         }
     }
 
-    if (Game::Init(backend, config, world_width, world_height)) {
-        Game::Run();
+    if (!world_size_is_valid(world_width, world_height)) {
+        fmt::println("The world can't be {}x{} blocks: the width must be from 1 and the height from {} (the depth of the cavern layer) to 65520, and the world can't have more than about 33 million blocks.", world_width, world_height, WORLD_MIN_HEIGHT);
+        return 1;
+    }
+
+    if (generate_only) {
+        return GenerateOnly::Run(world_width, world_height, seed, thread_count, expected_hash);
+    }
+
+    if (worldgen_benchmark) {
+        return WorldGenBenchmark::Run(world_width, world_height);
+    }
+
+    if (lazy_worldgen_benchmark) {
+        return LazyWorldGenBenchmark::Run(world_width, world_height, seed, thread_count);
+    }
+
+    if (worldgen_determinism) {
+        return WorldGenDeterminism::Run(world_width, world_height);
+    }
+
+    if (Game::Init(backend, config, world_width, world_height, seed)) {
+        if (chunk_size_sweep) {
+            Game::RunChunkSizeSweep();
+        } else {
+            Game::Run();
+        }
     }
     Game::Destroy();
 
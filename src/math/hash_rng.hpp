@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef MATH_HASH_RNG_HPP_
+#define MATH_HASH_RNG_HPP_
+
+#include <cstdint>
+
+// Stateless random numbers for the world generation. Every value is a hash of (seed, x, y, purpose, draw),
+// so it doesn't depend on the order the tiles are generated in, on the thread that generates them or on rand().
+// `draw` tells apart several values of the same purpose at the same position.
+enum class RngPurpose : uint32_t {
+    BlockVariant = 0,
+    WallVariant,
+    HillsNoiseSeed,
+    HillsGradientSeed,
+    CavernBorderNoiseSeed,
+    TreeGrow,
+    TreeHeight,
+    TreeRoot,
+    TreeBranch,
+    TreeBranchBare,
+    TreeTrunkFrame,
+    TreeCrown,
+};
+
+namespace internal {
+    [[nodiscard]]
+    constexpr uint64_t splitmix64(uint64_t z) noexcept {
+        z += 0x9e3779b97f4a7c15ull;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+}
+
+[[nodiscard]]
+constexpr uint32_t hash_rng(uint32_t seed, int32_t x, int32_t y, RngPurpose purpose, uint32_t draw = 0) noexcept {
+    uint64_t h = internal::splitmix64(seed ^ (static_cast<uint64_t>(purpose) << 32 | draw));
+    h = internal::splitmix64(h ^ (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32 | static_cast<uint32_t>(y)));
+    return static_cast<uint32_t>(h >> 32);
+}
+
+// A number in [0, bound)
+[[nodiscard]]
+constexpr uint32_t hash_rng_below(uint32_t seed, int32_t x, int32_t y, RngPurpose purpose, uint32_t bound, uint32_t draw = 0) noexcept {
+    return static_cast<uint32_t>((static_cast<uint64_t>(hash_rng(seed, x, y, purpose, draw)) * bound) >> 32);
+}
+
+// True with the given probability
+[[nodiscard]]
+constexpr bool hash_rng_chance(uint32_t seed, int32_t x, int32_t y, RngPurpose purpose, float probability, uint32_t draw = 0) noexcept {
+    return static_cast<float>(hash_rng(seed, x, y, purpose, draw) >> 8) * (1.0f / 16777216.0f) < probability;
+}
+
+#endif
@@ -9,6 +9,7 @@
 
 #include <SGE/math/quat.hpp>
 #include <SGE/assert.hpp>
+#include <SGE/utils/random.hpp>
 
 #include "world/world.hpp"
 #include "types/block.hpp"
@@ -86,7 +87,7 @@ private:
         m_type(type) {}
 public:
     static ParticleBuilder create(Particle::Type type, glm::vec2 position, glm::vec2 velocity, float lifetime) noexcept {
-        return ParticleBuilder(type, position, velocity, 1.0f, lifetime, 0.0f, false, static_cast<uint8_t>(rand() % 3));
+        return ParticleBuilder(type, position, velocity, 1.0f, lifetime, 0.0f, false, static_cast<uint8_t>(sge::random::rand_int(0, 3)));
     }
 
     ParticleBuilder& with_gravity(bool gravity) noexcept {
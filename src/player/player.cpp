@@ -832,10 +832,10 @@ void Player::use_item(const sge::Camera& camera, World& world) {
         if (wall->hp <= 0) {
             world.remove_wall(tile_pos);
         } else {
-            uint8_t new_variant = rand() % 3;
+            const uint8_t new_variant = static_cast<uint8_t>(rand_int(0, 3));
 
             world.update_wall(tile_pos, wall->type, new_variant);
-            world.create_wall_cracks(tile_pos, map_range(wall_hp(wall->type), 0, 0, 3, wall->hp) * 6 + (rand() % 6));
+            world.create_wall_cracks(tile_pos, map_range(wall_hp(wall->type), 0, 0, 3, wall->hp) * 6 + rand_int(0, 6));
         }
 
         used = true;
@@ -858,7 +858,7 @@ void Player::use_item(const sge::Camera& camera, World& world) {
                     world.remove_block(tile_pos);
                 }
             } else {
-                uint8_t new_variant = rand() % 3;
+                const uint8_t new_variant = static_cast<uint8_t>(rand_int(0, 3));
                 BlockType new_tile_type;
                 switch (block->type) {
                     case BlockType::Grass: new_tile_type = BlockType::Dirt; break;
@@ -871,7 +871,7 @@ void Player::use_item(const sge::Camera& camera, World& world) {
                     world.update_block_variant(tile_pos, new_variant);
                     world.create_dig_tile_animation(*block, tile_pos);
                 }
-                world.create_block_cracks(tile_pos, map_range(block_hp(block->type), 0, 0, 3, block->hp) * 6 + (rand() % 6));
+                world.create_block_cracks(tile_pos, map_range(block_hp(block->type), 0, 0, 3, block->hp) * 6 + rand_int(0, 6));
             }
 
             used = true;
@@ -1,4 +1,5 @@
 #include "background_renderer.hpp"
+#include "deferred_release.hpp"
 
 #include <LLGL/ShaderFlags.h>
 #include <LLGL/PipelineLayoutFlags.h>
@@ -109,8 +110,8 @@ void BackgroundRenderer::init_targets(LLGL::Extent2D resolution) {
 
     const uint32_t samples = swap_chain->GetSamples();
 
-    SGE_RESOURCE_RELEASE(m_background_render_target);
-    SGE_RESOURCE_RELEASE(m_background_render_texture);
+    DeferredRelease::Release(m_background_render_target);
+    DeferredRelease::Release(m_background_render_texture);
 
     LLGL::TextureDescriptor texture_desc;
     texture_desc.extent.width = resolution.width;
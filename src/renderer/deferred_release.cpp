@@ -0,0 +1,92 @@
+#include "deferred_release.hpp"
+
+#include <deque>
+#include <vector>
+
+#include <LLGL/Fence.h>
+
+#include <SGE/renderer/macros.hpp>
+#include <SGE/profile.hpp>
+
+struct PendingFrame {
+    std::vector<std::function<void()>> releases;
+    LLGL::Fence* fence;
+};
+
+static struct State {
+    LLGL::Fence* fences[DeferredRelease::FRAMES_IN_FLIGHT] = {};
+    std::vector<std::function<void()>> current_releases;
+    std::deque<PendingFrame> pending_frames;
+    uint64_t frame = 0;
+} state;
+
+static void run_releases(std::vector<std::function<void()>>& releases) {
+    for (std::function<void()>& release : releases) {
+        release();
+    }
+    releases.clear();
+}
+
+void DeferredRelease::Init() {
+    const auto& context = sge::Engine::Renderer().Context();
+
+    for (LLGL::Fence*& fence : state.fences) {
+        fence = context->CreateFence();
+    }
+}
+
+void DeferredRelease::Defer(std::function<void()> release) {
+    state.current_releases.push_back(std::move(release));
+}
+
+void DeferredRelease::EndFrame() {
+    ZoneScoped;
+
+    auto* const command_queue = sge::Engine::Renderer().CommandQueue();
+
+    LLGL::Fence* fence = state.fences[state.frame % FRAMES_IN_FLIGHT];
+
+    // The fence is about to be reused, so the frame that signals it must be finished.
+    // This only blocks if the GPU is more than FRAMES_IN_FLIGHT frames behind.
+    if (state.pending_frames.size() == FRAMES_IN_FLIGHT) {
+        PendingFrame& oldest = state.pending_frames.front();
+        command_queue->WaitFence(*oldest.fence, ~0ull);
+        run_releases(oldest.releases);
+        state.pending_frames.pop_front();
+    }
+
+    command_queue->Submit(*fence);
+    state.pending_frames.push_back(PendingFrame {
+        .releases = std::move(state.current_releases),
+        .fence = fence
+    });
+    state.current_releases.clear();
+    state.frame++;
+
+    // Retire everything the GPU has already finished without waiting
+    while (!state.pending_frames.empty() && command_queue->WaitFence(*state.pending_frames.front().fence, 0)) {
+        run_releases(state.pending_frames.front().releases);
+        state.pending_frames.pop_front();
+    }
+}
+
+void DeferredRelease::Flush() {
+    sge::Engine::Renderer().CommandQueue()->WaitIdle();
+
+    for (PendingFrame& frame : state.pending_frames) {
+        run_releases(frame.releases);
+    }
+    state.pending_frames.clear();
+
+    run_releases(state.current_releases);
+}
+
+void DeferredRelease::Terminate() {
+    Flush();
+
+    const auto& context = sge::Engine::Renderer().Context();
+
+    for (LLGL::Fence*& fence : state.fences) {
+        SGE_RESOURCE_RELEASE(fence);
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef RENDERER_DEFERRED_RELEASE_HPP_
+#define RENDERER_DEFERRED_RELEASE_HPP_
+
+#include <cstdint>
+#include <functional>
+
+#include <SGE/engine.hpp>
+
+// Retires GPU resources once the frames that could still use them are finished,
+// instead of stalling the CPU with WaitIdle
+namespace DeferredRelease {
+    constexpr uint32_t FRAMES_IN_FLIGHT = 3;
+
+    void Init();
+
+    // Runs the callback once the GPU has finished the current frame
+    void Defer(std::function<void()> release);
+
+    template <typename T>
+    inline void Release(T*& resource) {
+        if (resource == nullptr) return;
+
+        T* retired = resource;
+        resource = nullptr;
+
+        Defer([retired] {
+            sge::Engine::Renderer().Context()->Release(*retired);
+        });
+    }
+
+    // Must be called after the frame is submitted
+    void EndFrame();
+
+    // Waits for the GPU and runs every pending release
+    void Flush();
+
+    void Terminate();
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 
 #include <LLGL/Container/DynamicArray.h>
 #include <LLGL/Tags.h>
@@ -12,41 +13,9 @@
 
 #include "dynamic_lighting.hpp"
 
-static bool blur(LightMap& lightmap, int index, glm::vec3& prev_light, float& prev_decay) {
-    using Constants::LIGHT_EPSILON;
-
-    glm::vec3 this_light = lightmap.get_color(index);
-
-    prev_light.r = prev_light.r < LIGHT_EPSILON ? 0.0f : prev_light.r;
-    prev_light.g = prev_light.g < LIGHT_EPSILON ? 0.0f : prev_light.g;
-    prev_light.b = prev_light.b < LIGHT_EPSILON ? 0.0f : prev_light.b;
-
-    if (prev_light.r < this_light.r) {
-        prev_light.r = this_light.r;
-    } else {
-        this_light.r = prev_light.r;
-    }
-
-    if (prev_light.g < this_light.g) {
-        prev_light.g = this_light.g;
-    } else {
-        this_light.g = prev_light.g;
-    }
-
-    if (prev_light.b < this_light.b) {
-        prev_light.b = this_light.b;
-    } else {
-        this_light.b = prev_light.b;
-    }
-
-    lightmap.set_color(index, this_light);
-
-    prev_light = prev_light * prev_decay;
-    prev_decay = Constants::LightDecay(lightmap.get_mask(index));
-
-    // The light has completely decayed - nothing to blur
-    return this_light.r < LIGHT_EPSILON && this_light.g < LIGHT_EPSILON && this_light.b < LIGHT_EPSILON;
-}
+// The size of a mask region in lightmap pixels, must be a multiple of SUBDIVISION
+static constexpr int MASK_REGION_SIZE = 64;
+static_assert(MASK_REGION_SIZE % Constants::SUBDIVISION == 0);
 
 DynamicLighting::DynamicLighting(const WorldData& world, LLGL::Texture* light_texture) : m_light_texture(light_texture) {
     m_dynamic_lightmap = LightMap(world.area.width(), world.area.height());
@@ -62,15 +31,17 @@ DynamicLighting::DynamicLighting(const WorldData& world, LLGL::Texture* light_te
             m_dynamic_lightmap.set_mask(color_pos, world.block_exists(tile_pos));
         }
     }
-}
 
-SGE_FORCE_INLINE static void blur_line(LightMap& lightmap, int start, int end, int stride, glm::vec3& prev_light, float& prev_decay, glm::vec3& prev_light2, float& prev_decay2) {
-    using Constants::LIGHT_EPSILON;
+    m_mask_regions_width = (m_dynamic_lightmap.width + MASK_REGION_SIZE - 1) / MASK_REGION_SIZE;
+    m_mask_regions_height = (m_dynamic_lightmap.height + MASK_REGION_SIZE - 1) / MASK_REGION_SIZE;
+    m_mask_region_versions.assign(m_mask_regions_width * m_mask_regions_height, 0);
+}
 
+SGE_FORCE_INLINE static void blur_line(LightMap& lightmap, int start, int end, int stride, FixedLight& prev_light, LightMask& prev_mask, FixedLight& prev_light2, LightMask& prev_mask2) {
     int length = end - start;
     for (int index = 0; index < length; index += stride) {
-        blur(lightmap, start + index, prev_light, prev_decay);
-        blur(lightmap, end - index, prev_light2, prev_decay2);
+        lightmap.blur(start + index, prev_light, prev_mask);
+        lightmap.blur(end - index, prev_light2, prev_mask2);
     }
 }
 
@@ -182,26 +153,26 @@ static void DoConcurrent(
 SGE_FORCE_INLINE static void blur_horizontal(LightMap& lightmap, const sge::IRect& area) {
     #pragma omp parallel for
     for (int y = area.min.y; y < area.max.y; ++y) {
-        glm::vec3 prev_light = lightmap.get_color({area.min.x, y});
-        float prev_decay = Constants::LightDecay(lightmap.get_mask({(area.min.x) - 1, y}));
+        FixedLight prev_light = lightmap.get_fixed_light({area.min.x, y});
+        LightMask prev_mask = lightmap.get_mask({(area.min.x) - 1, y});
 
-        glm::vec3 prev_light2 = lightmap.get_color({area.max.x - 1, y});
-        float prev_decay2 = Constants::LightDecay(lightmap.get_mask({(area.max.x), y}));
+        FixedLight prev_light2 = lightmap.get_fixed_light({area.max.x - 1, y});
+        LightMask prev_mask2 = lightmap.get_mask({(area.max.x), y});
 
-        blur_line(lightmap, y * lightmap.width + area.min.x, y * lightmap.width + (area.max.x - 1), 1, prev_light, prev_decay, prev_light2, prev_decay2);
+        blur_line(lightmap, y * lightmap.width + area.min.x, y * lightmap.width + (area.max.x - 1), 1, prev_light, prev_mask, prev_light2, prev_mask2);
     }
 }
 
 SGE_FORCE_INLINE static void blur_vertical(LightMap& lightmap, const sge::IRect& area) {
     #pragma omp parallel for
     for (int x = area.min.x; x < area.max.x; ++x) {
-        glm::vec3 prev_light = lightmap.get_color({x, area.min.y});
-        float prev_decay = Constants::LightDecay(lightmap.get_mask({x, (area.min.y) - 1}));
+        FixedLight prev_light = lightmap.get_fixed_light({x, area.min.y});
+        LightMask prev_mask = lightmap.get_mask({x, (area.min.y) - 1});
 
-        glm::vec3 prev_light2 = lightmap.get_color({x, area.max.y - 1});
-        float prev_decay2 = Constants::LightDecay(lightmap.get_mask({x, (area.max.y)}));
+        FixedLight prev_light2 = lightmap.get_fixed_light({x, area.max.y - 1});
+        LightMask prev_mask2 = lightmap.get_mask({x, (area.max.y)});
 
-        blur_line(lightmap, area.min.y * lightmap.width + x, (area.max.y - 1) * lightmap.width + x, lightmap.width, prev_light, prev_decay, prev_light2, prev_decay2);
+        blur_line(lightmap, area.min.y * lightmap.width + x, (area.max.y - 1) * lightmap.width + x, lightmap.width, prev_light, prev_mask, prev_light2, prev_mask2);
     }
 }
 
@@ -281,49 +252,174 @@ static sge::IRect calculate_light_area(const LightMap& lightmap, LLGL::DynamicAr
     return area;
 }
 
+// An upper bound of how far the light can spread along a line.
+// The light never decays slower than in the air, so the number of steps
+// until it falls below the epsilon is bounded by log(epsilon / c) / log(air_decay).
+static int light_max_radius(const glm::vec3& color) {
+    using Constants::LIGHT_EPSILON;
+
+    const float c = glm::max(color.r, glm::max(color.g, color.b));
+    if (c < LIGHT_EPSILON) return 0;
+
+    const int steps = static_cast<int>(std::ceil(std::log(LIGHT_EPSILON / c) / std::log(Constants::LightDecay(false)))) + 1;
+    return glm::min(steps, Constants::LIGHT_AIR_DECAY_STEPS);
+}
+
+// Merges overlapping areas until none of them overlap, so they can be blurred concurrently.
+// The areas are sorted by min.x and each area is only tested against the ones
+// whose x range overlaps it, instead of against every other area.
+static void merge_areas(std::vector<sge::IRect>& areas) {
+    const auto overlaps_y = [](const sge::IRect& a, const sge::IRect& b) {
+        return a.min.y < b.max.y && b.min.y < a.max.y;
+    };
+
+    bool merged = true;
+    while (merged) {
+        merged = false;
+
+        std::sort(areas.begin(), areas.end(), [](const sge::IRect& a, const sge::IRect& b) {
+            return a.min.x < b.min.x;
+        });
+
+        size_t count = 0;
+        for (size_t i = 0; i < areas.size(); ++i) {
+            sge::IRect area = areas[i];
+            if (area.width() <= 0 || area.height() <= 0) continue;
+
+            for (size_t j = i + 1; j < areas.size() && areas[j].min.x < area.max.x; ++j) {
+                sge::IRect& other = areas[j];
+                if (other.width() <= 0 || other.height() <= 0) continue;
+                if (!overlaps_y(area, other)) continue;
+
+                area = area.merge(other);
+                // Mark as consumed
+                other = sge::IRect();
+                merged = true;
+            }
+
+            areas[count++] = area;
+        }
+
+        areas.resize(count);
+    }
+}
+
+void DynamicLighting::update_mask(WorldData& world) {
+    using Constants::SUBDIVISION;
+
+    LightMap& lightmap = m_dynamic_lightmap;
+
+    for (const TilePos& pos : world.changed_tiles) {
+        const LightMask mask = world.block_exists(pos);
+        const glm::ivec2 pixel_pos = glm::ivec2(pos) * SUBDIVISION;
+
+        if (lightmap.get_mask(TilePos(pixel_pos)) == mask) continue;
+
+        for (int y = 0; y < SUBDIVISION; ++y) {
+            for (int x = 0; x < SUBDIVISION; ++x) {
+                lightmap.set_mask(TilePos(pixel_pos.x + x, pixel_pos.y + y), mask);
+            }
+        }
+
+        mask_region_version(pixel_pos.x / MASK_REGION_SIZE, pixel_pos.y / MASK_REGION_SIZE) = ++m_mask_version;
+    }
+
+    world.changed_tiles.clear();
+}
+
+bool DynamicLighting::is_footprint_valid(const LightFootprint& footprint, glm::ivec2 pos, int radius) const {
+    // The area only depends on the mask along the horizontal and vertical lines through the light
+    const int region_x = pos.x / MASK_REGION_SIZE;
+    const int region_y = pos.y / MASK_REGION_SIZE;
+
+    const int min_x = glm::max(pos.x - radius - 1, 0) / MASK_REGION_SIZE;
+    const int max_x = glm::min((pos.x + radius + 1) / MASK_REGION_SIZE, m_mask_regions_width - 1);
+    const int min_y = glm::max(pos.y - radius - 1, 0) / MASK_REGION_SIZE;
+    const int max_y = glm::min((pos.y + radius + 1) / MASK_REGION_SIZE, m_mask_regions_height - 1);
+
+    if (region_y < m_mask_regions_height) {
+        for (int x = min_x; x <= max_x; ++x) {
+            if (mask_region_version(x, region_y) > footprint.mask_version) return false;
+        }
+    }
+
+    if (region_x < m_mask_regions_width) {
+        for (int y = min_y; y <= max_y; ++y) {
+            if (mask_region_version(region_x, y) > footprint.mask_version) return false;
+        }
+    }
+
+    return true;
+}
+
 void DynamicLighting::update(World& world) {
+    ZoneScoped;
+
+    update_mask(world.data());
+
+    ++m_frame;
+    m_footprint_stats = LightFootprintStats();
+
     const uint32_t light_count = world.light_count();
-    if (light_count == 0) return;
+    if (light_count == 0) {
+        m_footprints.clear();
+        return;
+    }
 
     m_areas.clear();
-    m_indices.clear();
-
-    sge::IRect process_area = sge::IRect::uninitialized();
-    bool initialized = false;
 
     LightMap& lightmap = m_dynamic_lightmap;
+    const sge::IRect lightmap_area = sge::IRect({0, 0}, {lightmap.width, lightmap.height});
 
-    size_t i = 0;
-    for (i = 0; i < light_count; ++i) {
+    for (size_t i = 0; i < light_count; ++i) {
         const Light& light = world.lights()[i];
 
-        glm::ivec2 light_pos = glm::max(glm::ivec2(light.pos), glm::ivec2(0));
+        const int radius = light_max_radius(light.color);
+        // The light is too dark to spread anywhere
+        if (radius == 0) continue;
 
-        const sge::IRect area = calculate_light_area(lightmap, m_line, light_pos, light.color);
-        const sge::IRect a = (area + light.pos).clamp(sge::IRect({0, 0}, {lightmap.width, lightmap.height}));
+        const glm::ivec2 light_pos = glm::max(glm::ivec2(light.pos), glm::ivec2(0));
 
-        if (!initialized) {
-            process_area = a;
-            initialized = true;
-        }
+        const LightFootprintKey key = LightFootprintKey { .pos = light.pos, .color = light.color, .size = light.size };
+        auto [it, inserted] = m_footprints.try_emplace(key);
+        LightFootprint& footprint = it->second;
 
-        if (process_area.intersects(a)) {
-            process_area = process_area.merge(a);
-            m_indices.emplace_back(i, m_areas.size());
+        if (inserted || !is_footprint_valid(footprint, light_pos, radius)) {
+            footprint.area = calculate_light_area(lightmap, m_line, light_pos, light.color);
+            footprint.mask_version = m_mask_version;
+            ++m_footprint_stats.misses;
         } else {
-            m_areas.push_back(process_area);
+            ++m_footprint_stats.hits;
+        }
+
+        footprint.last_used_frame = m_frame;
 
-            m_indices.emplace_back(i, m_areas.size());
-            m_areas.push_back(a);
+        const sge::IRect area = (footprint.area + light.pos).clamp(lightmap_area);
+        if (area.width() <= 0 || area.height() <= 0) continue;
 
-            process_area = sge::IRect::uninitialized();
-            initialized = false;
+        m_areas.push_back(area);
+    }
+
+    // Forget the lights that are gone
+    for (auto it = m_footprints.begin(); it != m_footprints.end();) {
+        if (it->second.last_used_frame != m_frame) {
+            it = m_footprints.erase(it);
+        } else {
+            ++it;
         }
     }
 
-    if (initialized) {
-        m_areas.push_back(process_area);
+    merge_areas(m_areas);
+}
+
+void DynamicLighting::blur_area(LightMap& lightmap, const sge::IRect& area) {
+    for (size_t i = 0; i < 2; ++i) {
+        blur_horizontal(lightmap, area);
+
+        blur_vertical(lightmap, area);
     }
+
+    blur_horizontal(lightmap, area);
 }
 
 void DynamicLighting::compute_light(const sge::Camera& camera, const World& world) {
@@ -363,15 +459,7 @@ void DynamicLighting::compute_light(const sge::Camera& camera, const World& worl
 
     // Blur
     DoConcurrent([&lightmap, this](size_t i) {
-        const sge::IRect& area = m_areas[i];
-
-        for (size_t i = 0; i < 2; ++i) {
-            blur_horizontal(lightmap, area);
-
-            blur_vertical(lightmap, area);
-        }
-
-        blur_horizontal(lightmap, area);
+        blur_area(lightmap, m_areas[i]);
     }, m_areas.size(), m_areas.size(), 1);
 
     const auto& context = m_renderer->Context();
@@ -529,20 +617,21 @@ void AcceleratedDynamicLighting::init_textures(const WorldData& world) {
     tile_texture_desc.mipLevels = 1;
 
     {
-        LLGL::DynamicArray<uint8_t> pixels(world.area.width() * world.area.height(), LLGL::UninitializeTag{});
+        m_tile_texture_width = world.area.width();
+        m_tile_pixels = LLGL::DynamicArray<uint8_t>(world.area.width() * world.area.height(), LLGL::UninitializeTag{});
 
         for (int y = 0; y < world.area.height(); ++y) {
             for (int x = 0; x < world.area.width(); ++x) {
                 uint8_t tile = world.block_exists(TilePos(x, y)) ? 1 : 0;
-                pixels[y * world.area.width() + x] = tile;
+                m_tile_pixels[y * world.area.width() + x] = tile;
             }
         }
 
         LLGL::ImageView image_view;
         image_view.format   = LLGL::ImageFormat::R;
         image_view.dataType = LLGL::DataType::UInt8;
-        image_view.data     = pixels.data();
-        image_view.dataSize = pixels.size();
+        image_view.data     = m_tile_pixels.data();
+        image_view.dataSize = m_tile_pixels.size();
 
         m_tile_texture = context->CreateTexture(tile_texture_desc, &image_view);
     }
@@ -631,16 +720,71 @@ void AcceleratedDynamicLighting::compute_light(const sge::Camera& camera, const
 }
 
 void AcceleratedDynamicLighting::update_tile_texture(WorldData& world) {
+    ZoneScoped;
+
+    // Changed tiles are grouped by cells of this size, each cell is uploaded as a single rect
+    static constexpr int DIRTY_CELL_SIZE = 32;
+
+    m_tile_texture_stats = TileTextureStats();
+
+    if (world.changed_tiles.empty()) return;
+
+    m_tile_texture_stats.changed_tiles = world.changed_tiles.size();
+
+    m_dirty_tiles.clear();
+
+    for (const TilePos& pos : world.changed_tiles) {
+        if (!world.is_tilepos_valid(pos)) continue;
+
+        const size_t index = pos.y * m_tile_texture_width + pos.x;
+        const uint8_t tile = world.block_exists(pos) ? 1 : 0;
+
+        // The same tile may be pushed several times per frame, only real changes are uploaded
+        if (m_tile_pixels[index] == tile) continue;
+
+        m_tile_pixels[index] = tile;
+        m_dirty_tiles.push_back(pos);
+    }
+
+    world.changed_tiles.clear();
+
+    if (m_dirty_tiles.empty()) return;
+
+    const auto cell_of = [](TilePos pos) {
+        return glm::ivec2(pos.x / DIRTY_CELL_SIZE, pos.y / DIRTY_CELL_SIZE);
+    };
+
+    std::sort(m_dirty_tiles.begin(), m_dirty_tiles.end(), [&cell_of](TilePos a, TilePos b) {
+        const glm::ivec2 cell_a = cell_of(a);
+        const glm::ivec2 cell_b = cell_of(b);
+        return cell_a.y != cell_b.y ? cell_a.y < cell_b.y : cell_a.x < cell_b.x;
+    });
+
+    const auto& context = m_renderer->Context();
+
     LLGL::ImageView image_view;
     image_view.format   = LLGL::ImageFormat::R;
     image_view.dataType = LLGL::DataType::UInt8;
-    image_view.dataSize = 1;
+    image_view.rowStride = m_tile_texture_width;
 
-    while (!world.changed_tiles.empty()) {
-        auto [pos, value] = world.changed_tiles.back();
-        world.changed_tiles.pop_back();
+    size_t i = 0;
+    while (i < m_dirty_tiles.size()) {
+        const glm::ivec2 cell = cell_of(m_dirty_tiles[i]);
 
-        image_view.data     = &value;
-        m_renderer->Context()->WriteTexture(*m_tile_texture, LLGL::TextureRegion(LLGL::Offset3D(pos.x, pos.y, 0), LLGL::Extent3D(1, 1, 1)), image_view);
+        glm::ivec2 min = m_dirty_tiles[i];
+        glm::ivec2 max = min;
+
+        for (++i; i < m_dirty_tiles.size() && cell_of(m_dirty_tiles[i]) == cell; ++i) {
+            min = glm::min(min, glm::ivec2(m_dirty_tiles[i]));
+            max = glm::max(max, glm::ivec2(m_dirty_tiles[i]));
+        }
+
+        const glm::ivec2 size = max - min + 1;
+
+        image_view.data     = &m_tile_pixels[min.y * m_tile_texture_width + min.x];
+        image_view.dataSize = size.x * size.y;
+        context->WriteTexture(*m_tile_texture, LLGL::TextureRegion(LLGL::Offset3D(min.x, min.y, 0), LLGL::Extent3D(size.x, size.y, 1)), image_view);
+
+        m_tile_texture_stats.texture_writes++;
     }
-}
\ No newline at end of file
+}
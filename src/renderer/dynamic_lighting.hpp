@@ -4,12 +4,15 @@
 #define RENDERER_DYNAMIC_LIGHTING_HPP_
 
 #include <cstdint>
+#include <vector>
+#include <unordered_map>
 
 #include <SGE/renderer/camera.hpp>
 #include <SGE/renderer/renderer.hpp>
 #include <SGE/engine.hpp>
 
 #include "../world/world.hpp"
+#include "../utils.hpp"
 
 class IDynamicLighting {
 public:
@@ -21,6 +24,43 @@ public:
     virtual ~IDynamicLighting() = default;
 };
 
+struct LightFootprintKey {
+    TilePos pos;
+    glm::vec3 color;
+    glm::uvec2 size;
+
+    bool operator==(const LightFootprintKey& other) const noexcept {
+        return pos == other.pos && color == other.color && size == other.size;
+    }
+};
+
+struct LightFootprintKeyHash {
+    std::size_t operator()(const LightFootprintKey& key) const noexcept {
+        std::size_t hash = 0;
+        hash_combine(hash, key.pos.x);
+        hash_combine(hash, key.pos.y);
+        hash_combine(hash, key.color.r);
+        hash_combine(hash, key.color.g);
+        hash_combine(hash, key.color.b);
+        hash_combine(hash, key.size.x);
+        hash_combine(hash, key.size.y);
+        return hash;
+    }
+};
+
+struct LightFootprint {
+    // The light area relative to the light position
+    sge::IRect area;
+    // The mask version the area was computed against
+    uint32_t mask_version = 0;
+    uint32_t last_used_frame = 0;
+};
+
+struct LightFootprintStats {
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+};
+
 class DynamicLighting : public IDynamicLighting {
 public:
     DynamicLighting(const WorldData& world, LLGL::Texture* light_texture);
@@ -33,10 +73,41 @@ public:
     ~DynamicLighting() override {
         destroy();
     }
+
+    [[nodiscard]]
+    inline const LightFootprintStats& footprint_stats() const noexcept {
+        return m_footprint_stats;
+    }
+
+    // Runs the blur passes over the area, the masks of the lightmap are used as the decay source
+    static void blur_area(LightMap& lightmap, const sge::IRect& area);
+private:
+    void update_mask(WorldData& world);
+
+    [[nodiscard]]
+    bool is_footprint_valid(const LightFootprint& footprint, glm::ivec2 pos, int radius) const;
+
+    [[nodiscard]]
+    uint32_t& mask_region_version(int x, int y) {
+        return m_mask_region_versions[y * m_mask_regions_width + x];
+    }
+
+    [[nodiscard]]
+    uint32_t mask_region_version(int x, int y) const {
+        return m_mask_region_versions[y * m_mask_regions_width + x];
+    }
 private:
     std::vector<sge::IRect> m_areas;
 
-    std::vector<std::pair<size_t, size_t>> m_indices;
+    std::unordered_map<LightFootprintKey, LightFootprint, LightFootprintKeyHash> m_footprints;
+    LightFootprintStats m_footprint_stats;
+
+    // Every region of the mask keeps the version it was last changed at
+    std::vector<uint32_t> m_mask_region_versions;
+    int m_mask_regions_width = 0;
+    int m_mask_regions_height = 0;
+    uint32_t m_mask_version = 0;
+    uint32_t m_frame = 0;
 
     LLGL::DynamicArray<Color> m_line;
 
@@ -51,6 +122,13 @@ struct LightMapChunk {
     LLGL::Buffer* vertex_buffer;
 };
 
+struct TileTextureStats {
+    // The number of changed tile entries consumed this frame (one 1x1 write each before batching)
+    uint32_t changed_tiles = 0;
+    // The number of texture writes actually issued this frame
+    uint32_t texture_writes = 0;
+};
+
 class AcceleratedDynamicLighting : public IDynamicLighting {
 private:
     struct UniformBuffer {
@@ -68,6 +146,11 @@ public:
     void compute_light(const sge::Camera& camera, const World& world) override;
 
     void destroy() override;
+
+    [[nodiscard]]
+    inline const TileTextureStats& tile_texture_stats() const noexcept {
+        return m_tile_texture_stats;
+    }
 private:
     void init_textures(const WorldData& world);
 
@@ -77,6 +160,11 @@ private:
 private:
     std::unordered_map<glm::uvec2, LightMapChunk> m_lightmap_chunks;
 
+    // CPU copy of the tile texture, dirty rects are uploaded straight from it
+    LLGL::DynamicArray<uint8_t> m_tile_pixels;
+    std::vector<TilePos> m_dirty_tiles;
+    TileTextureStats m_tile_texture_stats;
+
     sge::Renderer* m_renderer = nullptr;
 
     LLGL::Buffer* m_light_buffer = nullptr;
@@ -91,6 +179,7 @@ private:
     LLGL::PipelineState* m_light_vertical_pipeline = nullptr;
     LLGL::PipelineState* m_light_horizontal_pipeline = nullptr;
 
+    uint32_t m_tile_texture_width = 0;
     uint32_t m_workgroup_size = 16;
 
     bool is_metal = false;
@@ -55,6 +55,7 @@ static struct RendererState {
 uint32_t GameRenderer::GetMainOrderIndex() { return state.main_batch.order(); }
 uint32_t GameRenderer::GetWorldOrderIndex() { return state.world_batch.order(); }
 LLGL::Buffer* GameRenderer::ChunkVertexBuffer() { return state.chunk_vertex_buffer; }
+float GameRenderer::GetWorldSubmissionTime() { return state.world_renderer.submission_time(); }
 
 bool GameRenderer::Init(const LLGL::Extent2D& resolution) {
     sge::Renderer& renderer = sge::Engine::Renderer();
@@ -287,6 +288,32 @@ void GameRenderer::Render(const sge::Camera& camera, const World& world) {
     state.background_renderer.reset();
 }
 
+void GameRenderer::BeginLoading(const sge::Camera& camera) {
+    ZoneScoped;
+
+    state.ui_frustum = sge::Rect::from_corners(glm::vec2(0.0), camera.viewport());
+
+    sge::Engine::Renderer().Begin(camera);
+
+    state.ui_batch.Reset();
+}
+
+void GameRenderer::RenderLoading() {
+    ZoneScoped;
+
+    sge::Renderer& renderer = sge::Engine::Renderer();
+
+    renderer.PrepareBatch(state.ui_batch);
+    renderer.UploadBatchData();
+
+    renderer.BeginMainPass();
+        renderer.Clear(LLGL::ClearValue(0.0f, 0.0f, 0.0f, 0.0f, 0.0f));
+        renderer.RenderBatch(state.ui_batch);
+    renderer.EndPass();
+
+    renderer.End();
+}
+
 void GameRenderer::BeginOrderMode(int order, bool advance) noexcept {
     state.main_batch.BeginOrderMode(order, advance);
     state.world_batch.BeginOrderMode(order, advance);
@@ -31,6 +31,10 @@ namespace GameRenderer {
     void Begin(const sge::Camera& camera, World& world);
     void Render(const sge::Camera& camera, const World& world);
 
+    // Only the UI is drawn while the world is being generated, the world renderer isn't initialized yet
+    void BeginLoading(const sge::Camera& camera);
+    void RenderLoading();
+
     void UpdateLight();
 
     uint32_t DrawSprite(const sge::Sprite& sprite, sge::Order order = {});
@@ -93,6 +97,8 @@ namespace GameRenderer {
     [[nodiscard]] uint32_t GetMainOrderIndex();
     [[nodiscard]] uint32_t GetWorldOrderIndex();
     [[nodiscard]] LLGL::Buffer* ChunkVertexBuffer();
+    // The CPU time spent recording the world chunk draws in the last frame, in seconds
+    [[nodiscard]] float GetWorldSubmissionTime();
 };
 
 #endif
\ No newline at end of file
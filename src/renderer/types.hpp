@@ -24,19 +24,44 @@ struct ParticleInstance {
     uint32_t is_world;
 };
 
+// The tile position is absolute, so the chunk origin doesn't have to be stored per instance
 struct ChunkInstance {
-    glm::vec2 atlas_pos;
-    glm::vec2 world_pos;
-    uint16_t position;
+    uint16_t tile_x;
+    uint16_t tile_y;
+    uint8_t atlas_x;
+    uint8_t atlas_y;
     uint16_t tile_data;
 
-    ChunkInstance(uint16_t position, glm::vec2 atlas_pos, glm::vec2 world_pos, uint16_t tile_data) :
-        atlas_pos(atlas_pos),
-        world_pos(world_pos),
-        position(position),
+    ChunkInstance(uint16_t tile_x, uint16_t tile_y, uint8_t atlas_x, uint8_t atlas_y, uint16_t tile_data) :
+        tile_x(tile_x),
+        tile_y(tile_y),
+        atlas_x(atlas_x),
+        atlas_y(atlas_y),
         tile_data(tile_data) {}
 };
 
+static_assert(sizeof(ChunkInstance) == 8);
+
+// The tile data of a free instance slot, tilemap.slang doesn't draw it
+constexpr uint16_t CHUNK_INSTANCE_HIDDEN = 0xFFFF;
+
+// A whole chunk drawn as one quad, see ChunkImpostorAtlas.
+// The chunk size is stored per instance so the shader doesn't depend on --chunk-size.
+struct ChunkImpostorInstance {
+    uint16_t tile_x;
+    uint16_t tile_y;
+    uint16_t size;
+    uint16_t layer;
+
+    ChunkImpostorInstance(uint16_t tile_x, uint16_t tile_y, uint16_t size, uint16_t layer) :
+        tile_x(tile_x),
+        tile_y(tile_y),
+        size(size),
+        layer(layer) {}
+};
+
+static_assert(sizeof(ChunkImpostorInstance) == 8);
+
 struct BackgroundVertex {
     explicit BackgroundVertex(glm::vec2 position, glm::vec2 texture_size) :
         position(position),
@@ -7,4 +7,8 @@
 
 bool SupportsAcceleratedDynamicLighting(const sge::Renderer& renderer);
 
+// Whether the first instance of an indirect draw offsets the instance buffer:
+// drawIndirectFirstInstance on Vulkan, GL 4.2 or ARB_base_instance on OpenGL. macOS OpenGL 4.1 has neither.
+bool SupportsIndirectFirstInstance(const sge::Renderer& renderer);
+
 #endif
\ No newline at end of file
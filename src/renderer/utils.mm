@@ -22,4 +22,9 @@ bool SupportsAcceleratedDynamicLighting(const sge::Renderer& renderer) {
 #else
     return features.hasComputeShaders;
 #endif
+}
+
+bool SupportsIndirectFirstInstance(const sge::Renderer& renderer) {
+    const LLGL::RenderingFeatures& features = renderer.GetRenderingCaps().features;
+    return features.hasIndirectDrawing && features.hasOffsetInstancing;
 }
\ No newline at end of file
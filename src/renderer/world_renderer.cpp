@@ -1,4 +1,7 @@
 #include "world_renderer.hpp"
+#include "deferred_release.hpp"
+
+#include <chrono>
 
 #include <LLGL/Utils/Utility.h>
 #include <LLGL/PipelineStateFlags.h>
@@ -20,9 +23,11 @@
 
 #include "../assets.hpp"
 #include "../world/chunk.hpp"
+#include "../world/chunk_size.hpp"
 #include "../world/utils.hpp"
 
 #include "dynamic_lighting.hpp"
+#include "renderer.hpp"
 #include "types.hpp"
 #include "utils.hpp"
 
@@ -188,6 +193,57 @@ void WorldRenderer::init() {
 
         m_lightmap_pipeline = context->CreatePipelineState(lightPipelineDesc);
     }
+
+    {
+        LLGL::PipelineLayoutDescriptor impostorPipelineLayoutDesc;
+        impostorPipelineLayoutDesc.heapBindings = sge::BindingLayout({
+            sge::BindingLayoutItem::ConstantBuffer(2, "GlobalUniformBuffer", LLGL::StageFlags::VertexStage)
+        });
+        impostorPipelineLayoutDesc.bindings = sge::BindingLayout({
+            sge::BindingLayoutItem::Texture(3, "ImpostorArray", LLGL::StageFlags::FragmentStage)
+        });
+        impostorPipelineLayoutDesc.staticSamplers = {
+            LLGL::StaticSamplerDescriptor("Sampler", LLGL::StageFlags::FragmentStage, LLGL::BindingSlot(4), Assets::GetSampler(sge::TextureSampler::Nearest).descriptor())
+        };
+        impostorPipelineLayoutDesc.combinedTextureSamplers = {
+            LLGL::CombinedTextureSamplerDescriptor{ "ImpostorArray", "ImpostorArray", "Sampler", 3 }
+        };
+
+        LLGL::PipelineLayout* impostorPipelineLayout = context->CreatePipelineLayout(impostorPipelineLayoutDesc);
+
+        const LLGL::ResourceViewDescriptor impostorResourceViews[] = {
+            m_renderer->GlobalUniformBuffer()
+        };
+
+        m_impostor_resource_heap = context->CreateResourceHeap(impostorPipelineLayout, impostorResourceViews);
+
+        const sge::ShaderPipeline& impostor_shader = Assets::GetShader(ShaderAsset::ChunkImpostorShader);
+
+        LLGL::GraphicsPipelineDescriptor impostorPipelineDesc;
+        impostorPipelineDesc.debugName = "WorldImpostorPipeline";
+        impostorPipelineDesc.vertexShader = impostor_shader.vs;
+        impostorPipelineDesc.fragmentShader = impostor_shader.ps;
+        impostorPipelineDesc.pipelineLayout = impostorPipelineLayout;
+        impostorPipelineDesc.renderPass = m_render_pass;
+        impostorPipelineDesc.indexFormat = LLGL::Format::R16UInt;
+        impostorPipelineDesc.primitiveTopology = LLGL::PrimitiveTopology::TriangleStrip;
+        impostorPipelineDesc.rasterizer.frontCCW = true;
+        impostorPipelineDesc.rasterizer.multiSampleEnabled = (samples > 1);
+        impostorPipelineDesc.depth = LLGL::DepthDescriptor {
+            .testEnabled = true,
+            .writeEnabled = true,
+            .compareOp = LLGL::CompareOp::GreaterEqual
+        };
+        impostorPipelineDesc.blend = LLGL::BlendDescriptor {
+            .targets = {
+                LLGL::BlendTargetDescriptor {
+                    .blendEnabled = false,
+                }
+            }
+        };
+
+        m_impostor_pipeline = context->CreatePipelineState(impostorPipelineDesc);
+    }
 }
 
 void WorldRenderer::init_lighting(const WorldData& world) {
@@ -204,12 +260,12 @@ void WorldRenderer::init_targets(LLGL::Extent2D resolution) {
 
     const uint32_t samples = swap_chain->GetSamples();
 
-    SGE_RESOURCE_RELEASE(m_target);
-    SGE_RESOURCE_RELEASE(m_target_texture);
-    SGE_RESOURCE_RELEASE(m_depth_texture);
+    DeferredRelease::Release(m_target);
+    DeferredRelease::Release(m_target_texture);
+    DeferredRelease::Release(m_depth_texture);
 
-    SGE_RESOURCE_RELEASE(m_static_lightmap_target);
-    SGE_RESOURCE_RELEASE(m_static_lightmap_texture);
+    DeferredRelease::Release(m_static_lightmap_target);
+    DeferredRelease::Release(m_static_lightmap_texture);
 
     LLGL::TextureDescriptor texture_desc;
     texture_desc.miscFlags = LLGL::MiscFlags::FixedSamples;
@@ -477,33 +533,178 @@ void WorldRenderer::update_lightmap_texture(WorldData& world) {
 
 }
 
+LLGL::Buffer* WorldRenderer::draw_args_buffer(uint32_t count) {
+    if (count > m_draw_args_capacity) {
+        const auto& context = m_renderer->Context();
+
+        m_draw_args_capacity = glm::max(count, m_draw_args_capacity * 2);
+
+        LLGL::BufferDescriptor desc;
+        desc.size = m_draw_args_capacity * sizeof(LLGL::DrawIndirectArguments);
+        desc.bindFlags = LLGL::BindFlags::IndirectBuffer;
+
+        for (LLGL::Buffer*& buffer : m_draw_args_buffers) {
+            DeferredRelease::Release(buffer);
+            buffer = context->CreateBuffer(desc);
+        }
+    }
+
+    LLGL::Buffer* buffer = m_draw_args_buffers[m_frame];
+    m_frame = (m_frame + 1) % DeferredRelease::FRAMES_IN_FLIGHT;
+    return buffer;
+}
+
+LLGL::BufferArray* WorldRenderer::write_impostor_instances() {
+    const auto& context = m_renderer->Context();
+
+    const uint32_t count = m_impostor_instances.size();
+
+    if (count > m_impostor_capacity) {
+        m_impostor_capacity = glm::max(count, m_impostor_capacity * 2);
+
+        LLGL::BufferDescriptor desc;
+        desc.bindFlags = LLGL::BindFlags::VertexBuffer;
+        desc.size = m_impostor_capacity * sizeof(ChunkImpostorInstance);
+        desc.stride = sizeof(ChunkImpostorInstance);
+        desc.vertexAttribs = Assets::GetVertexFormat(VertexFormatAsset::ChunkImpostorInstance).attributes;
+
+        for (uint32_t i = 0; i < DeferredRelease::FRAMES_IN_FLIGHT; ++i) {
+            DeferredRelease::Release(m_impostor_buffer_arrays[i]);
+            DeferredRelease::Release(m_impostor_buffers[i]);
+
+            m_impostor_buffers[i] = context->CreateBuffer(desc);
+
+            LLGL::Buffer* buffers[] = { GameRenderer::ChunkVertexBuffer(), m_impostor_buffers[i] };
+            m_impostor_buffer_arrays[i] = context->CreateBufferArray(2, buffers);
+        }
+    }
+
+    const uint32_t frame = m_impostor_frame;
+    m_impostor_frame = (m_impostor_frame + 1) % DeferredRelease::FRAMES_IN_FLIGHT;
+
+    context->WriteBuffer(*m_impostor_buffers[frame], 0, m_impostor_instances.data(), count * sizeof(ChunkImpostorInstance));
+
+    return m_impostor_buffer_arrays[frame];
+}
+
 void WorldRenderer::render(const ChunkManager& chunk_manager) {
     ZoneScoped;
 
+    const auto start = std::chrono::steady_clock::now();
+
+    if (chunk_manager.lod_active()) {
+        render_impostors(chunk_manager);
+    } else {
+        render_tiles(chunk_manager);
+    }
+
+    const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - start;
+    m_submission_time = elapsed.count();
+}
+
+void WorldRenderer::render_impostors(const ChunkManager& chunk_manager) {
+    // Every chunk is a single quad sampling its layer of the atlas
+    m_impostor_instances.clear();
+
+    const uint32_t chunk_size = ChunkSize::Get();
+
+    for (const RenderChunk* chunk : chunk_manager.visible_chunks()) {
+        const glm::uvec2 tile_pos = chunk->index() * chunk_size;
+        m_impostor_instances.emplace_back(tile_pos.x, tile_pos.y, chunk_size, chunk->impostor_layer());
+    }
+
+    if (m_impostor_instances.empty()) return;
+
+    auto* const commands = m_renderer->CommandBuffer();
+
+    LLGL::BufferArray* buffer_array = write_impostor_instances();
+
+    commands->SetPipelineState(*m_impostor_pipeline);
+    commands->SetVertexBufferArray(*buffer_array);
+    commands->SetResource(0, *chunk_manager.impostor_atlas().texture());
+    commands->SetResourceHeap(*m_impostor_resource_heap);
+
+    commands->DrawInstanced(4, 0, m_impostor_instances.size());
+}
+
+void WorldRenderer::render_tiles_per_chunk(const ChunkManager& chunk_manager) {
+    const ChunkBufferPool& buffer_pool = chunk_manager.buffer_pool();
+
     auto* const commands = m_renderer->CommandBuffer();
 
     commands->SetPipelineState(*m_pipeline);
 
-    const sge::Texture& walls_texture = Assets::GetTexture(TextureAsset::Walls);
-    const sge::Texture& tiles_texture = Assets::GetTexture(TextureAsset::Tiles);
+    // Walls go first, so each texture is bound once
+    commands->SetResource(0, Assets::GetTexture(TextureAsset::Walls));
+    commands->SetResourceHeap(*m_resource_heap);
+
+    for (const RenderChunk* chunk : chunk_manager.visible_chunks()) {
+        if (chunk->wall_count() == 0) continue;
+        commands->SetVertexBufferArray(*buffer_pool.page_buffer_array(chunk->walls_page()));
+        commands->DrawInstanced(4, 0, chunk->wall_count());
+    }
+
+    commands->SetResource(0, Assets::GetTexture(TextureAsset::Tiles));
+    commands->SetResourceHeap(*m_resource_heap);
+
+    for (const RenderChunk* chunk : chunk_manager.visible_chunks()) {
+        if (chunk->block_count() == 0) continue;
+        commands->SetVertexBufferArray(*buffer_pool.page_buffer_array(chunk->blocks_page()));
+        commands->DrawInstanced(4, 0, chunk->block_count());
+    }
+}
+
+void WorldRenderer::render_tiles(const ChunkManager& chunk_manager) {
+    const ChunkBufferPool& buffer_pool = chunk_manager.buffer_pool();
+
+    // Nothing is loaded yet
+    if (!buffer_pool.valid()) return;
+
+    // The instances of every chunk start at the first one of its own buffer
+    if (!buffer_pool.shared()) {
+        render_tiles_per_chunk(chunk_manager);
+        return;
+    }
+
+    // Walls go first, so each texture is bound once
+    m_draw_args.clear();
+
+    for (const RenderChunk* chunk : chunk_manager.visible_chunks()) {
+        if (chunk->wall_count() == 0) continue;
+        m_draw_args.push_back(LLGL::DrawIndirectArguments { 4, chunk->wall_count(), 0, buffer_pool.first_instance(chunk->walls_page()) });
+    }
 
-    for (const glm::uvec2& pos : chunk_manager.visible_chunks()) {
-        const RenderChunk& chunk = chunk_manager.render_chunks().find(pos)->second;
+    const uint32_t wall_draws = m_draw_args.size();
 
-        if (chunk.wall_count() > 0) {
-            commands->SetVertexBufferArray(*chunk.wall_buffer_array());
-            commands->SetResource(0, walls_texture);
+    for (const RenderChunk* chunk : chunk_manager.visible_chunks()) {
+        if (chunk->block_count() == 0) continue;
+        m_draw_args.push_back(LLGL::DrawIndirectArguments { 4, chunk->block_count(), 0, buffer_pool.first_instance(chunk->blocks_page()) });
+    }
+
+    const uint32_t block_draws = m_draw_args.size() - wall_draws;
+
+    if (!m_draw_args.empty()) {
+        auto* const commands = m_renderer->CommandBuffer();
+        const auto& context = m_renderer->Context();
+
+        LLGL::Buffer* args_buffer = draw_args_buffer(m_draw_args.size());
+        context->WriteBuffer(*args_buffer, 0, m_draw_args.data(), m_draw_args.size() * sizeof(LLGL::DrawIndirectArguments));
+
+        commands->SetPipelineState(*m_pipeline);
+        commands->SetVertexBufferArray(*buffer_pool.buffer_array());
+
+        if (wall_draws > 0) {
+            commands->SetResource(0, Assets::GetTexture(TextureAsset::Walls));
             commands->SetResourceHeap(*m_resource_heap);
 
-            commands->DrawInstanced(4, 0, chunk.wall_count());
+            commands->DrawIndirect(*args_buffer, 0, wall_draws, sizeof(LLGL::DrawIndirectArguments));
         }
 
-        if (chunk.block_count() > 0) {
-            commands->SetVertexBufferArray(*chunk.block_buffer_array());
-            commands->SetResource(0, tiles_texture);
+        if (block_draws > 0) {
+            commands->SetResource(0, Assets::GetTexture(TextureAsset::Tiles));
             commands->SetResourceHeap(*m_resource_heap);
 
-            commands->DrawInstanced(4, 0, chunk.block_count());
+            commands->DrawIndirect(*args_buffer, wall_draws * sizeof(LLGL::DrawIndirectArguments), block_draws, sizeof(LLGL::DrawIndirectArguments));
         }
     }
 }
@@ -575,4 +776,16 @@ void WorldRenderer::terminate() {
     SGE_RESOURCE_RELEASE(m_tile_texture_data_buffer);
     SGE_RESOURCE_RELEASE(m_light_texture);
     SGE_RESOURCE_RELEASE(m_light_texture_target);
+
+    for (LLGL::Buffer*& buffer : m_draw_args_buffers) {
+        SGE_RESOURCE_RELEASE(buffer);
+    }
+
+    SGE_RESOURCE_RELEASE(m_impostor_pipeline);
+    SGE_RESOURCE_RELEASE(m_impostor_resource_heap);
+
+    for (uint32_t i = 0; i < DeferredRelease::FRAMES_IN_FLIGHT; ++i) {
+        SGE_RESOURCE_RELEASE(m_impostor_buffer_arrays[i]);
+        SGE_RESOURCE_RELEASE(m_impostor_buffers[i]);
+    }
 }
\ No newline at end of file
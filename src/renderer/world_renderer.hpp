@@ -3,7 +3,10 @@
 #ifndef RENDERER_WORLD_RENDERER_HPP_
 #define RENDERER_WORLD_RENDERER_HPP_
 
+#include <vector>
+
 #include <LLGL/LLGL.h>
+#include <LLGL/IndirectArguments.h>
 
 #include <SGE/renderer/renderer.hpp>
 
@@ -12,6 +15,7 @@
 #include "../world/chunk_manager.hpp"
 
 #include "dynamic_lighting.hpp"
+#include "deferred_release.hpp"
 
 class WorldRenderer {
 public:
@@ -43,8 +47,22 @@ public:
 
     inline LLGL::Texture* light_texture() { return m_light_texture; }
     inline LLGL::RenderTarget* light_texture_target() { return m_light_texture_target; }
+
+    // The CPU time spent recording the chunk draws in the last frame, in seconds
+    [[nodiscard]]
+    inline float submission_time() const noexcept { return m_submission_time; }
 private:
     void update_lightmap_texture(WorldData& world);
+
+    void render_tiles(const ChunkManager& chunk_manager);
+    // One draw per chunk from the buffer of its page, for the backends without SupportsIndirectFirstInstance
+    void render_tiles_per_chunk(const ChunkManager& chunk_manager);
+    void render_impostors(const ChunkManager& chunk_manager);
+
+    LLGL::Buffer* draw_args_buffer(uint32_t count);
+
+    // Writes m_impostor_instances into the buffer of the current frame
+    LLGL::BufferArray* write_impostor_instances();
 private:
     std::unordered_map<glm::uvec2, LightMapChunk> m_lightmap_chunks;
 
@@ -70,6 +88,23 @@ private:
 
     LLGL::PipelineState* m_lightmap_pipeline = nullptr;
 
+    // The chunk draws of a frame, one buffer per frame in flight
+    LLGL::Buffer* m_draw_args_buffers[DeferredRelease::FRAMES_IN_FLIGHT] = {};
+    std::vector<LLGL::DrawIndirectArguments> m_draw_args;
+    uint32_t m_draw_args_capacity = 0;
+    uint32_t m_frame = 0;
+    float m_submission_time = 0.0f;
+
+    LLGL::PipelineState* m_impostor_pipeline = nullptr;
+    LLGL::ResourceHeap* m_impostor_resource_heap = nullptr;
+
+    // The impostor instances of a frame, one buffer per frame in flight
+    LLGL::Buffer* m_impostor_buffers[DeferredRelease::FRAMES_IN_FLIGHT] = {};
+    LLGL::BufferArray* m_impostor_buffer_arrays[DeferredRelease::FRAMES_IN_FLIGHT] = {};
+    std::vector<ChunkImpostorInstance> m_impostor_instances;
+    uint32_t m_impostor_capacity = 0;
+    uint32_t m_impostor_frame = 0;
+
     uint32_t m_lightmap_width = 0;
     uint32_t m_lightmap_height = 0;
 
@@ -125,14 +125,14 @@ struct Block {
     uint8_t merge_id = 0xFF;
     bool is_merged = false;
 
-    explicit Block(BlockType tile_type) :
+    Block(BlockType tile_type, uint8_t tile_variant) :
         atlas_pos(),
         hp(block_hp(tile_type)),
         type(tile_type),
-        variant(static_cast<uint8_t>(rand() % 3)) {}
+        variant(tile_variant) {}
 
-    static Block Tree(TreeType type, TreeFrameType frame) {
-        Block tile = Block(BlockType::Tree);
+    static Block Tree(TreeType type, TreeFrameType frame, uint8_t variant) {
+        Block tile = Block(BlockType::Tree, variant);
         tile.data.tree.type = type;
         tile.data.tree.frame = frame;
         return tile;
@@ -241,6 +241,11 @@ inline constexpr bool tile_is_block(BlockTypeWithData block) {
     }
 }
 
+// The block sprite covers the whole tile
+inline constexpr bool block_is_opaque(BlockTypeWithData block) {
+    return tile_type(block) == TileType::Block;
+}
+
 inline constexpr uint8_t tree_is_trunk(TreeFrameType frame) {
     switch (frame) {
     case TreeFrameType::BranchLeftBare:
@@ -4,7 +4,6 @@
 #define TYPES_WALL_HPP_
 
 #include <cstdint>
-#include <cstdlib>
 
 #include "texture_atlas_pos.hpp"
 
@@ -24,11 +23,11 @@ struct Wall {
     WallType type;
     uint8_t variant;
 
-    Wall(WallType wall_type) :
+    Wall(WallType wall_type, uint8_t wall_variant) :
         atlas_pos(0, 0),
         hp(wall_hp(wall_type)),
         type(wall_type),
-        variant(static_cast<uint8_t>(rand() % 3)) {}
+        variant(wall_variant) {}
 };
 
 #endif
\ No newline at end of file
@@ -226,6 +226,12 @@ void UI::Update(Player& player, World& world) noexcept {
         if (state.fps_update_timer.tick(sge::Time::Delta()).just_finished()) {
             const int fps = FrameTime::GetAverageFPS();
             state.fps_text = std::to_string(fps);
+#if DEBUG_TOOLS
+            // Hitches, e.g. when panning the free camera across chunk boundaries
+            const int worst_frame_ms = FrameTime::GetWorstFrameTime() * 1000.0f;
+            const int world_submission_us = GameRenderer::GetWorldSubmissionTime() * 1e6f;
+            state.fps_text += " (max " + std::to_string(worst_frame_ms) + " ms, world " + std::to_string(world_submission_us) + " us)";
+#endif
         }
     }
 
@@ -477,4 +483,30 @@ static void draw_inventory(const Inventory& inventory, const glm::vec2&) {
     // GameRenderer::DrawTextUI(text, window_size * 0.5f - bounds * 0.5f, font, sge::Order(inventory_index));
 
     GameRenderer::EndOrderMode();
+}
+
+void UI::DrawLoading(const sge::Camera& camera, const char* pass, float progress) noexcept {
+    ZoneScoped;
+
+    static constexpr float TITLE_SIZE = 48.0f;
+    static constexpr float PASS_SIZE = 26.0f;
+    static constexpr float LINE_SPACING = 12.0f;
+
+    const glm::vec2& window_size = camera.viewport();
+    const sge::Font& font = Assets::GetFont(FontAsset::AndyBold);
+
+    const std::string title = "Generating the world: " + std::to_string(static_cast<int>(progress * 100.0f)) + "%";
+    const sge::RichText title_text = sge::rich_text(title, TITLE_SIZE, sge::LinearRgba(0.9f));
+    const glm::vec2 title_bounds = sge::calculate_text_bounds(font, title_text);
+
+    const glm::vec2 title_position = glm::vec2((window_size.x - title_bounds.x) * 0.5f, window_size.y * 0.5f - title_bounds.y);
+    GameRenderer::DrawTextUI(title_text, title_position, font);
+
+    if (pass == nullptr) return;
+
+    const sge::RichText pass_text = sge::rich_text(std::string_view(pass), PASS_SIZE, sge::LinearRgba(0.7f));
+    const glm::vec2 pass_bounds = sge::calculate_text_bounds(font, pass_text);
+
+    const glm::vec2 pass_position = glm::vec2((window_size.x - pass_bounds.x) * 0.5f, window_size.y * 0.5f + LINE_SPACING);
+    GameRenderer::DrawTextUI(pass_text, pass_position, font);
 }
\ No newline at end of file
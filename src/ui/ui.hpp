@@ -16,6 +16,8 @@ namespace UI {
     void Update(Player& player, World& world) noexcept;
     void PostUpdate() noexcept;
     void Draw(const sge::Camera& camera, const Player& player) noexcept;
+    // The name of the running pass and how much of the world is generated, from 0 to 1
+    void DrawLoading(const sge::Camera& camera, const char* pass, float progress) noexcept;
 };
 
 #endif
\ No newline at end of file
@@ -295,18 +295,48 @@ void init_tile_rules() {
     state.grass_rules[15].emplace_back("F3", "J3",   0x1000, 0x10000000, 0x00000000, 0x0000);
 }
 
-void update_block_sprite_index(Block& tile, const Neighbors<Block>& neighbors) {
+static inline Neighbors<BlockType> block_types(const Neighbors<Block>& neighbors) {
+    const auto to_type = [](const Block& block) {
+        return block.type;
+    };
+
+    return Neighbors<BlockType> {
+        .top = map(neighbors.top, to_type),
+        .bottom = map(neighbors.bottom, to_type),
+        .left = map(neighbors.left, to_type),
+        .right = map(neighbors.right, to_type),
+        .top_left = map(neighbors.top_left, to_type),
+        .top_right = map(neighbors.top_right, to_type),
+        .bottom_left = map(neighbors.bottom_left, to_type),
+        .bottom_right = map(neighbors.bottom_right, to_type),
+    };
+}
+
+// One bit per neighbor instead of the nibbles of the tile rules
+static inline uint8_t pack_mask(uint32_t mask) {
+    uint8_t packed = 0;
+    for (int i = 0; i < 8; ++i) {
+        packed |= ((mask >> (i * 4)) & 1) << i;
+    }
+    return packed;
+}
+
+static inline uint32_t unpack_mask(uint8_t packed) {
+    uint32_t mask = 0;
+    for (int i = 0; i < 8; ++i) {
+        mask |= static_cast<uint32_t>((packed >> i) & 1) << (i * 4);
+    }
+    return mask;
+}
+
+void update_fixed_block_sprite_index(Block& tile, const Neighbors<BlockType>& neighbors) {
     if (tile.type == BlockType::Torch) {
         const AnchorData anchor = block_anchor(tile.type);
 
-        const auto to_type = [](Block tile) {
-            return tile.type;
-        };
-
         uint16_t index;
-        if (block_check_anchor_vertical(map(neighbors.bottom, to_type), anchor.bottom)) index = 0;
-        else if (block_check_anchor_horizontal(map(neighbors.left, to_type), anchor.left)) index = 1;
-        else if (block_check_anchor_horizontal(map(neighbors.right, to_type), anchor.right)) index = 2;
+        if (block_check_anchor_vertical(neighbors.bottom, anchor.bottom)) index = 0;
+        else if (block_check_anchor_horizontal(neighbors.left, anchor.left)) index = 1;
+        else if (block_check_anchor_horizontal(neighbors.right, anchor.right)) index = 2;
         else index = 0;
 
         tile.atlas_pos = TextureAtlasPos(index, 0);
@@ -387,53 +417,86 @@ void update_block_sprite_index(Block& tile, const Neighbors<Block>& neighbors) {
 
         return;
     }
+}
 
-    if (tile.is_merged) return;
-
+BlockAutotileMasks block_autotile_masks(BlockType type, const Neighbors<BlockType>& neighbors) {
     uint32_t neighbors_mask = 0;
     uint32_t blend_mask = 0;
 
-    if (block_is_stone(tile.type)) {
-        neighbors_mask |= (neighbors.right.has_value()        && block_is_stone(neighbors.right->type))        ? 0x00000001 : 0x0;
-        neighbors_mask |= (neighbors.top.has_value()          && block_is_stone(neighbors.top->type))          ? 0x00000010 : 0x0;
-        neighbors_mask |= (neighbors.left.has_value()         && block_is_stone(neighbors.left->type))         ? 0x00000100 : 0x0;
-        neighbors_mask |= (neighbors.bottom.has_value()       && block_is_stone(neighbors.bottom->type))       ? 0x00001000 : 0x0;
-        neighbors_mask |= (neighbors.top_right.has_value()    && block_is_stone(neighbors.top_right->type))    ? 0x00010000 : 0x0;
-        neighbors_mask |= (neighbors.top_left.has_value()     && block_is_stone(neighbors.top_left->type))     ? 0x00100000 : 0x0;
-        neighbors_mask |= (neighbors.bottom_left.has_value()  && block_is_stone(neighbors.bottom_left->type))  ? 0x01000000 : 0x0;
-        neighbors_mask |= (neighbors.bottom_right.has_value() && block_is_stone(neighbors.bottom_right->type)) ? 0x10000000 : 0x0;
+    if (block_is_stone(type)) {
+        neighbors_mask |= (neighbors.right.has_value()        && block_is_stone(*neighbors.right))        ? 0x00000001 : 0x0;
+        neighbors_mask |= (neighbors.top.has_value()          && block_is_stone(*neighbors.top))          ? 0x00000010 : 0x0;
+        neighbors_mask |= (neighbors.left.has_value()         && block_is_stone(*neighbors.left))         ? 0x00000100 : 0x0;
+        neighbors_mask |= (neighbors.bottom.has_value()       && block_is_stone(*neighbors.bottom))       ? 0x00001000 : 0x0;
+        neighbors_mask |= (neighbors.top_right.has_value()    && block_is_stone(*neighbors.top_right))    ? 0x00010000 : 0x0;
+        neighbors_mask |= (neighbors.top_left.has_value()     && block_is_stone(*neighbors.top_left))     ? 0x00100000 : 0x0;
+        neighbors_mask |= (neighbors.bottom_left.has_value()  && block_is_stone(*neighbors.bottom_left))  ? 0x01000000 : 0x0;
+        neighbors_mask |= (neighbors.bottom_right.has_value() && block_is_stone(*neighbors.bottom_right)) ? 0x10000000 : 0x0;
     } else {
-        neighbors_mask |= (neighbors.right.has_value()        && block_merges_with(tile.type, neighbors.right->type))        ? 0x00000001 : 0x0;
-        neighbors_mask |= (neighbors.top.has_value()          && block_merges_with(tile.type, neighbors.top->type))          ? 0x00000010 : 0x0;
-        neighbors_mask |= (neighbors.left.has_value()         && block_merges_with(tile.type, neighbors.left->type))         ? 0x00000100 : 0x0;
-        neighbors_mask |= (neighbors.bottom.has_value()       && block_merges_with(tile.type, neighbors.bottom->type))       ? 0x00001000 : 0x0;
-        neighbors_mask |= (neighbors.top_right.has_value()    && block_merges_with(tile.type, neighbors.top_right->type))    ? 0x00010000 : 0x0;
-        neighbors_mask |= (neighbors.top_left.has_value()     && block_merges_with(tile.type, neighbors.top_left->type))     ? 0x00100000 : 0x0;
-        neighbors_mask |= (neighbors.bottom_left.has_value()  && block_merges_with(tile.type, neighbors.bottom_left->type))  ? 0x01000000 : 0x0;
-        neighbors_mask |= (neighbors.bottom_right.has_value() && block_merges_with(tile.type, neighbors.bottom_right->type)) ? 0x10000000 : 0x0;
-
-        neighbors_mask |= (neighbors.right.has_value()        && neighbors.right->type        == tile.type) ? 0x00000001 : 0x0;
-        neighbors_mask |= (neighbors.top.has_value()          && neighbors.top->type          == tile.type) ? 0x00000010 : 0x0;
-        neighbors_mask |= (neighbors.left.has_value()         && neighbors.left->type         == tile.type) ? 0x00000100 : 0x0;
-        neighbors_mask |= (neighbors.bottom.has_value()       && neighbors.bottom->type       == tile.type) ? 0x00001000 : 0x0;
-        neighbors_mask |= (neighbors.top_right.has_value()    && neighbors.top_right->type    == tile.type) ? 0x00010000 : 0x0;
-        neighbors_mask |= (neighbors.top_left.has_value()     && neighbors.top_left->type     == tile.type) ? 0x00100000 : 0x0;
-        neighbors_mask |= (neighbors.bottom_left.has_value()  && neighbors.bottom_left->type  == tile.type) ? 0x01000000 : 0x0;
-        neighbors_mask |= (neighbors.bottom_right.has_value() && neighbors.bottom_right->type == tile.type) ? 0x10000000 : 0x0;
+        neighbors_mask |= (neighbors.right.has_value()        && block_merges_with(type, *neighbors.right))        ? 0x00000001 : 0x0;
+        neighbors_mask |= (neighbors.top.has_value()          && block_merges_with(type, *neighbors.top))          ? 0x00000010 : 0x0;
+        neighbors_mask |= (neighbors.left.has_value()         && block_merges_with(type, *neighbors.left))         ? 0x00000100 : 0x0;
+        neighbors_mask |= (neighbors.bottom.has_value()       && block_merges_with(type, *neighbors.bottom))       ? 0x00001000 : 0x0;
+        neighbors_mask |= (neighbors.top_right.has_value()    && block_merges_with(type, *neighbors.top_right))    ? 0x00010000 : 0x0;
+        neighbors_mask |= (neighbors.top_left.has_value()     && block_merges_with(type, *neighbors.top_left))     ? 0x00100000 : 0x0;
+        neighbors_mask |= (neighbors.bottom_left.has_value()  && block_merges_with(type, *neighbors.bottom_left))  ? 0x01000000 : 0x0;
+        neighbors_mask |= (neighbors.bottom_right.has_value() && block_merges_with(type, *neighbors.bottom_right)) ? 0x10000000 : 0x0;
+
+        neighbors_mask |= (neighbors.right.has_value()        && *neighbors.right        == type) ? 0x00000001 : 0x0;
+        neighbors_mask |= (neighbors.top.has_value()          && *neighbors.top          == type) ? 0x00000010 : 0x0;
+        neighbors_mask |= (neighbors.left.has_value()         && *neighbors.left         == type) ? 0x00000100 : 0x0;
+        neighbors_mask |= (neighbors.bottom.has_value()       && *neighbors.bottom       == type) ? 0x00001000 : 0x0;
+        neighbors_mask |= (neighbors.top_right.has_value()    && *neighbors.top_right    == type) ? 0x00010000 : 0x0;
+        neighbors_mask |= (neighbors.top_left.has_value()     && *neighbors.top_left     == type) ? 0x00100000 : 0x0;
+        neighbors_mask |= (neighbors.bottom_left.has_value()  && *neighbors.bottom_left  == type) ? 0x01000000 : 0x0;
+        neighbors_mask |= (neighbors.bottom_right.has_value() && *neighbors.bottom_right == type) ? 0x10000000 : 0x0;
+    }
+
+    const std::optional<BlockType> merge_with = block_merge_with(type);
+
+    // Grass uses its own rules without the blend mask
+    if (type != BlockType::Grass && merge_with.has_value()) {
+        blend_mask |= (neighbors.right.has_value()        && *neighbors.right        == merge_with.value()) ? 0x00000001 : 0x0;
+        blend_mask |= (neighbors.top.has_value()          && *neighbors.top          == merge_with.value()) ? 0x00000010 : 0x0;
+        blend_mask |= (neighbors.left.has_value()         && *neighbors.left         == merge_with.value()) ? 0x00000100 : 0x0;
+        blend_mask |= (neighbors.bottom.has_value()       && *neighbors.bottom       == merge_with.value()) ? 0x00001000 : 0x0;
+        blend_mask |= (neighbors.top_right.has_value()    && *neighbors.top_right    == merge_with.value()) ? 0x00010000 : 0x0;
+        blend_mask |= (neighbors.top_left.has_value()     && *neighbors.top_left     == merge_with.value()) ? 0x00100000 : 0x0;
+        blend_mask |= (neighbors.bottom_left.has_value()  && *neighbors.bottom_left  == merge_with.value()) ? 0x01000000 : 0x0;
+        blend_mask |= (neighbors.bottom_right.has_value() && *neighbors.bottom_right == merge_with.value()) ? 0x10000000 : 0x0;
     }
 
-    if (!tile.is_merged) {
+    uint8_t merging = 0;
+    merging |= (neighbors.right.has_value()  && block_merges_with(type, *neighbors.right))  ? 0x1 : 0x0;
+    merging |= (neighbors.top.has_value()    && block_merges_with(type, *neighbors.top))    ? 0x2 : 0x0;
+    merging |= (neighbors.left.has_value()   && block_merges_with(type, *neighbors.left))   ? 0x4 : 0x0;
+    merging |= (neighbors.bottom.has_value() && block_merges_with(type, *neighbors.bottom)) ? 0x8 : 0x0;
+
+    return BlockAutotileMasks {
+        .neighbors = pack_mask(neighbors_mask),
+        .blend = pack_mask(blend_mask),
+        .merging = merging
+    };
+}
+
+void resolve_block_sprite_index(Block& tile, const BlockAutotileMasks& masks, const uint8_t* merge_ids) {
+    // The right, top, left and bottom bits of the neighbors mask and the bits of the neighbor merge ids that connect back to the block
+    static constexpr uint32_t SIDE_BITS[4] = { 0x00000001, 0x00000010, 0x00000100, 0x00001000 };
+    static constexpr uint8_t MERGE_ID_BITS[4] = { 0x04, 0x08, 0x01, 0x02 };
+
+    uint32_t neighbors_mask = unpack_mask(masks.neighbors);
+    const uint32_t blend_mask = unpack_mask(masks.blend);
+
+    if (merge_ids != nullptr) {
         bool check_ready = true;
-        check_ready &= (!neighbors.right.has_value()  || !block_merges_with(tile.type, neighbors.right->type))  ? true : (neighbors.right->merge_id  != 0xFF);
-        check_ready &= (!neighbors.top.has_value()    || !block_merges_with(tile.type, neighbors.top->type))    ? true : (neighbors.top->merge_id    != 0xFF);
-        check_ready &= (!neighbors.left.has_value()   || !block_merges_with(tile.type, neighbors.left->type))   ? true : (neighbors.left->merge_id   != 0xFF);
-        check_ready &= (!neighbors.bottom.has_value() || !block_merges_with(tile.type, neighbors.bottom->type)) ? true : (neighbors.bottom->merge_id != 0xFF);
+        for (int i = 0; i < 4; ++i) {
+            if ((masks.merging >> i) & 1) check_ready &= merge_ids[i] != 0xFF;
+        }
 
         if (check_ready) {
-            neighbors_mask &= 0x11111110 | ((!neighbors.right.has_value()  || !block_merges_with(tile.type, neighbors.right->type))  ? 0x00000001 : ((neighbors.right->merge_id  & 0x04) >> 2));
-            neighbors_mask &= 0x11111101 | ((!neighbors.top.has_value()    || !block_merges_with(tile.type, neighbors.top->type))    ? 0x00000010 : ((neighbors.top->merge_id    & 0x08) << 1));
-            neighbors_mask &= 0x11111011 | ((!neighbors.left.has_value()   || !block_merges_with(tile.type, neighbors.left->type))   ? 0x00000100 : ((neighbors.left->merge_id   & 0x01) << 8));
-            neighbors_mask &= 0x11110111 | ((!neighbors.bottom.has_value() || !block_merges_with(tile.type, neighbors.bottom->type)) ? 0x00001000 : ((neighbors.bottom->merge_id & 0x02) << 11));
+            for (int i = 0; i < 4; ++i) {
+                if (((masks.merging >> i) & 1) && (merge_ids[i] & MERGE_ID_BITS[i]) == 0) neighbors_mask &= ~SIDE_BITS[i];
+            }
             tile.is_merged = true;
         }
     }
@@ -465,15 +528,6 @@ void update_block_sprite_index(Block& tile, const Neighbors<Block>& neighbors) {
             }
         }
     } else if (merge_with.has_value()) {
-        blend_mask |= (neighbors.right.has_value()        && neighbors.right->type        == merge_with.value()) ? 0x00000001 : 0x0;
-        blend_mask |= (neighbors.top.has_value()          && neighbors.top->type          == merge_with.value()) ? 0x00000010 : 0x0;
-        blend_mask |= (neighbors.left.has_value()         && neighbors.left->type         == merge_with.value()) ? 0x00000100 : 0x0;
-        blend_mask |= (neighbors.bottom.has_value()       && neighbors.bottom->type       == merge_with.value()) ? 0x00001000 : 0x0;
-        blend_mask |= (neighbors.top_right.has_value()    && neighbors.top_right->type    == merge_with.value()) ? 0x00010000 : 0x0;
-        blend_mask |= (neighbors.top_left.has_value()     && neighbors.top_left->type     == merge_with.value()) ? 0x00100000 : 0x0;
-        blend_mask |= (neighbors.bottom_left.has_value()  && neighbors.bottom_left->type  == merge_with.value()) ? 0x01000000 : 0x0;
-        blend_mask |= (neighbors.bottom_right.has_value() && neighbors.bottom_right->type == merge_with.value()) ? 0x10000000 : 0x0;
-
         for (const TileRule& rule : state.blend_rules[bucket_id]) {
             if (rule.matches(neighbors_mask, blend_mask)) {
                 index = rule.indexes[tile.variant];
@@ -493,18 +547,35 @@ void update_block_sprite_index(Block& tile, const Neighbors<Block>& neighbors) {
     tile.atlas_pos = index;
 }
 
-void update_wall_sprite_index(Wall& wall, const Neighbors<Wall>& neighbors) {
+void update_block_sprite_index(Block& tile, const Neighbors<Block>& neighbors) {
+    if (!block_is_autotiled(tile.type)) {
+        update_fixed_block_sprite_index(tile, block_types(neighbors));
+        return;
+    }
+
+    if (tile.is_merged) return;
+
+    const auto merge_id = [](const std::optional<Block>& block) -> uint8_t {
+        return block.has_value() ? block->merge_id : 0xFF;
+    };
+
+    const uint8_t merge_ids[4] = { merge_id(neighbors.right), merge_id(neighbors.top), merge_id(neighbors.left), merge_id(neighbors.bottom) };
+
+    resolve_block_sprite_index(tile, block_autotile_masks(tile.type, block_types(neighbors)), merge_ids);
+}
+
+void update_wall_sprite_index(Wall& wall, const Neighbors<WallType>& neighbors) {
     uint32_t neighbors_mask = 0;
     uint32_t blend_mask = 0;
 
-    neighbors_mask |= (neighbors.right.has_value()        && neighbors.right->type        == wall.type) ? 0x00000001 : 0x0;
-    neighbors_mask |= (neighbors.top.has_value()          && neighbors.top->type          == wall.type) ? 0x00000010 : 0x0;
-    neighbors_mask |= (neighbors.left.has_value()         && neighbors.left->type         == wall.type) ? 0x00000100 : 0x0;
-    neighbors_mask |= (neighbors.bottom.has_value()       && neighbors.bottom->type       == wall.type) ? 0x00001000 : 0x0;
-    neighbors_mask |= (neighbors.top_right.has_value()    && neighbors.top_right->type    == wall.type) ? 0x00010000 : 0x0;
-    neighbors_mask |= (neighbors.top_left.has_value()     && neighbors.top_left->type     == wall.type) ? 0x00100000 : 0x0;
-    neighbors_mask |= (neighbors.bottom_left.has_value()  && neighbors.bottom_left->type  == wall.type) ? 0x01000000 : 0x0;
-    neighbors_mask |= (neighbors.bottom_right.has_value() && neighbors.bottom_right->type == wall.type) ? 0x10000000 : 0x0;
+    neighbors_mask |= (neighbors.right.has_value()        && *neighbors.right        == wall.type) ? 0x00000001 : 0x0;
+    neighbors_mask |= (neighbors.top.has_value()          && *neighbors.top          == wall.type) ? 0x00000010 : 0x0;
+    neighbors_mask |= (neighbors.left.has_value()         && *neighbors.left         == wall.type) ? 0x00000100 : 0x0;
+    neighbors_mask |= (neighbors.bottom.has_value()       && *neighbors.bottom       == wall.type) ? 0x00001000 : 0x0;
+    neighbors_mask |= (neighbors.top_right.has_value()    && *neighbors.top_right    == wall.type) ? 0x00010000 : 0x0;
+    neighbors_mask |= (neighbors.top_left.has_value()     && *neighbors.top_left     == wall.type) ? 0x00100000 : 0x0;
+    neighbors_mask |= (neighbors.bottom_left.has_value()  && *neighbors.bottom_left  == wall.type) ? 0x01000000 : 0x0;
+    neighbors_mask |= (neighbors.bottom_right.has_value() && *neighbors.bottom_right == wall.type) ? 0x10000000 : 0x0;
 
     uint32_t bucket_id = ((neighbors_mask & 0x00001000) >> 9) + ((neighbors_mask & 0x00000100) >> 6) + ((neighbors_mask & 0x00000010) >> 3) + (neighbors_mask & 0x00000001);
 
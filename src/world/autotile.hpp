@@ -6,9 +6,36 @@
 #include "../types/block.hpp"
 #include "world.hpp"
 
+// The neighbor masks of an autotiled block, they only depend on the types of the block and its neighbors.
+// One bit per neighbor: right, top, left, bottom, top right, top left, bottom left, bottom right.
+struct BlockAutotileMasks {
+    uint8_t neighbors = 0;
+    uint8_t blend = 0;
+    // The right, top, left and bottom neighbors the block merges with, in the lower 4 bits
+    uint8_t merging = 0;
+};
+
+// Torches and trees have fixed sprites and don't merge with their neighbors
+[[nodiscard]]
+inline constexpr bool block_is_autotiled(BlockType type) {
+    return type != BlockType::Torch && type != BlockType::Tree;
+}
+
 void init_tile_rules();
 void update_block_sprite_index(Block& block, const Neighbors<Block>& neighbors);
-void update_wall_sprite_index(Wall& block, const Neighbors<Wall>& neighbors);
+void update_wall_sprite_index(Wall& block, const Neighbors<WallType>& neighbors);
 void reset_tiles(const TilePos& initial_pos, World& world);
 
+// The pieces of update_block_sprite_index, so the whole world can be autotiled in parallel
+
+// Sets the sprite of a torch or a tree
+void update_fixed_block_sprite_index(Block& block, const Neighbors<BlockType>& neighbors);
+
+[[nodiscard]]
+BlockAutotileMasks block_autotile_masks(BlockType type, const Neighbors<BlockType>& neighbors);
+
+// Sets the atlas position and the merge id of an autotiled block. `merge_ids` are the merge ids of the right, top,
+// left and bottom neighbors. The block is merged unless `merge_ids` is null or a neighbor it merges with has no merge id yet.
+void resolve_block_sprite_index(Block& block, const BlockAutotileMasks& masks, const uint8_t* merge_ids);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "batch_noise.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include <SGE/defines.hpp>
+
+// The gradient table of FastNoiseLite: 24 gradients repeated 5 times and 8 diagonals
+static constexpr float GRADIENTS_24[] = {
+    0.130526192220052f, 0.99144486137381f, 0.38268343236509f, 0.923879532511287f, 0.608761429008721f, 0.793353340291235f, 0.793353340291235f, 0.608761429008721f,
+    0.923879532511287f, 0.38268343236509f, 0.99144486137381f, 0.130526192220051f, 0.99144486137381f, -0.130526192220051f, 0.923879532511287f, -0.38268343236509f,
+    0.793353340291235f, -0.60876142900872f, 0.608761429008721f, -0.793353340291235f, 0.38268343236509f, -0.923879532511287f, 0.130526192220052f, -0.99144486137381f,
+    -0.130526192220052f, -0.99144486137381f, -0.38268343236509f, -0.923879532511287f, -0.608761429008721f, -0.793353340291235f, -0.793353340291235f, -0.608761429008721f,
+    -0.923879532511287f, -0.38268343236509f, -0.99144486137381f, -0.130526192220052f, -0.99144486137381f, 0.130526192220051f, -0.923879532511287f, 0.38268343236509f,
+    -0.793353340291235f, 0.608761429008721f, -0.608761429008721f, 0.793353340291235f, -0.38268343236509f, 0.923879532511287f, -0.130526192220052f, 0.99144486137381f,
+};
+
+static constexpr float GRADIENTS_TAIL[] = {
+    0.38268343236509f, 0.923879532511287f, 0.923879532511287f, 0.38268343236509f, 0.923879532511287f, -0.38268343236509f, 0.38268343236509f, -0.923879532511287f,
+    -0.38268343236509f, -0.923879532511287f, -0.923879532511287f, -0.38268343236509f, -0.923879532511287f, 0.38268343236509f, -0.38268343236509f, 0.923879532511287f,
+};
+
+static constexpr std::array<float, 256> make_gradients() {
+    std::array<float, 256> gradients{};
+    constexpr size_t repeated = gradients.size() - std::size(GRADIENTS_TAIL);
+
+    for (size_t i = 0; i < repeated; ++i) {
+        gradients[i] = GRADIENTS_24[i % std::size(GRADIENTS_24)];
+    }
+    for (size_t i = 0; i < std::size(GRADIENTS_TAIL); ++i) {
+        gradients[repeated + i] = GRADIENTS_TAIL[i];
+    }
+    return gradients;
+}
+
+alignas(64) static constexpr std::array<float, 256> GRADIENTS = make_gradients();
+
+// The hashes only use the low 32 bits of FastNoiseLite's 64 bit products, so 32 bit lanes give the same gradients
+static constexpr uint32_t PRIME_X = 501125321u;
+static constexpr uint32_t PRIME_Y = 1136930381u;
+
+static constexpr float SQRT3 = 1.7320508075688772935274463415059f;
+static constexpr float F2 = 0.5f * (SQRT3 - 1);
+static constexpr float G2 = (3 - SQRT3) / 6;
+
+static SGE_FORCE_INLINE int fast_floor(float f) {
+    const int i = static_cast<int>(f);
+    return f >= 0 ? i : i - 1;
+}
+
+static SGE_FORCE_INLINE float lerp(float a, float b, float t) {
+    return a + t * (b - a);
+}
+
+static SGE_FORCE_INLINE float interp_quintic(float t) {
+    return t * t * t * (t * (t * 6 - 15) + 10);
+}
+
+static SGE_FORCE_INLINE float grad_coord(uint32_t seed, uint32_t x_primed, uint32_t y_primed, float xd, float yd) {
+    uint32_t hash = (seed ^ x_primed ^ y_primed) * 0x27d4eb2du;
+    hash ^= hash >> 15;
+    hash &= 127 << 1;
+
+    return xd * GRADIENTS[hash] + yd * GRADIENTS[hash | 1];
+}
+
+static SGE_FORCE_INLINE float single_perlin(uint32_t seed, float x, float y) {
+    const int x0 = fast_floor(x);
+    const int y0 = fast_floor(y);
+
+    const float xd0 = x - static_cast<float>(x0);
+    const float yd0 = y - static_cast<float>(y0);
+    const float xd1 = xd0 - 1;
+    const float yd1 = yd0 - 1;
+
+    const float xs = interp_quintic(xd0);
+    const float ys = interp_quintic(yd0);
+
+    const uint32_t x0_primed = static_cast<uint32_t>(x0) * PRIME_X;
+    const uint32_t y0_primed = static_cast<uint32_t>(y0) * PRIME_Y;
+    const uint32_t x1_primed = x0_primed + PRIME_X;
+    const uint32_t y1_primed = y0_primed + PRIME_Y;
+
+    const float xf0 = lerp(grad_coord(seed, x0_primed, y0_primed, xd0, yd0), grad_coord(seed, x1_primed, y0_primed, xd1, yd0), xs);
+    const float xf1 = lerp(grad_coord(seed, x0_primed, y1_primed, xd0, yd1), grad_coord(seed, x1_primed, y1_primed, xd1, yd1), xs);
+
+    return lerp(xf0, xf1, ys) * 1.4247691104677813f;
+}
+
+// The coordinates are already skewed. The three corners are always evaluated and masked,
+// so every lane runs the same instructions.
+static SGE_FORCE_INLINE float single_simplex(uint32_t seed, float x, float y) {
+    const int i = fast_floor(x);
+    const int j = fast_floor(y);
+    const float xi = x - static_cast<float>(i);
+    const float yi = y - static_cast<float>(j);
+
+    const float t = (xi + yi) * G2;
+    const float x0 = xi - t;
+    const float y0 = yi - t;
+
+    const uint32_t i_primed = static_cast<uint32_t>(i) * PRIME_X;
+    const uint32_t j_primed = static_cast<uint32_t>(j) * PRIME_Y;
+
+    const float a = 0.5f - x0 * x0 - y0 * y0;
+    const float g0 = grad_coord(seed, i_primed, j_primed, x0, y0);
+    const float n0 = a <= 0 ? 0.0f : (a * a) * (a * a) * g0;
+
+    const float c = static_cast<float>(2 * (1 - 2 * G2) * (1 / G2 - 2)) * t + (static_cast<float>(-2 * (1 - 2 * G2) * (1 - 2 * G2)) + a);
+    const float x2 = x0 + (2 * G2 - 1);
+    const float y2 = y0 + (2 * G2 - 1);
+    const float g2 = grad_coord(seed, i_primed + PRIME_X, j_primed + PRIME_Y, x2, y2);
+    const float n2 = c <= 0 ? 0.0f : (c * c) * (c * c) * g2;
+
+    const bool upper = y0 > x0;
+    const float x1 = x0 + (upper ? G2 : G2 - 1);
+    const float y1 = y0 + (upper ? G2 - 1 : G2);
+    const uint32_t i1_primed = i_primed + (upper ? 0 : PRIME_X);
+    const uint32_t j1_primed = j_primed + (upper ? PRIME_Y : 0);
+    const float b = 0.5f - x1 * x1 - y1 * y1;
+    const float g1 = grad_coord(seed, i1_primed, j1_primed, x1, y1);
+    const float n1 = b <= 0 ? 0.0f : (b * b) * (b * b) * g1;
+
+    return (n0 + n1 + n2) * 99.83685446303647f;
+}
+
+BatchNoise::BatchNoise(const BatchNoiseSettings& settings) :
+    m_settings(settings)
+{
+    m_settings.octaves = std::clamp(settings.octaves, 1, MAX_OCTAVES);
+
+    const float gain = std::abs(m_settings.gain);
+    float amp = gain;
+    float amp_fractal = 1.0f;
+    for (int i = 1; i < m_settings.octaves; ++i) {
+        amp_fractal += amp;
+        amp *= gain;
+    }
+    m_fractal_bounding = 1 / amp_fractal;
+
+    amp = m_fractal_bounding;
+    for (int i = 0; i < m_settings.octaves; ++i) {
+        m_amplitudes[i] = amp;
+        amp *= m_settings.gain;
+    }
+}
+
+void BatchNoise::lanes(const float* in_x, const float* in_y, float* out) const {
+    const BatchNoiseType type = m_settings.type;
+    const float lacunarity = m_settings.lacunarity;
+    const float gain = m_settings.gain;
+    const float weighted_strength = m_settings.weighted_strength;
+    const bool weighted = weighted_strength != 0.0f;
+
+    alignas(32) float x[LANES];
+    alignas(32) float y[LANES];
+    alignas(32) float sum[LANES];
+    alignas(32) float amp[LANES];
+
+    for (int l = 0; l < LANES; ++l) {
+        x[l] = in_x[l];
+        y[l] = in_y[l];
+        sum[l] = 0.0f;
+        amp[l] = m_fractal_bounding;
+    }
+
+    uint32_t seed = static_cast<uint32_t>(m_settings.seed);
+
+    for (int octave = 0; octave < m_settings.octaves; ++octave, ++seed) {
+        alignas(32) float noise[LANES];
+
+        if (type == BatchNoiseType::Perlin) {
+            for (int l = 0; l < LANES; ++l) noise[l] = single_perlin(seed, x[l], y[l]);
+        } else {
+            for (int l = 0; l < LANES; ++l) noise[l] = single_simplex(seed, x[l], y[l]);
+        }
+
+        if (weighted) {
+            for (int l = 0; l < LANES; ++l) {
+                sum[l] += noise[l] * amp[l];
+                amp[l] *= lerp(1.0f, std::min(noise[l] + 1, 2.0f) * 0.5f, weighted_strength);
+                amp[l] *= gain;
+            }
+        } else {
+            const float octave_amp = m_amplitudes[octave];
+            for (int l = 0; l < LANES; ++l) {
+                sum[l] += noise[l] * octave_amp;
+            }
+        }
+
+        for (int l = 0; l < LANES; ++l) {
+            x[l] *= lacunarity;
+            y[l] *= lacunarity;
+        }
+    }
+
+    for (int l = 0; l < LANES; ++l) out[l] = sum[l];
+}
+
+void BatchNoise::row(int from_x, int y, int count, float* out) const {
+    const float frequency = m_settings.frequency;
+    const bool skew = m_settings.type == BatchNoiseType::OpenSimplex2;
+
+    alignas(32) float xs[LANES];
+    alignas(32) float ys[LANES];
+    alignas(32) float values[LANES];
+
+    // The last group is evaluated whole too, so a tile gets the same value wherever the row starts
+    for (int i = 0; i < count; i += LANES) {
+        for (int l = 0; l < LANES; ++l) {
+            float fx = static_cast<float>(from_x + i + l) * frequency;
+            float fy = static_cast<float>(y) * frequency;
+
+            if (skew) {
+                const float t = (fx + fy) * F2;
+                fx += t;
+                fy += t;
+            }
+
+            xs[l] = fx;
+            ys[l] = fy;
+        }
+
+        lanes(xs, ys, values);
+
+        const int n = std::min(LANES, count - i);
+        std::copy_n(values, n, out + i);
+    }
+}
+
+float BatchNoise::get(int x, int y) const {
+    float value;
+    row(x, y, 1, &value);
+    return value;
+}
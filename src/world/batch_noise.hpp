@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef WORLD_BATCH_NOISE_HPP_
+#define WORLD_BATCH_NOISE_HPP_
+
+#include <cstdint>
+
+enum class BatchNoiseType : uint8_t {
+    Perlin = 0,
+    OpenSimplex2
+};
+
+// The defaults are the ones of FastNoiseLite
+struct BatchNoiseSettings {
+    BatchNoiseType type = BatchNoiseType::Perlin;
+    int seed = 1337;
+    float frequency = 0.01f;
+    int octaves = 3;
+    float lacunarity = 2.0f;
+    float gain = 0.5f;
+    float weighted_strength = 0.0f;
+};
+
+// 2D fBm noise that gives the same values as FastNoiseLite with FractalType_FBm (up to float rounding
+// for OpenSimplex2), but evaluated a row of tiles at a time. The tiles are processed in fixed groups
+// of LANES with branchless loops, so the compiler turns every octave into SIMD code, and the octave
+// amplitudes are computed once instead of for every tile.
+class BatchNoise {
+public:
+    static constexpr int LANES = 8;
+    static constexpr int MAX_OCTAVES = 8;
+
+    explicit BatchNoise(const BatchNoiseSettings& settings);
+
+    // Writes the noise of the tiles [from_x, from_x + count) of the row `y` into `out`
+    void row(int from_x, int y, int count, float* out) const;
+
+    [[nodiscard]]
+    float get(int x, int y) const;
+
+    [[nodiscard]]
+    inline const BatchNoiseSettings& settings() const noexcept {
+        return m_settings;
+    }
+
+private:
+    void lanes(const float* x, const float* y, float* out) const;
+
+private:
+    BatchNoiseSettings m_settings;
+    // The amplitude of every octave, only used without weighted strength
+    float m_amplitudes[MAX_OCTAVES];
+    float m_fractal_bounding = 1.0f;
+};
+
+#endif
@@ -1,165 +1,209 @@
 #include "chunk.hpp"
 
-#include <SGE/engine.hpp>
-#include <SGE/renderer/macros.hpp>
+#include <algorithm>
+#include <chrono>
+#include <optional>
+
 #include <SGE/defines.hpp>
 #include <SGE/profile.hpp>
 
-#include "../types/block.hpp"
-#include "../types/texture_atlas_pos.hpp"
 #include "../renderer/types.hpp"
 
-#include "../renderer/renderer.hpp"
+#include "chunk_mesh_builder.hpp"
+#include "world_data.hpp"
 
-using Constants::SUBDIVISION;
-using Constants::RENDER_CHUNK_SIZE;
-using Constants::RENDER_CHUNK_SIZE_U;
+// Above 1/8 of the chunk edited at once a rebuild on the workers is cheaper
+static constexpr size_t MAX_EDITED_RATIO = 8;
 
-void RenderChunk::destroy() {
-    ZoneScoped;
+// The layer is rebuilt to compact the slots once more than 1/4 of them are free
+static constexpr size_t COMPACTION_RATIO = 4;
 
-    const auto& context = sge::Engine::Renderer().Context();
+// Changed slots closer than this are written with a single WriteBuffer
+static constexpr uint16_t MAX_SLOT_GAP = 8;
 
-    SGE_RESOURCE_RELEASE(m_block_instance_buffer);
-    SGE_RESOURCE_RELEASE(m_wall_instance_buffer);
-}
+static const ChunkInstance HIDDEN_INSTANCE = ChunkInstance(0, 0, 0, 0, CHUNK_INSTANCE_HIDDEN);
 
-static inline LLGL::BufferDescriptor GetBufferDescriptor() {
-    LLGL::BufferDescriptor buffer_desc;
-    buffer_desc.bindFlags = LLGL::BindFlags::VertexBuffer;
-    buffer_desc.size = sizeof(ChunkInstance) * RENDER_CHUNK_SIZE_U * RENDER_CHUNK_SIZE_U;
-    buffer_desc.stride = sizeof(ChunkInstance);
-    buffer_desc.vertexAttribs = Assets::GetVertexFormat(VertexFormatAsset::TilemapInstance).attributes;
-    return buffer_desc;
-}
+static uint64_t upload_layer(ChunkMeshLayer& layer, const ChunkInstance* data, const uint16_t* tiles, uint16_t count, ChunkBufferPool& buffer_pool) {
+    layer.instances.assign(data, data + count);
+    layer.tile_slots.assign(ChunkSize::TileCount(), ChunkMeshLayer::NO_SLOT);
+    layer.free_slots.clear();
 
-static SGE_FORCE_INLINE uint16_t pack_tile_data(uint16_t tile_texture_id, uint8_t tile_type) {
-    // 6 bits for tile_type and 10 bits for tile_texture_id
-    return (tile_type & 0x3f) | (tile_texture_id << 6);
-}
+    for (uint16_t slot = 0; slot < count; ++slot) {
+        layer.tile_slots[tiles[slot]] = slot;
+    }
 
-static SGE_FORCE_INLINE uint16_t pack_position(uint8_t x, uint8_t y) {
-    return (y << 8) | x;
+    if (count == 0) return 0;
+
+    // Empty chunks (e.g. the sky) don't take pages from the pool
+    if (!layer.page.valid()) layer.page = buffer_pool.acquire();
+
+    buffer_pool.write(layer.page, 0, data, count);
+
+    return count * sizeof(ChunkInstance);
 }
 
-static inline uint16_t fill_block_buffer(const WorldData& world, ChunkInstance* data, glm::uvec2 index, glm::vec2 world_pos) {
-    uint16_t count = 0;
-
-    for (uint8_t y = 0; y < RENDER_CHUNK_SIZE_U; ++y) {
-        for (uint8_t x = 0; x < RENDER_CHUNK_SIZE_U; ++x) {
-            const glm::uvec2 map_pos = glm::uvec2(
-                index.x * RENDER_CHUNK_SIZE_U + x,
-                index.y * RENDER_CHUNK_SIZE_U + y
-            );
-
-            const std::optional<Block> tile = world.get_block(map_pos);
-            if (tile.has_value()) {
-                count++;
-
-                const glm::vec2 atlas_pos = glm::vec2(tile->atlas_pos.x, tile->atlas_pos.y);
-                const uint8_t type = tile_type(tile.value());
-                const uint16_t texture_id = static_cast<uint16_t>(tile_texture_type(tile.value()));
-                const uint16_t tile_data = pack_tile_data(texture_id, type);
-
-                data->position = pack_position(x, y);
-                data->atlas_pos = atlas_pos;
-                data->world_pos = world_pos;
-                data->tile_data = tile_data;
-                data++;
+template <typename GetInstance>
+static bool update_layer(ChunkMeshLayer& layer, glm::uvec2 chunk_index, ChunkBufferPool& buffer_pool, ChunkMeshStats& stats, std::vector<uint16_t>& changed_slots, GetInstance get_instance) {
+    // The edits are applied on top of the rebuild once it's uploaded
+    if (layer.pending_id != 0) return true;
+
+    if (layer.tile_slots.empty()) return false;
+    if (layer.dirty_tiles.size() * MAX_EDITED_RATIO > ChunkSize::TileCount()) return false;
+    if (layer.free_slots.size() * COMPACTION_RATIO > layer.instances.size()) return false;
+
+    ZoneScoped;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::sort(layer.dirty_tiles.begin(), layer.dirty_tiles.end());
+    layer.dirty_tiles.erase(std::unique(layer.dirty_tiles.begin(), layer.dirty_tiles.end()), layer.dirty_tiles.end());
+
+    changed_slots.clear();
+
+    const uint32_t chunk_size = ChunkSize::Get();
+    const glm::uvec2 offset = chunk_index * chunk_size;
+
+    for (const uint16_t tile : layer.dirty_tiles) {
+        const TilePos pos = TilePos(offset.x + tile % chunk_size, offset.y + tile / chunk_size);
+        const std::optional<ChunkInstance> instance = get_instance(pos);
+        uint16_t& slot = layer.tile_slots[tile];
+
+        if (instance.has_value()) {
+            if (slot == ChunkMeshLayer::NO_SLOT) {
+                if (!layer.free_slots.empty()) {
+                    slot = layer.free_slots.back();
+                    layer.free_slots.pop_back();
+                } else {
+                    // Every slot is taken, so there is still room for one more in the buffer
+                    slot = layer.instances.size();
+                    layer.instances.push_back(instance.value());
+                }
             }
+
+            layer.instances[slot] = instance.value();
+            changed_slots.push_back(slot);
+        } else if (slot != ChunkMeshLayer::NO_SLOT) {
+            layer.instances[slot] = HIDDEN_INSTANCE;
+            layer.free_slots.push_back(slot);
+            changed_slots.push_back(slot);
+            slot = ChunkMeshLayer::NO_SLOT;
         }
     }
 
-    return count;
-}
+    stats.edited_tiles += layer.dirty_tiles.size();
+    layer.dirty_tiles.clear();
 
-static inline uint16_t fill_wall_buffer(const WorldData& world, ChunkInstance* data, glm::uvec2 index, glm::vec2 world_pos) {
-    uint16_t count = 0;
+    if (!changed_slots.empty()) {
+        if (!layer.page.valid()) layer.page = buffer_pool.acquire();
 
-    for (uint8_t y = 0; y < RENDER_CHUNK_SIZE_U; ++y) {
-        for (uint8_t x = 0; x < RENDER_CHUNK_SIZE_U; ++x) {
-            const glm::uvec2 map_pos = glm::uvec2(
-                index.x * RENDER_CHUNK_SIZE_U + x,
-                index.y * RENDER_CHUNK_SIZE_U + y
-            );
+        std::sort(changed_slots.begin(), changed_slots.end());
 
-            const std::optional<Wall> wall = world.get_wall(map_pos);
-            if (wall.has_value()) {
-                count++;
+        const auto write_range = [&](uint16_t first, uint16_t last) {
+            const uint32_t count = last - first + 1;
+            buffer_pool.write(layer.page, first, &layer.instances[first], count);
+            stats.edit_bytes += count * sizeof(ChunkInstance);
+        };
 
-                const glm::vec2 atlas_pos = glm::vec2(wall->atlas_pos.x, wall->atlas_pos.y);
-                const uint16_t tile_data = pack_tile_data(static_cast<uint32_t>(wall->type), TileType::Wall);
+        uint16_t first = changed_slots[0];
+        uint16_t last = first;
 
-                data->position = pack_position(x, y);
-                data->atlas_pos = atlas_pos;
-                data->world_pos = world_pos;
-                data->tile_data = tile_data;
-                data++;
+        for (const uint16_t slot : changed_slots) {
+            if (slot - last > MAX_SLOT_GAP) {
+                write_range(first, last);
+                first = slot;
             }
+            last = slot;
         }
+
+        write_range(first, last);
     }
 
-    return count;
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stats.edit_time += elapsed.count();
+
+    return true;
 }
 
+void RenderChunk::rewrite_buffers(ChunkBufferPool& buffer_pool) {
+    if (m_blocks.page.valid() && m_blocks.count() > 0) {
+        buffer_pool.write(m_blocks.page, 0, m_blocks.instances.data(), m_blocks.count());
+    }
 
-void RenderChunk::build_mesh(
-    const WorldData& world,
-    ChunkInstance* block_data_arena,
-    ChunkInstance* wall_data_arena
-) {
-    ZoneScoped;
+    if (m_walls.page.valid() && m_walls.count() > 0) {
+        buffer_pool.write(m_walls.page, 0, m_walls.instances.data(), m_walls.count());
+    }
+}
 
-    m_block_count = fill_block_buffer(world, block_data_arena, m_index, m_world_pos);
-    m_wall_count = fill_wall_buffer(world, wall_data_arena, m_index, m_world_pos);
+void RenderChunk::release_buffers(ChunkBufferPool& buffer_pool) {
+    buffer_pool.release(m_blocks.page);
+    buffer_pool.release(m_walls.page);
 
-    const auto& context = sge::Engine::Renderer().Context();
+    m_blocks.instances.clear();
+    m_walls.instances.clear();
+}
 
-    {
-        const size_t size = m_block_count * sizeof(ChunkInstance);
-        const void* data = size > 0 ? block_data_arena : nullptr;
+void RenderChunk::update_impostor(const WorldData& world, ChunkImpostorAtlas& impostor_atlas, std::vector<Color>& colors) {
+    ZoneScoped;
 
-        m_block_instance_buffer = context->CreateBuffer(GetBufferDescriptor(), data);
+    colors.resize(ChunkSize::TileCount());
 
-        LLGL::Buffer* buffers[] = { GameRenderer::ChunkVertexBuffer(), m_block_instance_buffer };
+    if (m_impostor_layer == ChunkImpostorAtlas::INVALID_LAYER) m_impostor_layer = impostor_atlas.acquire();
 
-        m_block_buffer_array = context->CreateBufferArray(2, buffers);
-    }
-    {
-        const size_t size = m_wall_count * sizeof(ChunkInstance);
-        const void* data = size > 0 ? wall_data_arena : nullptr;
+    build_chunk_impostor(world, m_index, colors.data());
+    impostor_atlas.write(m_impostor_layer, colors.data());
+
+    m_impostor_dirty = false;
+}
 
-        m_wall_instance_buffer = context->CreateBuffer(GetBufferDescriptor(), data);
+void RenderChunk::release_impostor(ChunkImpostorAtlas& impostor_atlas) {
+    impostor_atlas.release(m_impostor_layer);
+    m_impostor_dirty = true;
+}
 
-        LLGL::Buffer* buffers[] = { GameRenderer::ChunkVertexBuffer(), m_wall_instance_buffer };
+void RenderChunk::set_blocks_dirty(TilePos tile_pos) {
+    const glm::uvec2 local = glm::uvec2(glm::ivec2(tile_pos)) % ChunkSize::Get();
+    m_blocks.dirty_tiles.push_back(local.y * ChunkSize::Get() + local.x);
+    m_impostor_dirty = true;
+}
 
-        m_wall_buffer_array = context->CreateBufferArray(2, buffers);
-    }
+void RenderChunk::set_walls_dirty(TilePos tile_pos) {
+    const glm::uvec2 local = glm::uvec2(glm::ivec2(tile_pos)) % ChunkSize::Get();
+    m_walls.dirty_tiles.push_back(local.y * ChunkSize::Get() + local.x);
+    m_impostor_dirty = true;
 }
 
-void RenderChunk::rebuild_mesh(
-    const WorldData& world,
-    ChunkInstance* block_data_arena,
-    ChunkInstance* wall_data_arena
-) {
+void RenderChunk::upload_mesh(const ChunkMeshJob& job, ChunkBufferPool& buffer_pool, ChunkMeshStats& stats) {
     ZoneScoped;
 
-    const auto& context = sge::Engine::Renderer().Context();
+    if (job.build_blocks && job.id > m_blocks.mesh_id) {
+        m_blocks.mesh_id = job.id;
+        if (job.id >= m_blocks.pending_id) m_blocks.pending_id = 0;
 
-    if (m_blocks_dirty) {
-        m_block_count = fill_block_buffer(world, block_data_arena, m_index, m_world_pos);
-        if (m_block_count > 0) {
-            context->WriteBuffer(*m_block_instance_buffer, 0, block_data_arena, m_block_count * sizeof(ChunkInstance));
-        }
+        stats.rebuild_bytes += upload_layer(m_blocks, job.block_data, job.block_tiles, job.block_count, buffer_pool);
+        stats.full_rebuilds++;
     }
 
-    if (m_walls_dirty) {
-        m_wall_count = fill_wall_buffer(world, wall_data_arena, m_index, m_world_pos);
-        if (m_wall_count > 0) {
-            context->WriteBuffer(*m_wall_instance_buffer, 0, wall_data_arena, m_wall_count * sizeof(ChunkInstance));
-        }
+    if (job.build_walls && job.id > m_walls.mesh_id) {
+        m_walls.mesh_id = job.id;
+        if (job.id >= m_walls.pending_id) m_walls.pending_id = 0;
+
+        stats.rebuild_bytes += upload_layer(m_walls, job.wall_data, job.wall_tiles, job.wall_count, buffer_pool);
+        stats.full_rebuilds++;
     }
+}
 
-    m_blocks_dirty = false;
-    m_walls_dirty = false;
-}
\ No newline at end of file
+bool RenderChunk::update_blocks(const WorldData& world, ChunkBufferPool& buffer_pool, ChunkMeshStats& stats, std::vector<uint16_t>& changed_slots) {
+    return update_layer(m_blocks, m_index, buffer_pool, stats, changed_slots, [&world](TilePos pos) -> std::optional<ChunkInstance> {
+        const std::optional<Block> block = world.get_block(pos);
+        if (!block.has_value()) return std::nullopt;
+        return make_block_instance(block.value(), pos);
+    });
+}
+
+bool RenderChunk::update_walls(const WorldData& world, ChunkBufferPool& buffer_pool, ChunkMeshStats& stats, std::vector<uint16_t>& changed_slots) {
+    return update_layer(m_walls, m_index, buffer_pool, stats, changed_slots, [&world](TilePos pos) -> std::optional<ChunkInstance> {
+        const std::optional<Wall> wall = world.get_wall(pos);
+        if (!wall.has_value() || wall_is_hidden(world, pos)) return std::nullopt;
+        return make_wall_instance(wall.value(), pos);
+    });
+}
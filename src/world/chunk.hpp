@@ -3,99 +3,185 @@
 #ifndef WORLD_CHUNK_HPP_
 #define WORLD_CHUNK_HPP_
 
+#include <vector>
+
 #include <glm/glm.hpp>
 #include <glm/gtx/hash.hpp>
-#include <LLGL/Buffer.h>
-#include <LLGL/BufferArray.h>
-#include <LLGL/Texture.h>
 
 #include "../constants.hpp"
 #include "../renderer/types.hpp"
+#include "../types/tile_pos.hpp"
+
+#include "chunk_buffer_pool.hpp"
+#include "chunk_impostor_atlas.hpp"
+#include "chunk_size.hpp"
+
+struct ChunkMeshJob;
+struct WorldData;
+struct Color;
+
+struct ChunkMeshStats {
+    // Tiles written into stable slots, without rebuilding the chunk
+    uint32_t edited_tiles = 0;
+    uint32_t full_rebuilds = 0;
+    uint64_t edit_bytes = 0;
+    uint64_t rebuild_bytes = 0;
+    // The main thread time spent on the edits, in seconds
+    double edit_time = 0.0;
+};
 
-#include "world_data.hpp"
+// The instances of one layer of a chunk. Every tile keeps its instance slot until the next full
+// rebuild, so an edit only writes the slots it touches. Removed tiles leave hidden instances behind.
+struct ChunkMeshLayer {
+    static constexpr uint16_t NO_SLOT = 0xFFFF;
+
+    ChunkBufferPage page;
+    // A copy of the instance buffer, the slots past the end are unused
+    std::vector<ChunkInstance> instances;
+    // The slot of every tile of the chunk
+    std::vector<uint16_t> tile_slots;
+    std::vector<uint16_t> free_slots;
+    // The tiles changed since the last mesh request
+    std::vector<uint16_t> dirty_tiles;
+    // The id of the job the current mesh was built by
+    uint32_t mesh_id = 0;
+    // The id of the full rebuild that is not uploaded yet
+    uint32_t pending_id = 0;
+
+    [[nodiscard]]
+    inline uint16_t count() const noexcept {
+        return instances.size();
+    }
+};
 
 class RenderChunk {
 public:
-    RenderChunk(
-        glm::uvec2 index,
-        const glm::vec2& world_pos,
-        const WorldData& world,
-        ChunkInstance* block_data_arena,
-        ChunkInstance* wall_data_arena
-    ) : m_world_pos(world_pos * Constants::RENDER_CHUNK_SIZE),
-        m_index(index)
-    {
-        build_mesh(world, block_data_arena, wall_data_arena);
+    RenderChunk(glm::uvec2 index, const glm::vec2& world_pos) :
+        m_world_pos(world_pos * static_cast<float>(ChunkSize::Get())),
+        m_index(index) {}
+
+    // Uploads the instance data built by the job, keeps the current mesh if the job is outdated
+    void upload_mesh(const ChunkMeshJob& job, ChunkBufferPool& buffer_pool, ChunkMeshStats& stats);
+
+    // Writes the dirty tiles into their slots, `changed_slots` is scratch space owned by the caller.
+    // Returns false if the layer has too many changes or free slots and must be rebuilt instead.
+    bool update_blocks(const WorldData& world, ChunkBufferPool& buffer_pool, ChunkMeshStats& stats, std::vector<uint16_t>& changed_slots);
+    bool update_walls(const WorldData& world, ChunkBufferPool& buffer_pool, ChunkMeshStats& stats, std::vector<uint16_t>& changed_slots);
+
+    // Writes the whole mesh again, e.g. after the buffer pool has grown or shrunk
+    void rewrite_buffers(ChunkBufferPool& buffer_pool);
+
+    // Gives the pages back to the pool, they must not be in use by the GPU anymore
+    void release_buffers(ChunkBufferPool& buffer_pool);
+
+    // Appends the pages the chunk holds, so ChunkBufferPool::shrink can move them
+    inline void collect_pages(std::vector<ChunkBufferPage*>& pages) {
+        if (m_blocks.page.valid()) pages.push_back(&m_blocks.page);
+        if (m_walls.page.valid()) pages.push_back(&m_walls.page);
     }
 
-    void build_mesh(
-        const WorldData& world,
-        ChunkInstance* block_data_arena,
-        ChunkInstance* wall_data_arena
-    );
+    // Writes the map colors of the chunk into its impostor layer, `colors` is scratch space owned by the caller
+    void update_impostor(const WorldData& world, ChunkImpostorAtlas& impostor_atlas, std::vector<Color>& colors);
+
+    // Gives the impostor layer back to the atlas, it must not be in use by the GPU anymore
+    void release_impostor(ChunkImpostorAtlas& impostor_atlas);
 
-    void rebuild_mesh(
-        const WorldData& world,
-        ChunkInstance* block_data_arena,
-        ChunkInstance* wall_data_arena
-    );
+    inline void set_impostor_dirty() noexcept {
+        m_impostor_dirty = true;
+    }
 
-    void destroy();
+    void set_blocks_dirty(TilePos tile_pos);
+    void set_walls_dirty(TilePos tile_pos);
+
+    // Called when a full rebuild is submitted, the dirty tiles are part of it
+    inline void set_mesh_requested(uint32_t id, bool blocks, bool walls) noexcept {
+        if (blocks) {
+            m_blocks.pending_id = id;
+            m_blocks.dirty_tiles.clear();
+        }
+        if (walls) {
+            m_walls.pending_id = id;
+            m_walls.dirty_tiles.clear();
+        }
+    }
 
-    inline void set_blocks_dirty() noexcept {
-        m_blocks_dirty = true;
+    // Returns true the first time the chunk becomes visible
+    inline bool set_shown() noexcept {
+        const bool first = !m_shown;
+        m_shown = true;
+        return first;
     }
 
-    inline void set_walls_dirty() noexcept {
-        m_walls_dirty = true;
+    // Both layers have been built at least once
+    [[nodiscard]]
+    inline bool mesh_ready() const noexcept {
+        return m_blocks.mesh_id != 0 && m_walls.mesh_id != 0;
+    }
+
+    [[nodiscard]]
+    inline bool blocks_dirty() const noexcept {
+        return !m_blocks.dirty_tiles.empty();
+    }
+
+    [[nodiscard]]
+    inline bool walls_dirty() const noexcept {
+        return !m_walls.dirty_tiles.empty();
     }
 
     [[nodiscard]]
     inline bool dirty() const noexcept {
-        return m_blocks_dirty || m_walls_dirty;
+        return blocks_dirty() || walls_dirty();
     }
 
     [[nodiscard]]
-    inline uint16_t block_count() const noexcept {
-        return m_block_count;
+    inline bool impostor_dirty() const noexcept {
+        return m_impostor_dirty;
     }
 
     [[nodiscard]]
-    inline uint16_t wall_count() const noexcept {
-        return m_wall_count;
+    inline uint32_t impostor_layer() const noexcept {
+        return m_impostor_layer;
     }
 
     [[nodiscard]]
-    inline LLGL::BufferArray* block_buffer_array() const noexcept {
-        return m_block_buffer_array;
+    inline glm::uvec2 index() const noexcept {
+        return m_index;
     }
 
     [[nodiscard]]
-    inline LLGL::BufferArray* wall_buffer_array() const noexcept {
-        return m_wall_buffer_array;
+    inline const glm::vec2& world_pos() const noexcept {
+        return m_world_pos;
+    }
+
+    // The number of instances to draw, including the hidden ones
+    [[nodiscard]]
+    inline uint16_t block_count() const noexcept {
+        return m_blocks.count();
+    }
+
+    [[nodiscard]]
+    inline uint16_t wall_count() const noexcept {
+        return m_walls.count();
     }
 
     [[nodiscard]]
-    inline LLGL::Buffer* block_instance_buffer() const noexcept {
-        return m_block_instance_buffer;
+    inline const ChunkBufferPage& blocks_page() const noexcept {
+        return m_blocks.page;
     }
 
     [[nodiscard]]
-    inline LLGL::Buffer* wall_instance_buffer() const noexcept {
-        return m_wall_instance_buffer;
+    inline const ChunkBufferPage& walls_page() const noexcept {
+        return m_walls.page;
     }
 
 private:
     glm::vec2 m_world_pos;
     glm::uvec2 m_index;
-    LLGL::BufferArray* m_block_buffer_array = nullptr;
-    LLGL::BufferArray* m_wall_buffer_array = nullptr;
-    LLGL::Buffer* m_wall_instance_buffer = nullptr;
-    LLGL::Buffer* m_block_instance_buffer = nullptr;
-    uint16_t m_block_count = 0;
-    uint16_t m_wall_count = 0;
-    bool m_blocks_dirty = false;
-    bool m_walls_dirty = false;
+    ChunkMeshLayer m_blocks;
+    ChunkMeshLayer m_walls;
+    uint32_t m_impostor_layer = ChunkImpostorAtlas::INVALID_LAYER;
+    bool m_impostor_dirty = true;
+    bool m_shown = false;
 };
 
 #endif
\ No newline at end of file
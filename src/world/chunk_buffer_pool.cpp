@@ -0,0 +1,195 @@
+#include "chunk_buffer_pool.hpp"
+
+#include <algorithm>
+#include <bit>
+
+#include <SGE/engine.hpp>
+#include <SGE/renderer/macros.hpp>
+#include <SGE/profile.hpp>
+
+#include "../renderer/renderer.hpp"
+#include "../renderer/deferred_release.hpp"
+#include "../renderer/utils.hpp"
+#include "../assets.hpp"
+
+#include "chunk_size.hpp"
+
+static inline LLGL::BufferDescriptor GetBufferDescriptor(uint32_t page_instances, uint32_t pages) {
+    LLGL::BufferDescriptor buffer_desc;
+    buffer_desc.bindFlags = LLGL::BindFlags::VertexBuffer;
+    buffer_desc.size = sizeof(ChunkInstance) * page_instances * pages;
+    buffer_desc.stride = sizeof(ChunkInstance);
+    buffer_desc.vertexAttribs = Assets::GetVertexFormat(VertexFormatAsset::TilemapInstance).attributes;
+    return buffer_desc;
+}
+
+void ChunkBufferPool::resize(uint32_t new_pages) {
+    const auto& context = sge::Engine::Renderer().Context();
+
+    const uint32_t old_pages = m_stats.pages;
+
+    m_stats.pages = new_pages;
+    m_stats.free = new_pages - m_stats.in_use;
+
+    if (!m_shared) {
+        // The pages below both sizes stay where they are, so only the moved ones have to be written again
+        for (uint32_t page = old_pages; page < new_pages; ++page) {
+            LLGL::Buffer* buffer = context->CreateBuffer(GetBufferDescriptor(m_page_instances, 1));
+
+            LLGL::Buffer* buffer_array[] = { GameRenderer::ChunkVertexBuffer(), buffer };
+            m_page_buffers.push_back(buffer);
+            m_page_buffer_arrays.push_back(context->CreateBufferArray(2, buffer_array));
+
+            m_stats.created++;
+        }
+
+        // The frames in flight can still draw from the dropped pages
+        for (uint32_t page = new_pages; page < old_pages; ++page) {
+            DeferredRelease::Release(m_page_buffer_arrays[page]);
+            DeferredRelease::Release(m_page_buffers[page]);
+
+            m_stats.released++;
+        }
+
+        if (new_pages < old_pages) {
+            m_page_buffer_arrays.resize(new_pages);
+            m_page_buffers.resize(new_pages);
+        }
+        return;
+    }
+
+    // The frames in flight can still draw from the old buffer
+    if (m_instance_buffer != nullptr) m_stats.released++;
+    DeferredRelease::Release(m_buffer_array);
+    DeferredRelease::Release(m_instance_buffer);
+
+    m_instance_buffer = context->CreateBuffer(GetBufferDescriptor(m_page_instances, new_pages));
+
+    LLGL::Buffer* buffer_array[] = { GameRenderer::ChunkVertexBuffer(), m_instance_buffer };
+    m_buffer_array = context->CreateBufferArray(2, buffer_array);
+
+    m_stats.created++;
+}
+
+void ChunkBufferPool::grow() {
+    ZoneScoped;
+
+    const uint32_t old_pages = m_stats.pages;
+    const uint32_t new_pages = old_pages > 0 ? old_pages * 2 : INITIAL_PAGES;
+
+    if (old_pages == 0) {
+        m_page_instances = ChunkSize::TileCount();
+        m_shared = SupportsIndirectFirstInstance(sge::Engine::Renderer());
+    }
+
+    // Hand out the lower pages first
+    for (uint32_t page = new_pages; page > old_pages; --page) {
+        m_free_pages.push_back(page - 1);
+    }
+
+    resize(new_pages);
+
+    if (old_pages > 0) m_stats.grows++;
+}
+
+void ChunkBufferPool::track_usage() {
+    if (m_stats.pages > INITIAL_PAGES && m_stats.in_use * SHRINK_USAGE_DIVISOR < m_stats.pages) {
+        m_idle_frames++;
+    } else {
+        m_idle_frames = 0;
+    }
+}
+
+void ChunkBufferPool::shrink(const std::vector<ChunkBufferPage*>& pages) {
+    ZoneScoped;
+
+    // Half of the new pages are free, so it doesn't grow again right away
+    const uint32_t new_pages = std::max(std::bit_ceil(m_stats.in_use * 2), INITIAL_PAGES);
+
+    m_idle_frames = 0;
+    if (new_pages >= m_stats.pages) return;
+
+    m_used_pages.assign(new_pages, false);
+    for (const ChunkBufferPage* page : pages) {
+        if (page->index < new_pages) m_used_pages[page->index] = true;
+    }
+
+    // Hand out the lower pages first
+    m_free_pages.clear();
+    for (uint32_t page = new_pages; page > 0; --page) {
+        if (!m_used_pages[page - 1]) m_free_pages.push_back(page - 1);
+    }
+
+    for (ChunkBufferPage* page : pages) {
+        if (page->index < new_pages) continue;
+
+        page->index = m_free_pages.back();
+        m_free_pages.pop_back();
+
+        m_stats.relocated++;
+    }
+
+    resize(new_pages);
+
+    m_stats.shrinks++;
+}
+
+ChunkBufferPage ChunkBufferPool::acquire() {
+    if (m_free_pages.empty()) {
+        grow();
+    } else {
+        m_stats.reused++;
+    }
+
+    ChunkBufferPage page;
+    page.index = m_free_pages.back();
+    m_free_pages.pop_back();
+
+    m_stats.in_use++;
+    m_stats.free--;
+
+    return page;
+}
+
+void ChunkBufferPool::release(ChunkBufferPage& page) {
+    if (!page.valid()) return;
+
+    m_free_pages.push_back(page.index);
+    page = ChunkBufferPage();
+
+    m_stats.in_use--;
+    m_stats.free++;
+}
+
+void ChunkBufferPool::write(const ChunkBufferPage& page, uint32_t first, const ChunkInstance* data, uint32_t count) {
+    const auto& context = sge::Engine::Renderer().Context();
+
+    if (!m_shared) {
+        context->WriteBuffer(*m_page_buffers[page.index], first * sizeof(ChunkInstance), data, count * sizeof(ChunkInstance));
+        return;
+    }
+
+    const uint64_t offset = (first_instance(page) + first) * sizeof(ChunkInstance);
+    context->WriteBuffer(*m_instance_buffer, offset, data, count * sizeof(ChunkInstance));
+}
+
+void ChunkBufferPool::destroy() {
+    const auto& context = sge::Engine::Renderer().Context();
+
+    SGE_RESOURCE_RELEASE(m_buffer_array);
+    SGE_RESOURCE_RELEASE(m_instance_buffer);
+
+    for (LLGL::BufferArray*& buffer_array : m_page_buffer_arrays) {
+        SGE_RESOURCE_RELEASE(buffer_array);
+    }
+    for (LLGL::Buffer*& buffer : m_page_buffers) {
+        SGE_RESOURCE_RELEASE(buffer);
+    }
+    m_page_buffer_arrays.clear();
+    m_page_buffers.clear();
+
+    m_free_pages.clear();
+    m_page_instances = 0;
+    m_idle_frames = 0;
+    m_stats = ChunkBufferPoolStats();
+}
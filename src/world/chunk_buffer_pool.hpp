@@ -0,0 +1,138 @@
+#pragma once
+
+#ifndef WORLD_CHUNK_BUFFER_POOL_HPP_
+#define WORLD_CHUNK_BUFFER_POOL_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include <LLGL/Buffer.h>
+#include <LLGL/BufferArray.h>
+
+#include "../renderer/types.hpp"
+
+// A range of the shared instance buffer that fits one layer of a chunk
+struct ChunkBufferPage {
+    static constexpr uint32_t INVALID = UINT32_MAX;
+
+    uint32_t index = INVALID;
+
+    [[nodiscard]]
+    inline bool valid() const noexcept {
+        return index != INVALID;
+    }
+};
+
+struct ChunkBufferPoolStats {
+    uint32_t pages = 0;
+    uint32_t in_use = 0;
+    uint32_t free = 0;
+    // Total number of buffers created and released, the shared buffer or the buffers of the pages
+    uint32_t created = 0;
+    uint32_t released = 0;
+    // Total number of acquisitions served from the free pages without growing
+    uint32_t reused = 0;
+    // How many times the pages had to grow and were shrunk back to the expanded range
+    uint32_t grows = 0;
+    uint32_t shrinks = 0;
+    // Total number of pages moved down by the shrinks
+    uint32_t relocated = 0;
+};
+
+// Sub-allocates the instances of every chunk from one instance buffer,
+// so all the chunks can be drawn with a single vertex buffer array.
+// The pages are found by the first instance of the indirect draws, so where the backend can't offset
+// the instances of an indirect draw every page gets a buffer of its own instead, see SupportsIndirectFirstInstance.
+// The pool follows the viewport: it grows when it runs out of pages and shrinks back
+// once fewer than a quarter of them have been in use for SHRINK_FRAMES frames.
+class ChunkBufferPool {
+public:
+    static constexpr uint32_t INITIAL_PAGES = 128;
+    static constexpr uint32_t SHRINK_USAGE_DIVISOR = 4;
+    static constexpr uint32_t SHRINK_FRAMES = 120;
+
+    [[nodiscard]]
+    ChunkBufferPage acquire();
+
+    // The page must not be in use by the GPU anymore
+    void release(ChunkBufferPage& page);
+
+    void write(const ChunkBufferPage& page, uint32_t first, const ChunkInstance* data, uint32_t count);
+
+    // Counts the frames in a row the pool has been mostly empty, called once per frame
+    void track_usage();
+
+    [[nodiscard]]
+    inline bool should_shrink() const noexcept {
+        return m_idle_frames >= SHRINK_FRAMES;
+    }
+
+    // Shrinks the pool to twice the pages in use. `pages` must be every page in use, the ones past
+    // the new size are moved into free pages below it. Like after a grow, the contents of every page
+    // have to be written again.
+    void shrink(const std::vector<ChunkBufferPage*>& pages);
+
+    void destroy();
+
+    // The first instance of the page in the shared buffer
+    [[nodiscard]]
+    inline uint32_t first_instance(const ChunkBufferPage& page) const noexcept {
+        return page.index * m_page_instances;
+    }
+
+    [[nodiscard]]
+    inline bool valid() const noexcept {
+        return m_stats.pages > 0;
+    }
+
+    // All the pages are in one buffer, otherwise every page has its own
+    [[nodiscard]]
+    inline bool shared() const noexcept {
+        return m_shared;
+    }
+
+    // The shared buffer, only if shared() is true
+    [[nodiscard]]
+    inline LLGL::BufferArray* buffer_array() const noexcept {
+        return m_buffer_array;
+    }
+
+    // The buffer of the page, only if shared() is false
+    [[nodiscard]]
+    inline LLGL::BufferArray* page_buffer_array(const ChunkBufferPage& page) const noexcept {
+        return m_page_buffer_arrays[page.index];
+    }
+
+    // Changes every time the pool grows or shrinks, the pages keep their indices
+    // or are moved by shrink, but their contents have to be written again
+    [[nodiscard]]
+    inline uint32_t generation() const noexcept {
+        return m_stats.grows + m_stats.shrinks;
+    }
+
+    [[nodiscard]]
+    inline const ChunkBufferPoolStats& stats() const noexcept {
+        return m_stats;
+    }
+
+private:
+    void grow();
+    void resize(uint32_t new_pages);
+
+private:
+    LLGL::Buffer* m_instance_buffer = nullptr;
+    LLGL::BufferArray* m_buffer_array = nullptr;
+    // Indexed by the page, only used if the pages aren't shared
+    std::vector<LLGL::Buffer*> m_page_buffers;
+    std::vector<LLGL::BufferArray*> m_page_buffer_arrays;
+    bool m_shared = true;
+    std::vector<uint32_t> m_free_pages;
+    // Scratch space for shrink
+    std::vector<bool> m_used_pages;
+    // The tile count of a chunk when the buffer was first created
+    uint32_t m_page_instances = 0;
+    uint32_t m_idle_frames = 0;
+    ChunkBufferPoolStats m_stats;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "chunk_impostor_atlas.hpp"
+
+#include <LLGL/TextureFlags.h>
+
+#include <SGE/engine.hpp>
+#include <SGE/renderer/macros.hpp>
+#include <SGE/defines.hpp>
+#include <SGE/profile.hpp>
+
+#include "../renderer/deferred_release.hpp"
+#include "../types/block.hpp"
+#include "../types/wall.hpp"
+
+#include "chunk_size.hpp"
+
+static inline Color block_map_color(const Block& block) {
+    switch (tile_texture_type(block)) {
+    case TileTextureType::Dirt:       return Color(151, 107, 75);
+    case TileTextureType::Stone:      return Color(128, 128, 128);
+    case TileTextureType::Grass:      return Color(28, 216, 94);
+    case TileTextureType::Torch:      return Color(253, 221, 3);
+    case TileTextureType::TreeTrunk:  return Color(119, 84, 57);
+    case TileTextureType::TreeCrown:
+    case TileTextureType::TreeBranch: return Color(26, 196, 84);
+    case TileTextureType::Wood:       return Color(191, 142, 111);
+    default: SGE_UNREACHABLE();
+    }
+}
+
+static inline Color wall_map_color(const Wall& wall) {
+    switch (wall.type) {
+    case WallType::StoneWall: return Color(52, 52, 52);
+    case WallType::DirtWall:  return Color(88, 61, 46);
+    case WallType::WoodWall:  return Color(73, 51, 36);
+    default: SGE_UNREACHABLE();
+    }
+}
+
+void build_chunk_impostor(const WorldData& world, glm::uvec2 chunk_index, Color* colors) {
+    ZoneScoped;
+
+    const int chunk_size = ChunkSize::Get();
+    const int offset_x = chunk_index.x * chunk_size;
+    const int offset_y = chunk_index.y * chunk_size;
+
+    for (int y = 0; y < chunk_size; ++y) {
+        for (int x = 0; x < chunk_size; ++x) {
+            const TilePos pos = TilePos(offset_x + x, offset_y + y);
+            Color& color = colors[y * chunk_size + x];
+
+            if (const std::optional<Block> block = world.get_block(pos); block.has_value()) {
+                color = block_map_color(block.value());
+            } else if (const std::optional<Wall> wall = world.get_wall(pos); wall.has_value()) {
+                color = wall_map_color(wall.value());
+            } else {
+                color = Color(0, 0, 0, 0);
+            }
+        }
+    }
+}
+
+void ChunkImpostorAtlas::grow() {
+    ZoneScoped;
+
+    const auto& context = sge::Engine::Renderer().Context();
+
+    const uint32_t old_layers = m_stats.layers;
+    const uint32_t new_layers = old_layers > 0 ? old_layers * 2 : INITIAL_LAYERS;
+
+    if (old_layers == 0) m_layer_size = ChunkSize::Get();
+
+    // The frames in flight can still sample the old texture
+    DeferredRelease::Release(m_texture);
+
+    LLGL::TextureDescriptor texture_desc;
+    texture_desc.type = LLGL::TextureType::Texture2DArray;
+    texture_desc.format = LLGL::Format::RGBA8UNorm;
+    texture_desc.extent = LLGL::Extent3D(m_layer_size, m_layer_size, 1);
+    texture_desc.arrayLayers = new_layers;
+    texture_desc.mipLevels = 1;
+    texture_desc.bindFlags = LLGL::BindFlags::Sampled;
+    texture_desc.miscFlags = LLGL::MiscFlags::DynamicUsage;
+    texture_desc.debugName = "ChunkImpostorAtlas";
+
+    m_texture = context->CreateTexture(texture_desc);
+
+    // Hand out the lower layers first
+    for (uint32_t layer = new_layers; layer > old_layers; --layer) {
+        m_free_layers.push_back(layer - 1);
+    }
+
+    if (old_layers > 0) m_stats.grows++;
+    m_stats.layers = new_layers;
+}
+
+uint32_t ChunkImpostorAtlas::acquire() {
+    if (m_free_layers.empty()) grow();
+
+    const uint32_t layer = m_free_layers.back();
+    m_free_layers.pop_back();
+
+    m_stats.in_use++;
+
+    return layer;
+}
+
+void ChunkImpostorAtlas::release(uint32_t& layer) {
+    if (layer == INVALID_LAYER) return;
+
+    m_free_layers.push_back(layer);
+    layer = INVALID_LAYER;
+
+    m_stats.in_use--;
+}
+
+void ChunkImpostorAtlas::write(uint32_t layer, const Color* colors) {
+    const auto& context = sge::Engine::Renderer().Context();
+
+    LLGL::ImageView image_view;
+    image_view.format   = LLGL::ImageFormat::RGBA;
+    image_view.dataType = LLGL::DataType::UInt8;
+    image_view.data     = colors;
+    image_view.dataSize = m_layer_size * m_layer_size * sizeof(Color);
+
+    const LLGL::TextureRegion region = LLGL::TextureRegion(
+        LLGL::TextureSubresource(layer, 1, 0, 1),
+        LLGL::Offset3D(0, 0, 0),
+        LLGL::Extent3D(m_layer_size, m_layer_size, 1)
+    );
+
+    context->WriteTexture(*m_texture, region, image_view);
+}
+
+void ChunkImpostorAtlas::destroy() {
+    const auto& context = sge::Engine::Renderer().Context();
+
+    SGE_RESOURCE_RELEASE(m_texture);
+
+    m_free_layers.clear();
+    m_layer_size = 0;
+    m_stats = ChunkImpostorAtlasStats();
+}
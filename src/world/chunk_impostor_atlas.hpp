@@ -0,0 +1,84 @@
+#pragma once
+
+#ifndef WORLD_CHUNK_IMPOSTOR_ATLAS_HPP_
+#define WORLD_CHUNK_IMPOSTOR_ATLAS_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include <LLGL/Texture.h>
+
+#include <glm/vec2.hpp>
+
+#include "lightmap.hpp"
+#include "world_data.hpp"
+
+struct ChunkImpostorAtlasStats {
+    uint32_t layers = 0;
+    uint32_t in_use = 0;
+    // How many times the texture had to grow
+    uint32_t grows = 0;
+};
+
+// A texture array with one layer per chunk and one texel per tile,
+// used to draw a whole chunk with a single quad when the camera is zoomed out
+class ChunkImpostorAtlas {
+public:
+    static constexpr uint32_t INITIAL_LAYERS = 64;
+    static constexpr uint32_t INVALID_LAYER = UINT32_MAX;
+
+    [[nodiscard]]
+    uint32_t acquire();
+
+    // The layer must not be in use by the GPU anymore
+    void release(uint32_t& layer);
+
+    // Writes ChunkSize::TileCount() colors into the layer
+    void write(uint32_t layer, const Color* colors);
+
+    void destroy();
+
+    [[nodiscard]]
+    inline bool valid() const noexcept {
+        return m_texture != nullptr;
+    }
+
+    [[nodiscard]]
+    inline LLGL::Texture* texture() const noexcept {
+        return m_texture;
+    }
+
+    // Changes every time the texture grows, the layers keep their indices
+    // but their contents have to be written again
+    [[nodiscard]]
+    inline uint32_t generation() const noexcept {
+        return m_stats.grows;
+    }
+
+    // The width and the height of a layer in texels
+    [[nodiscard]]
+    inline uint32_t layer_size() const noexcept {
+        return m_layer_size;
+    }
+
+    [[nodiscard]]
+    inline const ChunkImpostorAtlasStats& stats() const noexcept {
+        return m_stats;
+    }
+
+private:
+    void grow();
+
+private:
+    LLGL::Texture* m_texture = nullptr;
+    std::vector<uint32_t> m_free_layers;
+    // The chunk size when the texture was first created
+    uint32_t m_layer_size = 0;
+    ChunkImpostorAtlasStats m_stats;
+};
+
+// Fills ChunkSize::TileCount() colors with the map color of every tile of the chunk.
+// Blocks are drawn over walls, the empty tiles are transparent.
+void build_chunk_impostor(const WorldData& world, glm::uvec2 chunk_index, Color* colors);
+
+#endif
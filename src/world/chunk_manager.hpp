@@ -3,80 +3,172 @@
 #ifndef WORLD_CHUNK_MANAGER_HPP_
 #define WORLD_CHUNK_MANAGER_HPP_
 
-#include <unordered_map>
-#include <unordered_set>
-#include <deque>
+#include <optional>
+#include <vector>
 #include <glm/vec2.hpp>
 
 #include <SGE/renderer/camera.hpp>
-#include <SGE/utils/alloc.hpp>
+#include <SGE/math/rect.hpp>
 #include "../renderer/types.hpp"
 #include "../types/tile_pos.hpp"
 
 #include "chunk.hpp"
+#include "chunk_buffer_pool.hpp"
+#include "chunk_impostor_atlas.hpp"
+#include "chunk_mesh_builder.hpp"
 #include "world_data.hpp"
 
+struct ChunkPrefetchStats {
+    // Chunks that had their mesh built when they became visible
+    uint32_t hits = 0;
+    // Chunks that were needed but not built yet
+    uint32_t misses = 0;
+    // Chunks built ahead of the camera motion
+    uint32_t prefetched = 0;
+};
+
+struct ChunkImpostorStats {
+    uint32_t updated = 0;
+    // The main thread time spent on building and uploading the impostors, in seconds
+    double update_time = 0.0;
+};
+
 class ChunkManager {
 public:
-    using ChunkMap = std::unordered_map<glm::uvec2, RenderChunk>;
-    using ChunkPosSet = std::unordered_set<glm::uvec2>;
+    void manage_chunks(const WorldData& world, const sge::Camera& camera);
 
-    ChunkManager() {
-        using Constants::RENDER_CHUNK_SIZE_U;
-        m_block_data_arena = sge::checked_alloc<ChunkInstance>(RENDER_CHUNK_SIZE_U * RENDER_CHUNK_SIZE_U);
-        m_wall_data_arena = sge::checked_alloc<ChunkInstance>(RENDER_CHUNK_SIZE_U * RENDER_CHUNK_SIZE_U);
-    }
+    // Blocks until every requested mesh is built and uploaded
+    void flush_meshes();
 
-    void manage_chunks(const WorldData& world, const sge::Camera& camera);
+    // Drops every chunk and the GPU buffers, e.g. after the chunk size has changed.
+    // The chunks are loaded again by the next manage_chunks.
+    void reset();
 
     void set_blocks_changed(TilePos tile_pos);
     void set_walls_changed(TilePos tile_pos);
 
-    inline void destroy_hidden_chunks() {
-        std::deque<RenderChunk>& chunks = m_chunks_to_destroy;
-        while (!chunks.empty()) {
-            chunks.back().destroy();
-            chunks.pop_back();
-        }
-    }
+    // Rebuilds the loaded chunks that overlap `area`, e.g. after a part of the world was generated under them
+    void set_area_changed(const WorldData& world, const sge::IRect& area);
 
     inline void destroy() {
-        for (auto& entry : m_render_chunks) {
-            entry.second.destroy();
+        m_mesh_builder.wait_idle();
+
+        for (const uint32_t slot : m_active_chunks) {
+            m_chunk_grid[slot]->release_buffers(m_buffer_pool);
+            m_chunk_grid[slot]->release_impostor(m_impostor_atlas);
+            m_chunk_grid[slot].reset();
         }
+        m_active_chunks.clear();
+        m_visible_chunks.clear();
+
+        m_buffer_pool.destroy();
+        m_impostor_atlas.destroy();
     }
 
+    // The chunks inside the camera range, every one of them is loaded
     [[nodiscard]]
-    inline const ChunkMap& render_chunks() const noexcept {
-        return m_render_chunks;
+    inline const std::vector<const RenderChunk*>& visible_chunks() const noexcept {
+        return m_visible_chunks;
     }
 
     [[nodiscard]]
-    inline const ChunkPosSet& visible_chunks() const noexcept {
-        return m_visible_chunks;
+    inline uint32_t loaded_chunks() const noexcept {
+        return m_active_chunks.size();
     }
 
     [[nodiscard]]
-    inline std::deque<RenderChunk>& chunks_to_destroy() noexcept {
-        return m_chunks_to_destroy;
+    inline uint32_t pending_meshes() const noexcept {
+        return m_mesh_builder.pending_jobs();
     }
 
     [[nodiscard]]
-    inline bool any_chunks_to_destroy() noexcept {
-        return !m_chunks_to_destroy.empty();
+    inline const ChunkPrefetchStats& prefetch_stats() const noexcept {
+        return m_prefetch_stats;
     }
 
-    ~ChunkManager() {
-        free(m_block_data_arena);
-        free(m_wall_data_arena);
+    [[nodiscard]]
+    inline const ChunkMeshStats& mesh_stats() const noexcept {
+        return m_mesh_stats;
+    }
+
+    [[nodiscard]]
+    inline const ChunkBufferPool& buffer_pool() const noexcept {
+        return m_buffer_pool;
+    }
+
+    // The visible chunks are drawn as impostors, their layers are up to date
+    [[nodiscard]]
+    inline bool lod_active() const noexcept {
+        return m_lod_active;
+    }
+
+    [[nodiscard]]
+    inline const ChunkImpostorAtlas& impostor_atlas() const noexcept {
+        return m_impostor_atlas;
+    }
+
+    [[nodiscard]]
+    inline const ChunkImpostorStats& impostor_stats() const noexcept {
+        return m_impostor_stats;
     }
 private:
-    ChunkMap m_render_chunks;
-    ChunkPosSet m_visible_chunks;
-    std::deque<RenderChunk> m_chunks_to_destroy;
+    void request_mesh(const WorldData& world, RenderChunk& chunk, bool build_blocks, bool build_walls);
+
+    void upload_completed_meshes();
+
+    RenderChunk& load_chunk(const WorldData& world, uint32_t x, uint32_t y);
 
-    ChunkInstance* m_block_data_arena = nullptr;
-    ChunkInstance* m_wall_data_arena = nullptr;
+    void update_camera_velocity(const glm::vec2& camera_pos);
+
+    // Loads the chunks of the prefetch range outside of the visible range, within a time budget
+    void prefetch_chunks(const WorldData& world, const sge::URect& visible_range, const sge::URect& prefetch_range);
+
+    // Writes the meshes of the loaded chunks again after the buffer pool has grown or shrunk
+    void rewrite_buffers_if_resized();
+
+    // Shrinks the buffer pool back toward the pages the expanded range needs once it has been mostly empty for a while
+    void shrink_buffer_pool_if_idle();
+
+    // Builds the dirty impostors of the visible chunks
+    void update_impostors(const WorldData& world);
+
+    void resize_grid(const glm::uvec2& grid_size);
+
+    [[nodiscard]]
+    inline std::optional<RenderChunk>* chunk_slot(glm::uvec2 chunk_pos) noexcept {
+        if (chunk_pos.x >= m_grid_size.x || chunk_pos.y >= m_grid_size.y) return nullptr;
+        return &m_chunk_grid[chunk_pos.y * m_grid_size.x + chunk_pos.x];
+    }
+private:
+    // Indexed by the chunk position, the world is small enough to keep a slot for every chunk
+    std::vector<std::optional<RenderChunk>> m_chunk_grid;
+    glm::uvec2 m_grid_size = glm::uvec2(0);
+    // The grid indices of the loaded chunks
+    std::vector<uint32_t> m_active_chunks;
+    std::vector<const RenderChunk*> m_visible_chunks;
+
+    ChunkBufferPool m_buffer_pool;
+    uint32_t m_buffer_generation = 0;
+    // Scratch space for shrink_buffer_pool_if_idle
+    std::vector<ChunkBufferPage*> m_live_pages;
+    ChunkMeshBuilder m_mesh_builder;
+    std::vector<ChunkMeshBuilder::JobPtr> m_completed_meshes;
+    ChunkMeshStats m_mesh_stats;
+    // Scratch space for the in-place edits
+    std::vector<uint16_t> m_changed_slots;
+
+    ChunkImpostorAtlas m_impostor_atlas;
+    uint32_t m_impostor_generation = 0;
+    ChunkImpostorStats m_impostor_stats;
+    // Scratch space for the impostor builds
+    std::vector<Color> m_impostor_colors;
+    bool m_lod_active = false;
+
+    ChunkPrefetchStats m_prefetch_stats;
+    glm::vec2 m_camera_velocity = glm::vec2(0.0f);
+    glm::vec2 m_last_camera_pos = glm::vec2(0.0f);
+    bool m_has_camera_pos = false;
+    uint32_t m_next_mesh_id = 0;
 };
 
 #endif
\ No newline at end of file
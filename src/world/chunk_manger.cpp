@@ -1,93 +1,415 @@
 #include "chunk_manager.hpp"
 
+#include <chrono>
+
 #include <SGE/profile.hpp>
+#include <SGE/time/time.hpp>
+
+#include "../renderer/deferred_release.hpp"
 
 #include "utils.hpp"
 
 using Constants::TILE_SIZE;
-using Constants::RENDER_CHUNK_SIZE;
-using Constants::RENDER_CHUNK_SIZE_U;
 
-static sge::URect get_chunk_range(const sge::Rect& camera_fov, const glm::uvec2& world_size, uint32_t expand = 0) {
+// The margin around the visible chunks when the camera stands still
+static constexpr uint32_t IDLE_MARGIN = 2;
+// The margin behind the moving camera
+static constexpr uint32_t TRAILING_MARGIN = 1;
+static constexpr uint32_t MAX_LEADING_MARGIN = 6;
+
+// How far ahead the camera motion is extrapolated, in seconds
+static constexpr float PREFETCH_LOOKAHEAD = 0.5f;
+// Slower camera motion is treated as standing still, in pixels per second
+static constexpr float MIN_PREFETCH_SPEED = 100.0f;
+// Faster camera motion is a teleport, e.g. when the player is moved with the free camera
+static constexpr float MAX_CAMERA_SPEED = 10000.0f;
+static constexpr float VELOCITY_SMOOTHING = 0.3f;
+
+// The main thread time that can be spent on submitting prefetched chunks per frame, in seconds
+static constexpr double PREFETCH_TIME_BUDGET = 0.001;
+
+struct ChunkMargins {
+    uint32_t left = 0;
+    uint32_t right = 0;
+    uint32_t top = 0;
+    uint32_t bottom = 0;
+};
+
+static sge::URect get_chunk_range(const sge::Rect& camera_fov, const glm::uvec2& grid_size) {
+    const float chunk_world_size = ChunkSize::WorldSize();
+
     uint32_t left = 0;
     uint32_t right = 0;
     uint32_t bottom = 0;
     uint32_t top = 0;
 
     if (camera_fov.min.x > TILE_SIZE) {
-        left = glm::floor((camera_fov.min.x - TILE_SIZE) / (TILE_SIZE * RENDER_CHUNK_SIZE));
-        if (left >= expand) left -= expand;
+        left = glm::floor((camera_fov.min.x - TILE_SIZE) / chunk_world_size);
     }
     if (camera_fov.max.x > 0.0f) {
-        right = glm::ceil((camera_fov.max.x + TILE_SIZE) / (TILE_SIZE * RENDER_CHUNK_SIZE)) + expand;
+        right = glm::ceil((camera_fov.max.x + TILE_SIZE) / chunk_world_size);
     }
     if (camera_fov.min.y > TILE_SIZE) {
-        top = glm::floor((camera_fov.min.y - TILE_SIZE) / (TILE_SIZE * RENDER_CHUNK_SIZE));
-        if (top >= expand) top -= expand;
+        top = glm::floor((camera_fov.min.y - TILE_SIZE) / chunk_world_size);
     }
     if (camera_fov.max.y > 0.0f) { 
-        bottom = glm::ceil((camera_fov.max.y + TILE_SIZE) / (TILE_SIZE * RENDER_CHUNK_SIZE)) + expand;
+        bottom = glm::ceil((camera_fov.max.y + TILE_SIZE) / chunk_world_size);
     }
 
-    const glm::uvec2 chunk_max_pos = (world_size + glm::uvec2(RENDER_CHUNK_SIZE_U)- 1u) / static_cast<uint32_t>(RENDER_CHUNK_SIZE_U);
+    if (right >= grid_size.x) right = grid_size.x;
+    if (bottom >= grid_size.y) bottom = grid_size.y;
+
+    return {glm::uvec2(left, top), glm::uvec2(right, bottom)};
+}
 
-    if (right >= chunk_max_pos.x) right = chunk_max_pos.x;
-    if (bottom >= chunk_max_pos.y) bottom = chunk_max_pos.y;
+static sge::URect expand_chunk_range(const sge::URect& range, const ChunkMargins& margins, const glm::uvec2& grid_size) {
+    const uint32_t left = range.min.x > margins.left ? range.min.x - margins.left : 0;
+    const uint32_t top = range.min.y > margins.top ? range.min.y - margins.top : 0;
+    const uint32_t right = glm::min(range.max.x + margins.right, grid_size.x);
+    const uint32_t bottom = glm::min(range.max.y + margins.bottom, grid_size.y);
 
     return {glm::uvec2(left, top), glm::uvec2(right, bottom)};
 }
 
+// Sets the margin on the leading side of the axis from the extrapolated motion
+// and shrinks the margin on the trailing side
+static void get_axis_margins(float velocity, uint32_t& min_margin, uint32_t& max_margin) {
+    if (glm::abs(velocity) < MIN_PREFETCH_SPEED) {
+        min_margin = IDLE_MARGIN;
+        max_margin = IDLE_MARGIN;
+        return;
+    }
+
+    const float lead_chunks = glm::abs(velocity) * PREFETCH_LOOKAHEAD / ChunkSize::WorldSize();
+    const uint32_t leading = glm::min(IDLE_MARGIN + static_cast<uint32_t>(glm::ceil(lead_chunks)), MAX_LEADING_MARGIN);
+
+    min_margin = velocity < 0.0f ? leading : TRAILING_MARGIN;
+    max_margin = velocity > 0.0f ? leading : TRAILING_MARGIN;
+}
+
+// The distance in chunks from the range, 0 if the chunk is inside of it
+static uint32_t distance_to_range(const sge::URect& range, uint32_t x, uint32_t y) {
+    const uint32_t dx = x < range.min.x ? range.min.x - x : (x >= range.max.x ? x - range.max.x + 1 : 0);
+    const uint32_t dy = y < range.min.y ? range.min.y - y : (y >= range.max.y ? y - range.max.y + 1 : 0);
+    return glm::max(dx, dy);
+}
+
+void ChunkManager::update_camera_velocity(const glm::vec2& camera_pos) {
+    const float dt = sge::Time::DeltaSeconds();
+
+    if (m_has_camera_pos && dt > 0.0f) {
+        const glm::vec2 velocity = (camera_pos - m_last_camera_pos) / dt;
+
+        if (glm::length(velocity) > MAX_CAMERA_SPEED) {
+            m_camera_velocity = glm::vec2(0.0f);
+        } else {
+            m_camera_velocity = glm::mix(m_camera_velocity, velocity, VELOCITY_SMOOTHING);
+        }
+    }
+
+    m_last_camera_pos = camera_pos;
+    m_has_camera_pos = true;
+}
+
+RenderChunk& ChunkManager::load_chunk(const WorldData& world, uint32_t x, uint32_t y) {
+    const uint32_t slot = y * m_grid_size.x + x;
+    std::optional<RenderChunk>& chunk = m_chunk_grid[slot];
+
+    const glm::uvec2 chunk_pos = glm::uvec2(x, y);
+    const glm::vec2 world_pos = glm::vec2(x * TILE_SIZE, y * TILE_SIZE);
+    chunk.emplace(chunk_pos, world_pos);
+    m_active_chunks.push_back(slot);
+    request_mesh(world, *chunk, true, true);
+
+    return *chunk;
+}
+
+void ChunkManager::prefetch_chunks(const WorldData& world, const sge::URect& visible_range, const sge::URect& prefetch_range) {
+    ZoneScoped;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    uint32_t max_distance = 0;
+    max_distance = glm::max(max_distance, visible_range.min.x - prefetch_range.min.x);
+    max_distance = glm::max(max_distance, visible_range.min.y - prefetch_range.min.y);
+    max_distance = glm::max(max_distance, prefetch_range.max.x - visible_range.max.x);
+    max_distance = glm::max(max_distance, prefetch_range.max.y - visible_range.max.y);
+
+    // The closest chunks first, they are needed the soonest
+    for (uint32_t distance = 1; distance <= max_distance; ++distance) {
+        for (uint32_t y = prefetch_range.min.y; y < prefetch_range.max.y; ++y) {
+            for (uint32_t x = prefetch_range.min.x; x < prefetch_range.max.x; ++x) {
+                if (distance_to_range(visible_range, x, y) != distance) continue;
+                if (m_chunk_grid[y * m_grid_size.x + x].has_value()) continue;
+
+                load_chunk(world, x, y);
+                m_prefetch_stats.prefetched++;
+
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                if (elapsed.count() > PREFETCH_TIME_BUDGET) return;
+            }
+        }
+    }
+}
+
+void ChunkManager::request_mesh(const WorldData& world, RenderChunk& chunk, bool build_blocks, bool build_walls) {
+    const uint32_t id = ++m_next_mesh_id;
+    m_mesh_builder.submit(world, chunk.index(), id, build_blocks, build_walls);
+    chunk.set_mesh_requested(id, build_blocks, build_walls);
+}
+
+void ChunkManager::upload_completed_meshes() {
+    ZoneScoped;
+
+    m_mesh_builder.take_completed(m_completed_meshes);
+
+    for (ChunkMeshBuilder::JobPtr& job : m_completed_meshes) {
+        // The chunk could have left the range while its mesh was being built
+        std::optional<RenderChunk>* slot = chunk_slot(job->index);
+        if (slot != nullptr && slot->has_value()) {
+            (*slot)->upload_mesh(*job, m_buffer_pool, m_mesh_stats);
+        }
+
+        m_mesh_builder.recycle(std::move(job));
+    }
+
+    m_completed_meshes.clear();
+}
+
+void ChunkManager::resize_grid(const glm::uvec2& grid_size) {
+    // Only happens when a new world is loaded
+    for (const uint32_t slot : m_active_chunks) {
+        DeferredRelease::Defer([this, chunk = std::move(*m_chunk_grid[slot])]() mutable {
+            chunk.release_buffers(m_buffer_pool);
+            chunk.release_impostor(m_impostor_atlas);
+        });
+    }
+
+    m_active_chunks.clear();
+    m_visible_chunks.clear();
+
+    m_chunk_grid.clear();
+    m_chunk_grid.resize(grid_size.x * grid_size.y);
+    m_grid_size = grid_size;
+}
+
+void ChunkManager::rewrite_buffers_if_resized() {
+    if (m_buffer_pool.generation() == m_buffer_generation) return;
+
+    ZoneScoped;
+
+    for (const uint32_t slot : m_active_chunks) {
+        m_chunk_grid[slot]->rewrite_buffers(m_buffer_pool);
+    }
+
+    m_buffer_generation = m_buffer_pool.generation();
+}
+
+void ChunkManager::shrink_buffer_pool_if_idle() {
+    m_buffer_pool.track_usage();
+    if (!m_buffer_pool.should_shrink()) return;
+
+    m_live_pages.clear();
+    for (const uint32_t slot : m_active_chunks) {
+        m_chunk_grid[slot]->collect_pages(m_live_pages);
+    }
+
+    // The evicted chunks still hold their pages until the GPU is done with them, try again once they are released
+    if (m_live_pages.size() != m_buffer_pool.stats().in_use) return;
+
+    m_buffer_pool.shrink(m_live_pages);
+}
+
+void ChunkManager::update_impostors(const WorldData& world) {
+    ZoneScoped;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (const RenderChunk* visible_chunk : m_visible_chunks) {
+        // The visible list only hands out const pointers, the chunk itself lives in the grid
+        RenderChunk& chunk = **chunk_slot(visible_chunk->index());
+        if (!chunk.impostor_dirty()) continue;
+
+        chunk.update_impostor(world, m_impostor_atlas, m_impostor_colors);
+        m_impostor_stats.updated++;
+    }
+
+    // The layers written before the texture has grown are lost, write all of them again
+    if (m_impostor_atlas.generation() != m_impostor_generation) {
+        for (const uint32_t slot : m_active_chunks) {
+            m_chunk_grid[slot]->set_impostor_dirty();
+        }
+
+        for (const RenderChunk* visible_chunk : m_visible_chunks) {
+            (*chunk_slot(visible_chunk->index()))->update_impostor(world, m_impostor_atlas, m_impostor_colors);
+            m_impostor_stats.updated++;
+        }
+
+        m_impostor_generation = m_impostor_atlas.generation();
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    m_impostor_stats.update_time += elapsed.count();
+}
+
+void ChunkManager::reset() {
+    ZoneScoped;
+
+    m_mesh_builder.wait_idle();
+
+    // The finished meshes belong to the dropped chunks
+    m_mesh_builder.take_completed(m_completed_meshes);
+    for (ChunkMeshBuilder::JobPtr& job : m_completed_meshes) {
+        m_mesh_builder.recycle(std::move(job));
+    }
+    m_completed_meshes.clear();
+
+    // The evicted chunks give their pages back before the pool is destroyed
+    DeferredRelease::Flush();
+
+    destroy();
+
+    m_chunk_grid.clear();
+    m_grid_size = glm::uvec2(0);
+    m_buffer_generation = 0;
+    m_impostor_generation = 0;
+    m_lod_active = false;
+    m_camera_velocity = glm::vec2(0.0f);
+    m_has_camera_pos = false;
+}
+
+void ChunkManager::flush_meshes() {
+    m_mesh_builder.wait_idle();
+    upload_completed_meshes();
+    rewrite_buffers_if_resized();
+}
+
 void ChunkManager::manage_chunks(const WorldData& world, const sge::Camera& camera) {
     ZoneScoped;
 
+    const uint32_t chunk_size = ChunkSize::Get();
+    const glm::uvec2 grid_size = (glm::uvec2(world.area.size()) + chunk_size - 1u) / chunk_size;
+    if (grid_size != m_grid_size) resize_grid(grid_size);
+
+    upload_completed_meshes();
+
+    update_camera_velocity(camera.position());
+
+    ChunkMargins margins;
+    get_axis_margins(m_camera_velocity.x, margins.left, margins.right);
+    get_axis_margins(m_camera_velocity.y, margins.top, margins.bottom);
+
+    // Only the leading sides are built ahead of time, the rest of the margins just delay the eviction
+    ChunkMargins prefetch_margins;
+    if (margins.left > IDLE_MARGIN) prefetch_margins.left = margins.left;
+    if (margins.right > IDLE_MARGIN) prefetch_margins.right = margins.right;
+    if (margins.top > IDLE_MARGIN) prefetch_margins.top = margins.top;
+    if (margins.bottom > IDLE_MARGIN) prefetch_margins.bottom = margins.bottom;
+
     const sge::Rect camera_fov = utils::get_camera_fov(camera);
-    const sge::URect chunk_range = get_chunk_range(camera_fov, world.area.size(), 2);
-    const sge::URect render_chunk_range = get_chunk_range(camera_fov, world.area.size());
+    const sge::URect render_chunk_range = get_chunk_range(camera_fov, m_grid_size);
+    const sge::URect chunk_range = expand_chunk_range(render_chunk_range, margins, m_grid_size);
+    const sge::URect prefetch_range = expand_chunk_range(render_chunk_range, prefetch_margins, m_grid_size);
 
-    for (auto it = m_render_chunks.begin(); it != m_render_chunks.end();) {
-        if (!chunk_range.contains(it->first)) {
-            m_chunks_to_destroy.push_back(it->second);
-            it = m_render_chunks.erase(it);
+    for (size_t i = 0; i < m_active_chunks.size();) {
+        const uint32_t slot = m_active_chunks[i];
+        RenderChunk& chunk = *m_chunk_grid[slot];
+
+        if (!chunk_range.contains(chunk.index())) {
+            // The buffers go back to the pool once the GPU is done with the frames that draw them
+            DeferredRelease::Defer([this, chunk = std::move(chunk)]() mutable {
+                chunk.release_buffers(m_buffer_pool);
+                chunk.release_impostor(m_impostor_atlas);
+            });
+            m_chunk_grid[slot].reset();
+
+            m_active_chunks[i] = m_active_chunks.back();
+            m_active_chunks.pop_back();
             continue;
         }
 
-        if (it->second.dirty()) {
-            it->second.rebuild_mesh(world, m_block_data_arena, m_wall_data_arena);
+        // Small edits are written into the slots of the changed tiles, the rest is rebuilt on the workers.
+        // The chunk keeps rendering its current mesh until the new one is uploaded.
+        if (chunk.dirty()) {
+            const bool rebuild_blocks = chunk.blocks_dirty() && !chunk.update_blocks(world, m_buffer_pool, m_mesh_stats, m_changed_slots);
+            const bool rebuild_walls = chunk.walls_dirty() && !chunk.update_walls(world, m_buffer_pool, m_mesh_stats, m_changed_slots);
+
+            if (rebuild_blocks || rebuild_walls) {
+                request_mesh(world, chunk, rebuild_blocks, rebuild_walls);
+            }
         }
 
-        it++;
+        i++;
     }
 
     m_visible_chunks.clear();
 
     for (uint32_t y = render_chunk_range.min.y; y < render_chunk_range.max.y; ++y) {
         for (uint32_t x = render_chunk_range.min.x; x < render_chunk_range.max.x; ++x) {
-            const glm::uvec2 chunk_pos = glm::uvec2(x, y);
+            std::optional<RenderChunk>& slot = m_chunk_grid[y * m_grid_size.x + x];
 
-            m_visible_chunks.insert(chunk_pos);
+            RenderChunk& chunk = slot.has_value() ? *slot : load_chunk(world, x, y);
 
-            if (m_render_chunks.find(chunk_pos) == m_render_chunks.end()) {
-                const glm::vec2 world_pos = glm::vec2(x * TILE_SIZE, y * TILE_SIZE);
-                m_render_chunks.emplace(chunk_pos, RenderChunk(chunk_pos, world_pos, world, m_block_data_arena, m_wall_data_arena));
+            if (chunk.set_shown()) {
+                if (chunk.mesh_ready()) {
+                    m_prefetch_stats.hits++;
+                } else {
+                    m_prefetch_stats.misses++;
+                }
             }
+
+            m_visible_chunks.push_back(&chunk);
         }
     }
+
+    prefetch_chunks(world, render_chunk_range, prefetch_range);
+
+    shrink_buffer_pool_if_idle();
+    rewrite_buffers_if_resized();
+
+    m_lod_active = camera.zoom() >= Constants::CHUNK_LOD_ZOOM;
+    if (m_lod_active) update_impostors(world);
 }
 
 void ChunkManager::set_blocks_changed(TilePos tile_pos) {
     const glm::uvec2 chunk_pos = utils::get_chunk_pos(tile_pos);
 
-    const auto chunk = m_render_chunks.find(chunk_pos);
-    if (chunk != m_render_chunks.end()) {
-        chunk->second.set_blocks_dirty();
+    std::optional<RenderChunk>* slot = chunk_slot(chunk_pos);
+    if (slot != nullptr && slot->has_value()) {
+        (*slot)->set_blocks_dirty(tile_pos);
+    }
+
+    // The walls around the block could have been covered or uncovered by it
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            const TilePos pos = TilePos(tile_pos.x + x, tile_pos.y + y);
+            if (pos.x < 0 || pos.y < 0) continue;
+            set_walls_changed(pos);
+        }
+    }
+}
+
+void ChunkManager::set_area_changed(const WorldData& world, const sge::IRect& area) {
+    const int chunk_size = static_cast<int>(ChunkSize::Get());
+
+    for (const uint32_t slot : m_active_chunks) {
+        RenderChunk& chunk = *m_chunk_grid[slot];
+
+        const glm::ivec2 min = glm::ivec2(chunk.index()) * chunk_size;
+        const glm::ivec2 max = min + chunk_size;
+
+        if (max.x <= area.min.x || min.x >= area.max.x || max.y <= area.min.y || min.y >= area.max.y) continue;
+
+        request_mesh(world, chunk, true, true);
+        chunk.set_impostor_dirty();
     }
 }
 
 void ChunkManager::set_walls_changed(TilePos tile_pos) {
     const glm::uvec2 chunk_pos = utils::get_chunk_pos(tile_pos);
 
-    const auto chunk = m_render_chunks.find(chunk_pos);
-    if (chunk != m_render_chunks.end()) {
-        chunk->second.set_walls_dirty();
+    std::optional<RenderChunk>* slot = chunk_slot(chunk_pos);
+    if (slot != nullptr && slot->has_value()) {
+        (*slot)->set_walls_dirty(tile_pos);
     }
 }
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include "chunk_mesh_builder.hpp"
+
+#include <algorithm>
+
+#include <SGE/defines.hpp>
+#include <SGE/profile.hpp>
+#include <SGE/utils/alloc.hpp>
+
+// The chunk with a 1 tile border
+static inline uint32_t opaque_mask_size(uint32_t chunk_size) {
+    return chunk_size + 2;
+}
+
+ChunkMeshJob::ChunkMeshJob(uint32_t chunk_size) :
+    chunk_size(chunk_size),
+    blocks(chunk_size * chunk_size),
+    walls(chunk_size * chunk_size),
+    opaque(opaque_mask_size(chunk_size) * opaque_mask_size(chunk_size))
+{
+    const uint32_t tile_count = chunk_size * chunk_size;
+    block_data = sge::checked_alloc<ChunkInstance>(tile_count);
+    wall_data = sge::checked_alloc<ChunkInstance>(tile_count);
+    block_tiles = sge::checked_alloc<uint16_t>(tile_count);
+    wall_tiles = sge::checked_alloc<uint16_t>(tile_count);
+}
+
+ChunkMeshJob::~ChunkMeshJob() {
+    free(block_data);
+    free(wall_data);
+    free(block_tiles);
+    free(wall_tiles);
+}
+
+static SGE_FORCE_INLINE uint16_t pack_tile_data(uint16_t tile_texture_id, uint8_t tile_type) {
+    // 6 bits for tile_type and 10 bits for tile_texture_id
+    return (tile_type & 0x3f) | (tile_texture_id << 6);
+}
+
+static inline bool is_opaque(const std::optional<Block>& block) {
+    return block.has_value() && block_is_opaque(block.value());
+}
+
+bool wall_is_hidden(const WorldData& world, TilePos pos) {
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            if (!is_opaque(world.get_block(TilePos(pos.x + x, pos.y + y)))) return false;
+        }
+    }
+    return true;
+}
+
+static inline bool wall_is_hidden(const ChunkMeshJob& job, uint32_t x, uint32_t y) {
+    const uint32_t mask_size = opaque_mask_size(job.chunk_size);
+
+    // The mask is offset by one tile, so (x, y) is the top left neighbor
+    for (uint32_t j = y; j < y + 3u; ++j) {
+        for (uint32_t i = x; i < x + 3u; ++i) {
+            if (!job.opaque[j * mask_size + i]) return false;
+        }
+    }
+    return true;
+}
+
+ChunkInstance make_block_instance(const Block& block, TilePos pos) {
+    const uint8_t type = tile_type(block);
+    const uint16_t texture_id = static_cast<uint16_t>(tile_texture_type(block));
+
+    return ChunkInstance(pos.x, pos.y, block.atlas_pos.x, block.atlas_pos.y, pack_tile_data(texture_id, type));
+}
+
+ChunkInstance make_wall_instance(const Wall& wall, TilePos pos) {
+    return ChunkInstance(pos.x, pos.y, wall.atlas_pos.x, wall.atlas_pos.y, pack_tile_data(static_cast<uint32_t>(wall.type), TileType::Wall));
+}
+
+static inline uint16_t fill_block_buffer(const ChunkMeshJob& job, ChunkInstance* data, uint16_t* tiles) {
+    const uint32_t chunk_size = job.chunk_size;
+    const uint16_t offset_x = job.index.x * chunk_size;
+    const uint16_t offset_y = job.index.y * chunk_size;
+    uint16_t count = 0;
+
+    for (uint32_t y = 0; y < chunk_size; ++y) {
+        for (uint32_t x = 0; x < chunk_size; ++x) {
+            const uint16_t index = y * chunk_size + x;
+            const std::optional<Block>& tile = job.blocks[index];
+            if (tile.has_value()) {
+                data[count] = make_block_instance(tile.value(), TilePos(offset_x + x, offset_y + y));
+                tiles[count] = index;
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+static inline uint16_t fill_wall_buffer(const ChunkMeshJob& job, ChunkInstance* data, uint16_t* tiles) {
+    const uint32_t chunk_size = job.chunk_size;
+    const uint16_t offset_x = job.index.x * chunk_size;
+    const uint16_t offset_y = job.index.y * chunk_size;
+    uint16_t count = 0;
+
+    for (uint32_t y = 0; y < chunk_size; ++y) {
+        for (uint32_t x = 0; x < chunk_size; ++x) {
+            const uint16_t index = y * chunk_size + x;
+            const std::optional<Wall>& wall = job.walls[index];
+            if (wall.has_value() && !wall_is_hidden(job, x, y)) {
+                data[count] = make_wall_instance(wall.value(), TilePos(offset_x + x, offset_y + y));
+                tiles[count] = index;
+                count++;
+            }
+        }
+    }
+
+    return count;
+}
+
+// Copies `count` tiles of the row `y` from `x` on, the ones outside of the world are empty
+template <typename T>
+static void copy_row(const WorldData& world, const std::optional<T>* tiles, int x, int y, int count, std::optional<T>* out) {
+    const int from = std::max(x, 0);
+    const int to = std::min(x + count, world.area.width());
+
+    if (y < 0 || y >= world.area.height() || from >= to) {
+        std::fill_n(out, count, std::nullopt);
+        return;
+    }
+
+    std::fill_n(out, from - x, std::nullopt);
+    std::copy_n(&tiles[world.get_tile_index(TilePos(from, y))], to - from, out + (from - x));
+    std::fill_n(out + (to - x), x + count - to, std::nullopt);
+}
+
+// Only copies what the workers can't get from the chunk itself: the blocks and the walls of the chunk
+// and whether the blocks on the border around it are opaque
+static void copy_tiles(const WorldData& world, ChunkMeshJob& job) {
+    ZoneScoped;
+
+    const int chunk_size = job.chunk_size;
+    const int offset_x = job.index.x * chunk_size;
+    const int offset_y = job.index.y * chunk_size;
+
+    // The walls are hidden by the opaque blocks, so the blocks are copied for either layer
+    const bool copy_blocks = job.build_blocks || job.build_walls;
+
+    // A row of a chunk is contiguous in the world, so it's copied at once instead of a tile at a time
+    for (int y = 0; y < chunk_size; ++y) {
+        if (copy_blocks) copy_row(world, world.blocks, offset_x, offset_y + y, chunk_size, &job.blocks[y * chunk_size]);
+        if (job.build_walls) copy_row(world, world.walls, offset_x, offset_y + y, chunk_size, &job.walls[y * chunk_size]);
+    }
+
+    if (job.build_walls) {
+        const int mask_size = opaque_mask_size(chunk_size);
+        const auto copy_opaque = [&](int x, int y) {
+            job.opaque[y * mask_size + x] = is_opaque(world.get_block(TilePos(offset_x + x - 1, offset_y + y - 1)));
+        };
+
+        for (int i = 0; i < mask_size; ++i) {
+            copy_opaque(i, 0);
+            copy_opaque(i, mask_size - 1);
+        }
+        for (int i = 1; i < mask_size - 1; ++i) {
+            copy_opaque(0, i);
+            copy_opaque(mask_size - 1, i);
+        }
+    }
+}
+
+// The inside of the opaque mask comes from the blocks of the chunk, the border is copied by copy_tiles
+static void fill_opaque_mask(ChunkMeshJob& job) {
+    const uint32_t chunk_size = job.chunk_size;
+    const uint32_t mask_size = opaque_mask_size(chunk_size);
+
+    for (uint32_t y = 0; y < chunk_size; ++y) {
+        for (uint32_t x = 0; x < chunk_size; ++x) {
+            job.opaque[(y + 1) * mask_size + x + 1] = is_opaque(job.blocks[y * chunk_size + x]);
+        }
+    }
+}
+
+ChunkMeshBuilder::ChunkMeshBuilder() = default;
+
+void ChunkMeshBuilder::start_workers() {
+    // Leave one core for the main thread
+    const uint32_t hardware_threads = std::thread::hardware_concurrency();
+    const uint32_t worker_count = std::clamp(hardware_threads > 1 ? hardware_threads - 1 : 1u, 1u, 4u);
+
+    m_workers.reserve(worker_count);
+    for (uint32_t i = 0; i < worker_count; ++i) {
+        m_workers.emplace_back(&ChunkMeshBuilder::worker_loop, this);
+    }
+}
+
+ChunkMeshBuilder::~ChunkMeshBuilder() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_job_available.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        if (worker.joinable()) worker.join();
+    }
+}
+
+void ChunkMeshBuilder::submit(const WorldData& world, glm::uvec2 index, uint32_t id, bool build_blocks, bool build_walls) {
+    // Not started with the builder, so the headless modes never start them
+    if (m_workers.empty()) start_workers();
+
+    JobPtr job;
+    if (!m_free_jobs.empty()) {
+        job = std::move(m_free_jobs.back());
+        m_free_jobs.pop_back();
+    }
+
+    // The arenas of the recycled jobs are too small or too big after the chunk size has changed
+    if (job == nullptr || job->chunk_size != ChunkSize::Get()) {
+        job = std::make_unique<ChunkMeshJob>(ChunkSize::Get());
+    }
+
+    job->index = index;
+    job->id = id;
+    job->build_blocks = build_blocks;
+    job->build_walls = build_walls;
+    job->block_count = 0;
+    job->wall_count = 0;
+
+    copy_tiles(world, *job);
+
+    {
+        std::lock_guard lock(m_mutex);
+        m_queue.push_back(std::move(job));
+    }
+    m_job_available.notify_one();
+
+    m_pending_jobs++;
+}
+
+void ChunkMeshBuilder::take_completed(std::vector<JobPtr>& jobs) {
+    std::lock_guard lock(m_mutex);
+
+    m_pending_jobs -= m_completed.size();
+
+    for (JobPtr& job : m_completed) {
+        jobs.push_back(std::move(job));
+    }
+    m_completed.clear();
+}
+
+void ChunkMeshBuilder::recycle(JobPtr job) {
+    m_free_jobs.push_back(std::move(job));
+}
+
+void ChunkMeshBuilder::wait_idle() {
+    std::unique_lock lock(m_mutex);
+    m_job_finished.wait(lock, [this] {
+        return m_queue.empty() && m_in_progress == 0;
+    });
+}
+
+void ChunkMeshBuilder::worker_loop() {
+    while (true) {
+        JobPtr job;
+
+        {
+            std::unique_lock lock(m_mutex);
+            m_job_available.wait(lock, [this] {
+                return m_stop || !m_queue.empty();
+            });
+
+            if (m_stop) return;
+
+            job = std::move(m_queue.front());
+            m_queue.pop_front();
+            m_in_progress++;
+        }
+
+        {
+            ZoneScopedN("ChunkMeshBuilder::build");
+
+            if (job->build_blocks) job->block_count = fill_block_buffer(*job, job->block_data, job->block_tiles);
+            if (job->build_walls) {
+                fill_opaque_mask(*job);
+                job->wall_count = fill_wall_buffer(*job, job->wall_data, job->wall_tiles);
+            }
+        }
+
+        {
+            std::lock_guard lock(m_mutex);
+            m_completed.push_back(std::move(job));
+            m_in_progress--;
+        }
+        m_job_finished.notify_all();
+    }
+}
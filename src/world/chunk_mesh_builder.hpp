@@ -0,0 +1,112 @@
+#pragma once
+
+#ifndef WORLD_CHUNK_MESH_BUILDER_HPP_
+#define WORLD_CHUNK_MESH_BUILDER_HPP_
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <glm/vec2.hpp>
+
+#include "../renderer/types.hpp"
+#include "../types/block.hpp"
+#include "../types/wall.hpp"
+#include "../types/tile_pos.hpp"
+
+#include "chunk_size.hpp"
+#include "world_data.hpp"
+
+struct ChunkMeshJob {
+    glm::uvec2 index;
+    uint32_t id = 0;
+    // The chunk size the arenas are allocated for
+    uint32_t chunk_size = 0;
+    bool build_blocks = false;
+    bool build_walls = false;
+
+    // The tiles of the chunk copied on the main thread, so the workers never touch WorldData.
+    // The blocks are copied for the walls too.
+    std::vector<std::optional<Block>> blocks;
+    std::vector<std::optional<Wall>> walls;
+    // 1 for the opaque blocks of the chunk and a 1 tile border around it, only used for walls.
+    // The border is copied on the main thread, the inside is filled from `blocks` by the worker.
+    // The row length is chunk_size + 2.
+    std::vector<uint8_t> opaque;
+
+    // Per-job arenas, reused together with the job
+    ChunkInstance* block_data = nullptr;
+    ChunkInstance* wall_data = nullptr;
+    // The index of the tile in the chunk for every instance
+    uint16_t* block_tiles = nullptr;
+    uint16_t* wall_tiles = nullptr;
+    uint16_t block_count = 0;
+    uint16_t wall_count = 0;
+
+    explicit ChunkMeshJob(uint32_t chunk_size);
+    ~ChunkMeshJob();
+
+    ChunkMeshJob(const ChunkMeshJob&) = delete;
+    ChunkMeshJob& operator=(const ChunkMeshJob&) = delete;
+};
+
+// The wall quad is twice as big as a tile, so it's fully covered
+// if the tile and all the tiles around it have opaque blocks
+bool wall_is_hidden(const WorldData& world, TilePos pos);
+
+ChunkInstance make_block_instance(const Block& block, TilePos pos);
+ChunkInstance make_wall_instance(const Wall& wall, TilePos pos);
+
+// Fills chunk instance data on worker threads, the results are uploaded on the main thread.
+// The workers are started by the first submit.
+class ChunkMeshBuilder {
+public:
+    using JobPtr = std::unique_ptr<ChunkMeshJob>;
+
+    ChunkMeshBuilder();
+    ~ChunkMeshBuilder();
+
+    ChunkMeshBuilder(const ChunkMeshBuilder&) = delete;
+    ChunkMeshBuilder& operator=(const ChunkMeshBuilder&) = delete;
+
+    void submit(const WorldData& world, glm::uvec2 index, uint32_t id, bool build_blocks, bool build_walls);
+
+    // Moves the finished jobs into `jobs`, they must be given back with `recycle`
+    void take_completed(std::vector<JobPtr>& jobs);
+
+    void recycle(JobPtr job);
+
+    // Blocks until every submitted job is finished
+    void wait_idle();
+
+    [[nodiscard]]
+    inline uint32_t pending_jobs() const noexcept {
+        return m_pending_jobs;
+    }
+
+private:
+    void start_workers();
+    void worker_loop();
+
+private:
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_job_available;
+    std::condition_variable m_job_finished;
+    std::deque<JobPtr> m_queue;
+    std::vector<JobPtr> m_completed;
+    uint32_t m_in_progress = 0;
+    bool m_stop = false;
+
+    // Only accessed from the main thread
+    std::vector<JobPtr> m_free_jobs;
+    uint32_t m_pending_jobs = 0;
+};
+
+#endif
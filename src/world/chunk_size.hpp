@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef WORLD_CHUNK_SIZE_HPP_
+#define WORLD_CHUNK_SIZE_HPP_
+
+#include <cstdint>
+
+#include "../constants.hpp"
+
+// The width and the height of a render chunk in tiles, picked at startup with --chunk-size
+namespace ChunkSize {
+    constexpr uint32_t DEFAULT = 50;
+    constexpr uint32_t MIN = 8;
+    // The index of a tile in a chunk is stored in 16 bits
+    constexpr uint32_t MAX = 128;
+
+    namespace internal {
+        inline uint32_t size = DEFAULT;
+    }
+
+    [[nodiscard]]
+    inline constexpr bool IsValid(uint32_t size) noexcept {
+        return size >= MIN && size <= MAX;
+    }
+
+    // The shaders don't depend on the size, the instances carry absolute tile positions.
+    // Changing it after the chunks are created requires ChunkManager::reset.
+    inline void Set(uint32_t size) noexcept {
+        internal::size = size;
+    }
+
+    [[nodiscard]]
+    inline uint32_t Get() noexcept {
+        return internal::size;
+    }
+
+    [[nodiscard]]
+    inline uint32_t TileCount() noexcept {
+        return internal::size * internal::size;
+    }
+
+    // The size of a chunk in pixels
+    [[nodiscard]]
+    inline float WorldSize() noexcept {
+        return internal::size * Constants::TILE_SIZE;
+    }
+};
+
+#endif
@@ -33,11 +33,59 @@ struct Color {
 
 using LightMask = bool;
 
+// While blurring, light is propagated as 8.8 fixed point (value * 255 * 256)
+// so the fractional part isn't lost between steps
+namespace LightBlur {
+    constexpr uint32_t DecayFixed(bool solid) {
+        return static_cast<uint32_t>(Constants::LightDecay(solid) * 65536.0f + 0.5f);
+    }
+
+    // The light below this value has completely decayed
+    constexpr uint16_t EPSILON = gcem::ceil(Constants::LIGHT_EPSILON * 255.0f * 256.0f);
+
+    constexpr uint16_t Decay(uint16_t value, bool solid) {
+        const uint16_t decayed = (value * DecayFixed(solid)) >> 16;
+        return decayed < EPSILON ? 0 : decayed;
+    }
+
+    // The decayed value of every 8-bit light value with the epsilon cut-off folded in
+    struct DecayTable {
+        uint16_t values[256];
+    };
+
+    constexpr DecayTable MakeDecayTable(bool solid) {
+        DecayTable table {};
+        for (uint32_t i = 0; i < 256; ++i) {
+            table.values[i] = Decay(i << 8, solid);
+        }
+        return table;
+    }
+
+    // Indexed by the light mask
+    constexpr DecayTable DECAY_TABLES[2] = { MakeDecayTable(false), MakeDecayTable(true) };
+
+    static_assert(DECAY_TABLES[0].values[255] == Decay(255 << 8, false));
+    static_assert(DECAY_TABLES[1].values[1] == 0);
+};
+
+struct FixedLight {
+    uint16_t r;
+    uint16_t g;
+    uint16_t b;
+
+    FixedLight() noexcept = default;
+
+    explicit FixedLight(const Color& c) noexcept :
+        r(c.r << 8), g(c.g << 8), b(c.b << 8) {}
+};
+
 struct LightMap {
     Color* colors = nullptr;
     LightMask* masks = nullptr;
     int width = 0;
     int height = 0;
+    // If not null, the colors and the masks point into it instead of being owned
+    std::shared_ptr<void> storage;
 
     LightMap() noexcept = default;
 
@@ -49,6 +97,9 @@ struct LightMap {
         masks = new LightMask[width * height]();
     }
 
+    LightMap(Color* colors, LightMask* masks, int width, int height, std::shared_ptr<void> storage) noexcept :
+        colors(colors), masks(masks), width(width), height(height), storage(std::move(storage)) {}
+
     LightMap(const LightMap& other) = delete;
     LightMap& operator=(const LightMap &other) noexcept = delete;
 
@@ -62,8 +113,7 @@ struct LightMap {
     }
 
     ~LightMap() {
-        if (colors != nullptr) delete[] colors;
-        if (masks != nullptr) delete[] masks;
+        release();
     }
 
     [[nodiscard]]
@@ -110,12 +160,61 @@ struct LightMap {
         set_mask(pos.y * width + pos.x, mask);
     }
 
+    [[nodiscard]]
+    inline FixedLight get_fixed_light(TilePos pos) const noexcept {
+        const int index = pos.y * width + pos.x;
+        if (!(index >= 0 && index < width * height)) {
+            return FixedLight(Color(0, 0, 0, 0));
+        }
+
+        return FixedLight(colors[index]);
+    }
+
+    // A single blur step, the light is carried in prev_light and decayed according to prev_mask
+    SGE_FORCE_INLINE void blur(int index, FixedLight& prev_light, LightMask& prev_mask) noexcept {
+        Color& this_light = colors[index];
+        const LightBlur::DecayTable& table = LightBlur::DECAY_TABLES[prev_mask ? 1 : 0];
+
+        blur_channel(this_light.r, prev_light.r, table, prev_mask);
+        blur_channel(this_light.g, prev_light.g, table, prev_mask);
+        blur_channel(this_light.b, prev_light.b, table, prev_mask);
+
+        prev_mask = masks[index];
+    }
+
 private:
-    inline void move(LightMap& from) {
+    static SGE_FORCE_INLINE void blur_channel(uint8_t& this_light, uint16_t& prev_light, const LightBlur::DecayTable& table, bool solid) noexcept {
+        if (prev_light < (this_light << 8)) {
+            // The light is a whole 8-bit value, so it can be decayed with the table
+            prev_light = table.values[this_light];
+        } else {
+            this_light = prev_light >> 8;
+            prev_light = LightBlur::Decay(prev_light, solid);
+        }
+    }
+
+    inline void release() noexcept {
+        if (storage == nullptr) {
+            if (colors != nullptr) delete[] colors;
+            if (masks != nullptr) delete[] masks;
+        }
+
+        colors = nullptr;
+        masks = nullptr;
+        storage.reset();
+    }
+
+    // Frees the buffers this lightmap held before, so a reused WorldData doesn't leak the previous lightmap
+    inline void move(LightMap& from) noexcept {
+        if (this == &from) return;
+
+        release();
+
         this->colors = from.colors;
         this->masks = from.masks;
         this->width = from.width;
         this->height = from.height;
+        this->storage = std::move(from.storage);
 
         from.colors = nullptr;
         from.masks = nullptr;
@@ -0,0 +1,136 @@
+#pragma once
+
+#ifndef WORLD_TILE_BITMAP_HPP_
+#define WORLD_TILE_BITMAP_HPP_
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// One bit per tile, packed into 64 bit words row by row. Every row starts at a new word,
+// so a whole row of a bitplane can be combined with its neighbors a word at a time.
+class TileBitmap {
+public:
+    TileBitmap(int width, int height) :
+        m_width(width),
+        m_height(height),
+        m_words_per_row((width + 63) / 64),
+        m_words(static_cast<size_t>(m_words_per_row) * height, 0) {}
+
+    // Tiles outside of the bitmap are never set
+    [[nodiscard]]
+    inline bool get(int x, int y) const noexcept {
+        if (x < 0 || y < 0 || x >= m_width || y >= m_height) return false;
+        return (m_words[word_index(x, y)] >> (x & 63)) & 1;
+    }
+
+    inline void set(int x, int y) noexcept {
+        m_words[word_index(x, y)] |= uint64_t(1) << (x & 63);
+    }
+
+    inline void clear(int x, int y) noexcept {
+        m_words[word_index(x, y)] &= ~(uint64_t(1) << (x & 63));
+    }
+
+    // Clears the tiles [from_x, to_x] of the row `y`
+    inline void clear_range(int from_x, int to_x, int y) noexcept {
+        uint64_t* words = row(y);
+        for (int x = from_x; x <= to_x; x = (x | 63) + 1) {
+            const int last = std::min(x | 63, to_x);
+            const int bits = last - x + 1;
+            const uint64_t mask = bits == 64 ? ~uint64_t(0) : ((uint64_t(1) << bits) - 1) << (x & 63);
+            words[x >> 6] &= ~mask;
+        }
+    }
+
+    // The first set tile in [from_x, to_x] of the row `y`, or to_x + 1 if there is none
+    [[nodiscard]]
+    inline int find_set(int from_x, int to_x, int y) const noexcept {
+        if (y < 0 || y >= m_height) return to_x + 1;
+
+        const uint64_t* words = row(y);
+        const int last = std::min(to_x, m_width - 1);
+
+        for (int x = std::max(from_x, 0); x <= last; x = (x | 63) + 1) {
+            const uint64_t word = words[x >> 6] >> (x & 63);
+            if (word != 0) {
+                const int found = x + std::countr_zero(word);
+                return found <= last ? found : to_x + 1;
+            }
+        }
+
+        return to_x + 1;
+    }
+
+    // The end (exclusive) of the run of set tiles that starts at `x`
+    [[nodiscard]]
+    inline int run_end(int x, int y) const noexcept {
+        const uint64_t* words = row(y);
+
+        while (x < m_width) {
+            const int ones = std::countr_one(words[x >> 6] >> (x & 63));
+            const int available = 64 - (x & 63);
+            if (ones < available) return std::min(x + ones, m_width);
+            x += available;
+        }
+
+        return m_width;
+    }
+
+    // The start of the run of set tiles that ends right before `x`, `x` itself if the tile before it isn't set
+    [[nodiscard]]
+    inline int run_begin(int x, int y) const noexcept {
+        const uint64_t* words = row(y);
+
+        while (x > 0) {
+            const int last = x - 1;
+            // Moves the bit of `last` to the top, so the ones are counted towards the lower x
+            const int ones = std::countl_one(words[last >> 6] << (63 - (last & 63)));
+            const int available = (last & 63) + 1;
+            if (ones < available) return x - ones;
+            x -= available;
+        }
+
+        return 0;
+    }
+
+    [[nodiscard]]
+    inline uint64_t* row(int y) noexcept {
+        return &m_words[static_cast<size_t>(y) * m_words_per_row];
+    }
+
+    [[nodiscard]]
+    inline const uint64_t* row(int y) const noexcept {
+        return &m_words[static_cast<size_t>(y) * m_words_per_row];
+    }
+
+    [[nodiscard]]
+    inline int width() const noexcept {
+        return m_width;
+    }
+
+    [[nodiscard]]
+    inline int height() const noexcept {
+        return m_height;
+    }
+
+    [[nodiscard]]
+    inline int words_per_row() const noexcept {
+        return m_words_per_row;
+    }
+
+private:
+    [[nodiscard]]
+    inline size_t word_index(int x, int y) const noexcept {
+        return static_cast<size_t>(y) * m_words_per_row + (x >> 6);
+    }
+
+private:
+    int m_width;
+    int m_height;
+    int m_words_per_row;
+    std::vector<uint64_t> m_words;
+};
+
+#endif
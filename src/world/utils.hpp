@@ -11,9 +11,11 @@
 #include "../types/tile_pos.hpp"
 #include "../constants.hpp"
 
+#include "chunk_size.hpp"
+
 namespace utils {
     inline glm::uvec2 get_chunk_pos(TilePos tile_pos) noexcept {
-        return glm::uvec2(tile_pos.x, tile_pos.y) / static_cast<uint32_t>(Constants::RENDER_CHUNK_SIZE_U);
+        return glm::uvec2(tile_pos.x, tile_pos.y) / ChunkSize::Get();
     }
 
     inline sge::Rect get_camera_fov(const sge::Camera& camera) noexcept {
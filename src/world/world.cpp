@@ -10,12 +10,16 @@
 #include <SGE/types/sprite.hpp>
 #include <SGE/utils/random.hpp>
 #include <SGE/profile.hpp>
+#include <SGE/log.hpp>
 
 #include "../types/block.hpp"
 #include "../world/world_gen.h"
+#include "../world/world_cache.hpp"
 #include "../world/autotile.hpp"
 #include "../renderer/renderer.hpp"
 
+#include "utils.hpp"
+
 static void update_lightmap(WorldData& world_data, TilePos pos) {
     using Constants::LIGHT_SOLID_DECAY_STEPS;
 
@@ -52,6 +56,8 @@ void World::set_block(TilePos pos, const Block& tile) {
 
     update_lightmap(m_data, pos);
 
+    m_data.changed_tiles.push_back(pos);
+
     m_chunk_manager.set_blocks_changed(pos);
 
     this->update_neighbors(pos);
@@ -68,7 +74,7 @@ void World::set_block(TilePos pos, BlockType tile_type) {
         m_data.torches.insert(pos);
     }
 
-    m_data.blocks[index] = Block(tile_type);
+    m_data.blocks[index] = Block(tile_type, m_data.block_variant(pos));
 
     reset_tiles(pos, *this);
 
@@ -79,7 +85,7 @@ void World::set_block(TilePos pos, BlockType tile_type) {
 
     update_lightmap(m_data, pos);
 
-    m_data.changed_tiles.emplace_back(pos, 1);
+    m_data.changed_tiles.push_back(pos);
 
     m_chunk_manager.set_blocks_changed(pos);
 }
@@ -107,7 +113,7 @@ void World::remove_block(TilePos pos) {
 
     update_lightmap(m_data, pos);
 
-    m_data.changed_tiles.emplace_back(pos, 0);
+    m_data.changed_tiles.push_back(pos);
 
     reset_tiles(pos, *this);
 
@@ -187,7 +193,7 @@ void World::set_wall(TilePos pos, WallType wall_type) {
 
     const auto index = m_data.get_tile_index(pos);
 
-    m_data.walls[index] = Wall(wall_type);
+    m_data.walls[index] = Wall(wall_type, m_data.wall_variant(pos));
     m_changed = true;
     m_lightmap_changed = true;
 
@@ -217,8 +223,6 @@ void World::remove_wall(TilePos pos) {
 
     update_lightmap(m_data, pos);
 
-    m_data.changed_tiles.emplace_back(pos, 0);
-
     this->update_neighbors(pos);
 }
 
@@ -236,14 +240,86 @@ void World::update_wall(TilePos pos, WallType new_type, uint8_t new_variant) {
     update_neighbors(pos);
 }
 
-void World::generate(uint32_t width, uint32_t height, uint32_t seed) {
+void World::generate_world(uint32_t width, uint32_t height, uint32_t seed, bool lazy, bool cached, WorldGenProgress* progress) {
+    if (cached) {
+        if (progress != nullptr) {
+            progress->pass_count.store(1, std::memory_order_relaxed);
+            progress->pass.store("cache", std::memory_order_relaxed);
+        }
+
+        // The whole world is there, so there is nothing left to generate lazily
+        if (WorldCache::Load(m_data, width, height, seed)) {
+            m_lazy_generator.reset();
+            if (progress != nullptr) progress->passes_done.store(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    if (lazy) {
+        m_lazy_generator->init(m_data, width, height, seed, 0, progress);
+        return;
+    }
+
+    world_generate(m_data, width, height, seed, { .progress = progress });
+
+    // A lazy world isn't whole until every strip is generated and isn't the same as this one, so only this one is saved
+    if (cached) {
+        if (progress != nullptr) progress->pass.store("cache", std::memory_order_relaxed);
+        WorldCache::Store(m_data, width, height);
+    }
+}
+
+void World::generate(uint32_t width, uint32_t height, uint32_t seed, bool lazy, bool cached) {
     ZoneScoped;
 
-    using Constants::WORLD_MAX_LIGHT_COUNT;
+    wait_for_generation();
 
-    world_generate(m_data, width, height, seed);
+    if (lazy) {
+        m_lazy_generator.emplace();
+    } else {
+        m_lazy_generator.reset();
+    }
+
+    generate_world(width, height, seed, lazy, cached, nullptr);
+
+    m_light_count = 0;
+}
+
+void World::generate_async(uint32_t width, uint32_t height, uint32_t seed, bool lazy, bool cached) {
+    ZoneScoped;
+
+    wait_for_generation();
+
+    if (lazy) {
+        m_lazy_generator.emplace();
+    } else {
+        m_lazy_generator.reset();
+    }
 
     m_light_count = 0;
+    m_generation_progress.pass.store(nullptr);
+    m_generation_progress.passes_done.store(0);
+    m_generation_progress.pass_count.store(0);
+    m_generating.store(true);
+
+    m_generation_thread = std::thread([this, width, height, seed, lazy, cached] {
+        generate_world(width, height, seed, lazy, cached, &m_generation_progress);
+        m_generating.store(false);
+    });
+}
+
+void World::wait_for_generation() {
+    if (!m_generation_thread.joinable()) return;
+
+    m_generation_thread.join();
+
+    // The spawn area of a lazy world is there, the rest is generated in the background while the game runs
+    if (m_lazy_generator.has_value()) m_lazy_generator->start_background();
+}
+
+void World::stop_generation() {
+    if (m_generation_thread.joinable()) m_generation_thread.join();
+    if (m_lazy_generator.has_value()) m_lazy_generator->stop_background();
 }
 
 void World::update(const sge::Camera& camera) {
@@ -251,6 +327,10 @@ void World::update(const sge::Camera& camera) {
 
     m_changed = false;
     m_lightmap_changed = false;
+
+    // The chunks are only built from generated strips
+    if (m_lazy_generator.has_value()) generate_visible_strips(camera);
+
     m_chunk_manager.manage_chunks(m_data, camera);
 
     if (m_anim_timer.tick(sge::Time::Delta()).just_finished()) {
@@ -409,6 +489,73 @@ void World::draw(const sge::Camera& camera) {
     GameRenderer::EndOrderMode();
 }
 
+void World::generate_visible_strips(const sge::Camera& camera) {
+    ZoneScoped;
+
+    using Constants::TILE_SIZE;
+
+    // A strip is generated before it comes into view, so moving the camera at the usual speed doesn't wait for it.
+    // The background thread generates the strips around the camera first, so only the visible ones can't wait for it.
+    // A visible strip it is still generating is waited for by generate_columns.
+    const int margin = m_lazy_generator->is_background_running() ? 0 : LazyWorldGenerator::STRIP_WIDTH / 2;
+
+    const sge::Rect camera_fov = utils::get_camera_fov(camera);
+    const int from_x = static_cast<int>(camera_fov.min.x / TILE_SIZE);
+    const int to_x = static_cast<int>(camera_fov.max.x / TILE_SIZE) + 1;
+
+    m_lazy_generator->set_focus((from_x + to_x) / 2);
+
+#if DEBUG_TOOLS
+    const LazyWorldGenStats prev_stats = m_lazy_generator->stats();
+#endif
+
+    strips_generated(m_lazy_generator->commit_background(m_data));
+    strips_generated(m_lazy_generator->generate_columns(m_data, from_x - margin, to_x + margin));
+
+#if DEBUG_TOOLS
+    if (m_lazy_generator->stats().strips != prev_stats.strips) {
+        SGE_LOG_DEBUG("Generated {} strips of the world in {:.2f} ms, waited for {} of them",
+            m_lazy_generator->stats().strips - prev_stats.strips,
+            (m_lazy_generator->stats().total_time - prev_stats.total_time) * 1e3,
+            m_lazy_generator->stats().waited_strips - prev_stats.waited_strips);
+    }
+#endif
+}
+
+void World::strips_generated(const sge::IRect& area) {
+    using Constants::SUBDIVISION;
+    using Constants::LIGHT_AIR_DECAY_STEPS;
+
+    // How far the light of the new strip reaches into the ones next to it, in tiles
+    static constexpr int LIGHT_MARGIN = LIGHT_AIR_DECAY_STEPS / SUBDIVISION + 1;
+
+    if (area.width() <= 0) return;
+
+    // The tile texture and the light mask of the dynamic lighting only need the tiles that aren't empty anymore
+    for (int y = area.min.y; y < area.max.y; ++y) {
+        for (int x = area.min.x; x < area.max.x; ++x) {
+            const TilePos pos = TilePos(x, y);
+            if (m_data.block_exists(pos)) m_data.changed_tiles.push_back(pos);
+        }
+    }
+
+    const sge::IRect light_area = sge::IRect::from_corners(
+        glm::ivec2(area.min.x - LIGHT_MARGIN, area.min.y),
+        glm::ivec2(area.max.x + LIGHT_MARGIN, area.max.y)
+    ).clamp(m_data.area);
+    m_data.lightmap_update_area_async(light_area);
+
+    // The chunks next to the strips can have their walls covered by them
+    const sge::IRect chunk_area = sge::IRect::from_corners(
+        glm::ivec2(area.min.x - 1, area.min.y),
+        glm::ivec2(area.max.x + 1, area.max.y)
+    );
+    m_chunk_manager.set_area_changed(m_data, chunk_area);
+
+    m_changed = true;
+    m_lightmap_changed = true;
+}
+
 void World::update_neighbors(TilePos initial_pos) {
     for (int y = initial_pos.y - 3; y < initial_pos.y + 3; ++y) {
         for (int x = initial_pos.x - 3; x < initial_pos.x + 3; ++x) {
@@ -434,7 +581,7 @@ void World::update_tile_sprite_index(TilePos pos) {
     }
 
     if (wall) {
-        const Neighbors<Wall> neighbors = this->get_wall_neighbors(pos);
+        const Neighbors<WallType> neighbors = this->get_wall_type_neighbors(pos);
 
         update_wall_sprite_index(*wall, neighbors);
 
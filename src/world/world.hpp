@@ -3,7 +3,10 @@
 #ifndef WORLD_WORLD_HPP_
 #define WORLD_WORLD_HPP_
 
+#include <atomic>
 #include <cstdint>
+#include <optional>
+#include <thread>
 
 #include <SGE/math/rect.hpp>
 #include <SGE/renderer/camera.hpp>
@@ -21,6 +24,7 @@
 
 #include "chunk_manager.hpp"
 #include "dropped_item.hpp"
+#include "world_gen.h"
 
 struct TileDigAnimation {
     TilePos tile_pos;
@@ -34,7 +38,28 @@ class World {
 public:
     void init();
 
-    void generate(uint32_t width, uint32_t height, uint32_t seed);
+    // With `lazy` only the strips around the spawn point are generated, the rest are generated by update once the camera gets close.
+    // With `cached` the world is loaded from WorldCache if it's there, and a world generated eagerly is saved to it.
+    void generate(uint32_t width, uint32_t height, uint32_t seed, bool lazy = false, bool cached = false);
+
+    // Generates the world on a background thread. Nothing but generation_progress can be used
+    // until is_generating returns false and wait_for_generation is called.
+    // The remaining strips of a lazy world are generated in the background from then on.
+    void generate_async(uint32_t width, uint32_t height, uint32_t seed, bool lazy = false, bool cached = false);
+    void wait_for_generation();
+
+    // Stops every generation thread, the strips of a lazy world that aren't generated yet stay empty
+    void stop_generation();
+
+    [[nodiscard]]
+    inline bool is_generating() const noexcept {
+        return m_generating.load();
+    }
+
+    [[nodiscard]]
+    inline const WorldGenProgress& generation_progress() const noexcept {
+        return m_generation_progress;
+    }
 
     void set_block(TilePos pos, const Block& block);
     void set_block(TilePos pos, BlockType block_type);
@@ -156,6 +181,12 @@ public:
         return m_data.layers;
     }
 
+    // Empty if the world isn't generated lazily
+    [[nodiscard]]
+    inline const std::optional<LazyWorldGenerator>& lazy_generator() const noexcept {
+        return m_lazy_generator;
+    }
+
     [[nodiscard]]
     inline bool is_changed() const noexcept {
         return m_changed;
@@ -232,12 +263,19 @@ public:
 private:
     void update_neighbors(TilePos pos);
     void stack_dropped_items();
+    void generate_world(uint32_t width, uint32_t height, uint32_t seed, bool lazy, bool cached, WorldGenProgress* progress);
+    void generate_visible_strips(const sge::Camera& camera);
+    void strips_generated(const sge::IRect& area);
 
 private:
     WorldData m_data;
     sge::TextureAtlasSprite m_flames_sprite;
     sge::TextureAtlasSprite m_cracks_sprite;
     ChunkManager m_chunk_manager;
+    std::optional<LazyWorldGenerator> m_lazy_generator;
+    std::thread m_generation_thread;
+    std::atomic<bool> m_generating = false;
+    WorldGenProgress m_generation_progress;
     LookupList<DroppedItem> m_dropped_items = LookupList<DroppedItem>(glm::vec2{ Constants::ITEM_GRAB_RANGE * 0.5f });
     std::unordered_map<TilePos, uint8_t> m_block_cracks;
     std::unordered_map<TilePos, uint8_t> m_wall_cracks;
@@ -0,0 +1,416 @@
+#include "world_cache.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+
+#include <SGE/defines.hpp>
+#include <SGE/log.hpp>
+#include <fmt/format.h>
+
+#if SGE_PLATFORM_WINDOWS
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Set by CMake to a hash of every source the generated world depends on
+#ifndef WORLD_GEN_HASH
+    #error "WORLD_GEN_HASH must be defined"
+#endif
+
+// Set by CMake to a hash of the compiler and the flags the generator is built with
+#ifndef WORLD_GEN_BUILD_HASH
+    #error "WORLD_GEN_BUILD_HASH must be defined"
+#endif
+
+namespace fs = std::filesystem;
+
+// Bump when the layout of the file changes
+static constexpr uint32_t FORMAT_VERSION = 2;
+static constexpr char MAGIC[8] = { 'T', 'C', 'W', 'O', 'R', 'L', 'D', '\0' };
+// The planes start on a cache line
+static constexpr uint64_t PLANE_ALIGNMENT = 64;
+
+// The planes are mapped as they are, so they can't hold anything but their bytes
+static_assert(std::is_trivially_copyable_v<std::optional<Block>>);
+static_assert(std::is_trivially_copyable_v<std::optional<Wall>>);
+static_assert(std::is_trivially_copyable_v<Color>);
+static_assert(std::is_trivially_copyable_v<LightMask>);
+
+struct Header {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t seed;
+    uint64_t generator_hash;
+    uint64_t build_hash;
+    uint32_t width;
+    uint32_t height;
+
+    // A build with another layout of the tiles can't read the planes
+    uint32_t block_size;
+    uint32_t wall_size;
+    uint32_t color_size;
+    uint32_t mask_size;
+
+    int32_t area[4];
+    int32_t playable_area[4];
+    Layers layers;
+    uint32_t spawn_point[2];
+    int32_t lightmap_width;
+    int32_t lightmap_height;
+
+    uint64_t blocks_offset;
+    uint64_t walls_offset;
+    uint64_t colors_offset;
+    uint64_t masks_offset;
+    uint64_t file_size;
+
+    // Of the four planes in order, so a damaged file isn't mapped
+    uint64_t planes_checksum;
+};
+
+struct PlaneLayout {
+    uint64_t blocks;
+    uint64_t walls;
+    uint64_t colors;
+    uint64_t masks;
+    uint64_t end;
+};
+
+static WorldCache::Stats stats;
+
+static constexpr uint64_t align_up(uint64_t value) {
+    return (value + PLANE_ALIGNMENT - 1) / PLANE_ALIGNMENT * PLANE_ALIGNMENT;
+}
+
+static PlaneLayout plane_layout(uint64_t tile_count, uint64_t light_count) {
+    PlaneLayout layout;
+    layout.blocks = align_up(sizeof(Header));
+    layout.walls = align_up(layout.blocks + tile_count * sizeof(std::optional<Block>));
+    layout.colors = align_up(layout.walls + tile_count * sizeof(std::optional<Wall>));
+    layout.masks = align_up(layout.colors + light_count * sizeof(Color));
+    layout.end = layout.masks + light_count * sizeof(LightMask);
+    return layout;
+}
+
+static inline uint64_t rotl(uint64_t value, int shift) {
+    return (value << shift) | (value >> (64 - shift));
+}
+
+// A fast checksum in the style of xxHash with four independent lanes.
+// It only has to catch a damaged file, not a deliberately changed one.
+static uint64_t checksum(uint64_t hash, const void* data, uint64_t size) {
+    static constexpr uint64_t PRIME_1 = 0x9E3779B185EBCA87ull;
+    static constexpr uint64_t PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+    uint64_t lanes[4] = { hash + PRIME_1, hash + PRIME_2, hash, hash - PRIME_1 };
+
+    uint64_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i + lane * 8, sizeof(word));
+            lanes[lane] = rotl(lanes[lane] + word * PRIME_2, 31) * PRIME_1;
+        }
+    }
+
+    hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18) + size;
+
+    for (; i < size; ++i) {
+        hash = rotl(hash ^ (bytes[i] * PRIME_1), 11) * PRIME_2;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME_2;
+    hash ^= hash >> 29;
+    return hash;
+}
+
+static uint64_t planes_checksum(const void* blocks, const void* walls, const void* colors, const void* masks, uint64_t tile_count, uint64_t light_count) {
+    uint64_t hash = checksum(0, blocks, tile_count * sizeof(std::optional<Block>));
+    hash = checksum(hash, walls, tile_count * sizeof(std::optional<Wall>));
+    hash = checksum(hash, colors, light_count * sizeof(Color));
+    return checksum(hash, masks, light_count * sizeof(LightMask));
+}
+
+static fs::path cache_directory() {
+    return fs::path("cache") / "worlds";
+}
+
+// Every file of a seed, a size and a build configuration starts with the same prefix, the hash of the generator follows it.
+// The build configuration is in the prefix so a Debug and a Release build don't remove each other's files.
+static std::string file_prefix(uint32_t width, uint32_t height, uint32_t seed) {
+    return fmt::format("{:08x}-{}x{}-{:016x}-", seed, width, height, static_cast<uint64_t>(WORLD_GEN_BUILD_HASH));
+}
+
+static fs::path file_path(uint32_t width, uint32_t height, uint32_t seed) {
+    return cache_directory() / fmt::format("{}{:016x}.world", file_prefix(width, height, seed), static_cast<uint64_t>(WORLD_GEN_HASH));
+}
+
+// Maps the whole file copy-on-write, null if it can't be opened
+static std::shared_ptr<void> map_file(const fs::path& path, uint64_t& size) {
+#if SGE_PLATFORM_WINDOWS
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return nullptr;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) return nullptr;
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    // The view keeps the mapping alive
+    CloseHandle(mapping);
+    if (data == nullptr) return nullptr;
+
+    size = file_size.QuadPart;
+    return std::shared_ptr<void>(data, [](void* data) { UnmapViewOfFile(data); });
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        return nullptr;
+    }
+
+    const size_t file_size = file_stat.st_size;
+    void* data = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file alive
+    close(fd);
+    if (data == MAP_FAILED) return nullptr;
+
+    size = file_size;
+    return std::shared_ptr<void>(data, [file_size](void* data) { munmap(data, file_size); });
+#endif
+}
+
+static bool header_matches(const Header& header, uint64_t file_size, uint32_t width, uint32_t height, uint32_t seed) {
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) return false;
+    if (header.format_version != FORMAT_VERSION) return false;
+    if (header.generator_hash != static_cast<uint64_t>(WORLD_GEN_HASH)) return false;
+    if (header.build_hash != static_cast<uint64_t>(WORLD_GEN_BUILD_HASH)) return false;
+    if (header.seed != seed || header.width != width || header.height != height) return false;
+
+    if (header.block_size != sizeof(std::optional<Block>) || header.wall_size != sizeof(std::optional<Wall>)) return false;
+    if (header.color_size != sizeof(Color) || header.mask_size != sizeof(LightMask)) return false;
+
+    const int64_t area_width = header.area[2] - header.area[0];
+    const int64_t area_height = header.area[3] - header.area[1];
+    if (area_width <= 0 || area_height <= 0 || header.lightmap_width <= 0 || header.lightmap_height <= 0) return false;
+
+    const PlaneLayout layout = plane_layout(
+        static_cast<uint64_t>(area_width) * area_height,
+        static_cast<uint64_t>(header.lightmap_width) * header.lightmap_height
+    );
+
+    // Also catches a truncated file
+    return header.blocks_offset == layout.blocks
+        && header.walls_offset == layout.walls
+        && header.colors_offset == layout.colors
+        && header.masks_offset == layout.masks
+        && header.file_size == layout.end
+        && file_size == layout.end;
+}
+
+bool WorldCache::Load(WorldData& world, uint32_t width, uint32_t height, uint32_t seed) {
+    const auto start = std::chrono::steady_clock::now();
+    const fs::path path = file_path(width, height, seed);
+
+    uint64_t size = 0;
+    std::shared_ptr<void> storage = map_file(path, size);
+    if (storage == nullptr) {
+        ++stats.misses;
+        SGE_LOG_DEBUG("World cache miss: {}", path.string());
+        return false;
+    }
+
+    Header header;
+    if (size >= sizeof(Header)) std::memcpy(&header, storage.get(), sizeof(Header));
+
+    if (size < sizeof(Header) || !header_matches(header, size, width, height, seed)) {
+        ++stats.misses;
+        ++stats.mismatches;
+        SGE_LOG_DEBUG("World cache mismatch, generating the world again: {}", path.string());
+        return false;
+    }
+
+    uint8_t* data = static_cast<uint8_t*>(storage.get());
+
+    // The planes are used as they are, a damaged tile would be an invalid BlockType
+    const uint64_t checksum = planes_checksum(
+        data + header.blocks_offset,
+        data + header.walls_offset,
+        data + header.colors_offset,
+        data + header.masks_offset,
+        static_cast<uint64_t>(header.area[2] - header.area[0]) * (header.area[3] - header.area[1]),
+        static_cast<uint64_t>(header.lightmap_width) * header.lightmap_height
+    );
+
+    if (checksum != header.planes_checksum) {
+        ++stats.misses;
+        ++stats.mismatches;
+        SGE_LOG_DEBUG("World cache file is damaged, generating the world again: {}", path.string());
+        return false;
+    }
+
+    world.destroy();
+    world.area = sge::IRect::from_corners(glm::ivec2(header.area[0], header.area[1]), glm::ivec2(header.area[2], header.area[3]));
+    world.playable_area = sge::IRect::from_corners(
+        glm::ivec2(header.playable_area[0], header.playable_area[1]),
+        glm::ivec2(header.playable_area[2], header.playable_area[3])
+    );
+    world.layers = header.layers;
+    world.spawn_point = glm::uvec2(header.spawn_point[0], header.spawn_point[1]);
+    world.seed = header.seed;
+    world.origin_x = 0;
+    world.blocks = reinterpret_cast<std::optional<Block>*>(data + header.blocks_offset);
+    world.walls = reinterpret_cast<std::optional<Wall>*>(data + header.walls_offset);
+    world.lightmap = LightMap(
+        reinterpret_cast<Color*>(data + header.colors_offset),
+        reinterpret_cast<LightMask*>(data + header.masks_offset),
+        header.lightmap_width,
+        header.lightmap_height,
+        storage
+    );
+    world.storage = std::move(storage);
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ++stats.hits;
+    stats.load_time += elapsed.count();
+
+    SGE_LOG_DEBUG("World cache hit in {:.2f} ms: {}", elapsed.count() * 1e3, path.string());
+
+    return true;
+}
+
+// Pads the file with zeros up to `offset`
+static bool write_padding(std::FILE* file, uint64_t& written, uint64_t offset) {
+    static constexpr uint8_t ZEROS[PLANE_ALIGNMENT] = {};
+    const uint64_t count = offset - written;
+    written = offset;
+    return std::fwrite(ZEROS, 1, count, file) == count;
+}
+
+static bool write_plane(std::FILE* file, uint64_t& written, uint64_t offset, const void* data, uint64_t size) {
+    if (!write_padding(file, written, offset)) return false;
+    written += size;
+    return std::fwrite(data, 1, size, file) == size;
+}
+
+// Removes the files of the same seed, size and build configuration written by other generators
+static void remove_stale_files(const fs::path& current, uint32_t width, uint32_t height, uint32_t seed) {
+    const std::string prefix = file_prefix(width, height, seed);
+
+    std::error_code error;
+    for (const fs::directory_entry& entry : fs::directory_iterator(cache_directory(), error)) {
+        const std::string name = entry.path().filename().string();
+        if (name.starts_with(prefix) && entry.path() != current) {
+            fs::remove(entry.path(), error);
+        }
+    }
+}
+
+bool WorldCache::Store(const WorldData& world, uint32_t width, uint32_t height) {
+    const auto start = std::chrono::steady_clock::now();
+    const fs::path path = file_path(width, height, world.seed);
+
+    std::error_code error;
+    fs::create_directories(cache_directory(), error);
+    if (error) {
+        SGE_LOG_ERROR("Couldn't create the world cache directory: {}", error.message());
+        return false;
+    }
+
+    const uint64_t tile_count = static_cast<uint64_t>(world.area.width()) * world.area.height();
+    const uint64_t light_count = static_cast<uint64_t>(world.lightmap.width) * world.lightmap.height;
+    const PlaneLayout layout = plane_layout(tile_count, light_count);
+
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format_version = FORMAT_VERSION;
+    header.seed = world.seed;
+    header.generator_hash = WORLD_GEN_HASH;
+    header.build_hash = WORLD_GEN_BUILD_HASH;
+    header.width = width;
+    header.height = height;
+    header.block_size = sizeof(std::optional<Block>);
+    header.wall_size = sizeof(std::optional<Wall>);
+    header.color_size = sizeof(Color);
+    header.mask_size = sizeof(LightMask);
+    header.area[0] = world.area.min.x;
+    header.area[1] = world.area.min.y;
+    header.area[2] = world.area.max.x;
+    header.area[3] = world.area.max.y;
+    header.playable_area[0] = world.playable_area.min.x;
+    header.playable_area[1] = world.playable_area.min.y;
+    header.playable_area[2] = world.playable_area.max.x;
+    header.playable_area[3] = world.playable_area.max.y;
+    header.layers = world.layers;
+    header.spawn_point[0] = world.spawn_point.x;
+    header.spawn_point[1] = world.spawn_point.y;
+    header.lightmap_width = world.lightmap.width;
+    header.lightmap_height = world.lightmap.height;
+    header.blocks_offset = layout.blocks;
+    header.walls_offset = layout.walls;
+    header.colors_offset = layout.colors;
+    header.masks_offset = layout.masks;
+    header.file_size = layout.end;
+    header.planes_checksum = planes_checksum(world.blocks, world.walls, world.lightmap.colors, world.lightmap.masks, tile_count, light_count);
+
+    // Written next to the file and renamed over it, so a crash never leaves a partial file under the real name
+    fs::path temp_path = path;
+    temp_path += ".tmp";
+
+    std::FILE* file = std::fopen(temp_path.string().c_str(), "wb");
+    if (file == nullptr) {
+        SGE_LOG_ERROR("Couldn't open {} to write the world cache", temp_path.string());
+        return false;
+    }
+
+    uint64_t written = sizeof(Header);
+    bool ok = std::fwrite(&header, sizeof(Header), 1, file) == 1;
+    ok = ok && write_plane(file, written, layout.blocks, world.blocks, tile_count * sizeof(std::optional<Block>));
+    ok = ok && write_plane(file, written, layout.walls, world.walls, tile_count * sizeof(std::optional<Wall>));
+    ok = ok && write_plane(file, written, layout.colors, world.lightmap.colors, light_count * sizeof(Color));
+    ok = ok && write_plane(file, written, layout.masks, world.lightmap.masks, light_count * sizeof(LightMask));
+    ok = (std::fclose(file) == 0) && ok;
+
+    if (ok) fs::rename(temp_path, path, error);
+
+    if (!ok || error) {
+        SGE_LOG_ERROR("Couldn't write the world cache to {}", path.string());
+        fs::remove(temp_path, error);
+        return false;
+    }
+
+    remove_stale_files(path, width, height, world.seed);
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ++stats.stores;
+    stats.store_time += elapsed.count();
+
+    SGE_LOG_DEBUG("World cache written in {:.2f} ms: {}", elapsed.count() * 1e3, path.string());
+
+    return true;
+}
+
+const WorldCache::Stats& WorldCache::GetStats() noexcept {
+    return stats;
+}
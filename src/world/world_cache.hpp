@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef WORLD_WORLD_CACHE_HPP_
+#define WORLD_WORLD_CACHE_HPP_
+
+#include <cstdint>
+
+#include "world_data.hpp"
+
+// Generated worlds saved to disk, keyed by the seed, the size, a hash of the generator sources and a hash of the compiler flags.
+// Every build configuration keeps its own files, and a file whose planes don't match their checksum is never mapped.
+// A cached world is mapped copy-on-write, so the game can change it without touching the file.
+namespace WorldCache {
+    struct Stats {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        // The misses where there was a file, but it was written by another generator or is damaged
+        uint32_t mismatches = 0;
+        uint32_t stores = 0;
+        // In seconds
+        double load_time = 0.0;
+        double store_time = 0.0;
+    };
+
+    // Maps the cached world into `world`. Returns false and leaves the world alone if there isn't a valid one.
+    bool Load(WorldData& world, uint32_t width, uint32_t height, uint32_t seed);
+
+    // Saves a world generated by world_generate with the same arguments. Returns false if it couldn't be written.
+    bool Store(const WorldData& world, uint32_t width, uint32_t height);
+
+    [[nodiscard]]
+    const Stats& GetStats() noexcept;
+};
+
+#endif
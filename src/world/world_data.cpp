@@ -160,72 +160,37 @@ static void internal_lightmap_init_area(WorldData& world, LightMap& lightmap, co
     }
 }
 
-static void blur(LightMap& lightmap, int index, glm::vec3& prev_light, float& prev_decay) {
-    using Constants::LIGHT_EPSILON;
-
-    glm::vec3 this_light = lightmap.get_color(index);
-
-    prev_light.r = prev_light.r < LIGHT_EPSILON ? 0.0f : prev_light.r;
-    prev_light.g = prev_light.g < LIGHT_EPSILON ? 0.0f : prev_light.g;
-    prev_light.b = prev_light.b < LIGHT_EPSILON ? 0.0f : prev_light.b;
-
-    if (prev_light.r < this_light.r) {
-        prev_light.r = this_light.r;
-    } else {
-        this_light.r = prev_light.r;
-    }
-
-    if (prev_light.g < this_light.g) {
-        prev_light.g = this_light.g;
-    } else {
-        this_light.g = prev_light.g;
-    }
-
-    if (prev_light.b < this_light.b) {
-        prev_light.b = this_light.b;
-    } else {
-        this_light.b = prev_light.b;
-    }
-
-    lightmap.set_color(index, this_light);
-
-    prev_light = prev_light * prev_decay;
-    prev_decay = Constants::LightDecay(lightmap.get_mask(index));
-}
-
-SGE_FORCE_INLINE static void blur_line(LightMap& lightmap, int start, int end, int stride, glm::vec3& prev_light, float& prev_decay, glm::vec3& prev_light2, float& prev_decay2) {
-    using Constants::LIGHT_EPSILON;
-
+SGE_FORCE_INLINE static void blur_line(LightMap& lightmap, int start, int end, int stride, FixedLight& prev_light, LightMask& prev_mask, FixedLight& prev_light2, LightMask& prev_mask2) {
     int length = end - start;
     for (int index = 0; index < length; index += stride) {
-        blur(lightmap, start + index, prev_light, prev_decay);
-        blur(lightmap, end - index, prev_light2, prev_decay2);
+        lightmap.blur(start + index, prev_light, prev_mask);
+        lightmap.blur(end - index, prev_light2, prev_mask2);
     }
 }
 
 inline static void blur_horizontal(const WorldData& world, LightMap& lightmap, const sge::IRect& area, TilePos offset) {
     #pragma omp parallel for
     for (int y = area.min.y; y < area.max.y; ++y) {
-        glm::vec3 prev_light = world.lightmap.get_color({offset.x + area.min.x, offset.y + y});
-        float prev_decay = Constants::LightDecay(world.lightmap.get_mask({(offset.x + area.min.x) - 1, (offset.y + y)}));
+        FixedLight prev_light = world.lightmap.get_fixed_light({offset.x + area.min.x, offset.y + y});
+        LightMask prev_mask = world.lightmap.get_mask({(offset.x + area.min.x) - 1, (offset.y + y)});
 
-        glm::vec3 prev_light2 = world.lightmap.get_color({offset.x + area.max.x - 1, offset.y + y});
-        float prev_decay2 = Constants::LightDecay(world.lightmap.get_mask({(offset.x + area.max.x), (offset.y + y)}));
+        FixedLight prev_light2 = world.lightmap.get_fixed_light({offset.x + area.max.x - 1, offset.y + y});
+        LightMask prev_mask2 = world.lightmap.get_mask({(offset.x + area.max.x), (offset.y + y)});
 
-        blur_line(lightmap, y * lightmap.width + area.min.x, y * lightmap.width + (area.max.x - 1), 1, prev_light, prev_decay, prev_light2, prev_decay2);
+        blur_line(lightmap, y * lightmap.width + area.min.x, y * lightmap.width + (area.max.x - 1), 1, prev_light, prev_mask, prev_light2, prev_mask2);
     }
 }
 
 inline static void blur_vertical(const WorldData& world, LightMap& lightmap, const sge::IRect& area, TilePos offset) {
     #pragma omp parallel for
     for (int x = area.min.x; x < area.max.x; ++x) {
-        glm::vec3 prev_light = world.lightmap.get_color({offset.x + x, offset.y + area.min.y});
-        float prev_decay = Constants::LightDecay(world.lightmap.get_mask({(offset.x + x), (offset.y + area.min.y) - 1}));
+        FixedLight prev_light = world.lightmap.get_fixed_light({offset.x + x, offset.y + area.min.y});
+        LightMask prev_mask = world.lightmap.get_mask({(offset.x + x), (offset.y + area.min.y) - 1});
 
-        glm::vec3 prev_light2 = world.lightmap.get_color({offset.x + x, offset.y + area.max.y - 1});
-        float prev_decay2 = Constants::LightDecay(world.lightmap.get_mask({(offset.x + x), (offset.y + area.max.y)}));
+        FixedLight prev_light2 = world.lightmap.get_fixed_light({offset.x + x, offset.y + area.max.y - 1});
+        LightMask prev_mask2 = world.lightmap.get_mask({(offset.x + x), (offset.y + area.max.y)});
 
-        blur_line(lightmap, area.min.y * lightmap.width + x, (area.max.y - 1) * lightmap.width + x, lightmap.width, prev_light, prev_decay, prev_light2, prev_decay2);
+        blur_line(lightmap, area.min.y * lightmap.width + x, (area.max.y - 1) * lightmap.width + x, lightmap.width, prev_light, prev_mask, prev_light2, prev_mask2);
     }
 }
 
@@ -3,7 +3,8 @@
 #ifndef WORLD_WORLD_DATA_HPP_
 #define WORLD_WORLD_DATA_HPP_
 
-#include <deque>
+#include <memory>
+#include <vector>
 #include <unordered_set>
 
 #include <SGE/math/rect.hpp>
@@ -13,6 +14,7 @@
 #include "../types/wall.hpp"
 #include "../types/tile_pos.hpp"
 #include "../types/neighbors.hpp"
+#include "../math/hash_rng.hpp"
 
 #include "lightmap.hpp"
 
@@ -24,7 +26,7 @@ struct Layers {
 };
 
 struct WorldData {
-    std::deque<std::pair<TilePos, int>> changed_tiles;
+    std::vector<TilePos> changed_tiles;
     std::unordered_set<TilePos> torches;
     sge::SwapbackVector<LightMapTask> lightmap_tasks;
     LightMap lightmap;
@@ -32,8 +34,15 @@ struct WorldData {
     sge::IRect playable_area;
     Layers layers;
     glm::uvec2 spawn_point;
-    std::optional<Block>* blocks;
-    std::optional<Wall>* walls;
+    // The seed the world was generated with, the tile variants are keyed by it
+    uint32_t seed = 0;
+    // The x of the column 0 in the generated world. Only the scratch worlds of the lazy generation hold
+    // a part of the world, the variants, the random numbers and the noise are keyed by the position in the whole world.
+    int origin_x = 0;
+    std::optional<Block>* blocks = nullptr;
+    std::optional<Wall>* walls = nullptr;
+    // If not null, the blocks and the walls point into it instead of being owned, see WorldCache
+    std::shared_ptr<void> storage;
 
     [[nodiscard]]
     inline uint32_t get_tile_index(TilePos pos) const noexcept {
@@ -45,6 +54,17 @@ struct WorldData {
         return (pos.x >= 0 && pos.y >= 0 && pos.x < this->area.width() && pos.y < this->area.height());
     }
 
+    // The same tile at the same position always gets the same variant
+    [[nodiscard]]
+    inline uint8_t block_variant(TilePos pos) const noexcept {
+        return static_cast<uint8_t>(hash_rng_below(this->seed, pos.x + this->origin_x, pos.y, RngPurpose::BlockVariant, 3));
+    }
+
+    [[nodiscard]]
+    inline uint8_t wall_variant(TilePos pos) const noexcept {
+        return static_cast<uint8_t>(hash_rng_below(this->seed, pos.x + this->origin_x, pos.y, RngPurpose::WallVariant, 3));
+    }
+
     [[nodiscard]]
     std::optional<Block> get_block(TilePos pos) const noexcept {
         if (!is_tilepos_valid(pos)) return std::nullopt;
@@ -149,8 +169,13 @@ struct WorldData {
     }
 
     inline void destroy() {
-        delete[] blocks;
-        delete[] walls;
+        if (storage == nullptr) {
+            delete[] blocks;
+            delete[] walls;
+        }
+        blocks = nullptr;
+        walls = nullptr;
+        storage.reset();
     }
 
     ~WorldData() {
@@ -1,25 +1,113 @@
 #include "world_gen.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
 #include <vector>
-#include <ctime>
+#include <thread>
 
 #include <FastNoiseLite/FastNoiseLite.hpp>
 #include <SGE/log.hpp>
-#include <SGE/utils/random.hpp>
 
 #include "../types/wall.hpp"
 #include "../math/math.hpp"
+#include "../math/hash_rng.hpp"
 
 #include "autotile.hpp"
+#include "batch_noise.hpp"
+#include "tile_bitmap.hpp"
 
 using Constants::SUBDIVISION;
 
 static constexpr int DIRT_HILL_HEIGHT = 100;
 
-static inline void set_block(WorldData& world, TilePos pos, Block tile) {
+// Below this many rows per band the threads cost more than they save
+static constexpr int MIN_BAND_ROWS = 16;
+
+// Runs `func(from_y, to_y)` on bands of rows, one band per thread, and returns once every band is done.
+// The bands don't overlap, so a pass that only writes the tiles of its own rows gives the same result as a serial loop.
+template <typename Func>
+static void parallel_rows(uint32_t thread_count, int from_y, int to_y, const Func& func) {
+    const int rows = to_y - from_y;
+    if (rows <= 0) return;
+
+    const int bands = std::clamp(rows / MIN_BAND_ROWS, 1, static_cast<int>(std::max(thread_count, 1u)));
+
+    if (bands == 1) {
+        func(from_y, to_y);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    workers.reserve(bands - 1);
+
+    for (int band = 1; band < bands; ++band) {
+        const int band_from = from_y + rows * band / bands;
+        const int band_to = from_y + rows * (band + 1) / bands;
+        workers.emplace_back([&func, band_from, band_to] { func(band_from, band_to); });
+    }
+
+    func(from_y, from_y + rows / bands);
+
+    for (std::thread& worker : workers) worker.join();
+}
+
+// Runs `func(x, y)` on every tile of [0, width) x [0, height) so that a tile only runs after the tiles to its left
+// and the tile above it, and before the tile below it, like a serial row by row loop. The rows are dealt out to the threads
+// in turn and every row follows the one above it a word of tiles behind.
+template <typename Func>
+static void wavefront_rows(uint32_t thread_count, int width, int height, const Func& func) {
+    constexpr int STEP = 64;
+
+    const int threads = std::min(static_cast<int>(std::max(thread_count, 1u)), height / MIN_BAND_ROWS);
+
+    if (threads <= 1) {
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) func(x, y);
+        }
+        return;
+    }
+
+    // How many tiles of every row are done
+    std::vector<std::atomic<int>> progress(height);
+
+    const auto worker = [&](int first_row) {
+        for (int y = first_row; y < height; y += threads) {
+            for (int from_x = 0; from_x < width; from_x += STEP) {
+                const int to_x = std::min(from_x + STEP, width);
+
+                if (y > 0) {
+                    while (progress[y - 1].load(std::memory_order_acquire) < to_x) std::this_thread::yield();
+                }
+
+                for (int x = from_x; x < to_x; ++x) func(x, y);
+
+                progress[y].store(to_x, std::memory_order_release);
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+
+    for (int thread = 1; thread < threads; ++thread) {
+        workers.emplace_back(worker, thread);
+    }
+
+    worker(0);
+
+    for (std::thread& thread : workers) thread.join();
+}
+
+static inline void set_block(WorldData& world, TilePos pos, BlockType type) {
+    const size_t index = world.get_tile_index(pos);
+    world.blocks[index] = Block(type, world.block_variant(pos));
+}
+
+static inline void set_tree(WorldData& world, TilePos pos, TreeType type, TreeFrameType frame) {
     const size_t index = world.get_tile_index(pos);
-    world.blocks[index] = tile;
+    world.blocks[index] = Block::Tree(type, frame, world.block_variant(pos));
 }
 
 static inline void remove_block(WorldData& world, TilePos pos) {
@@ -27,9 +115,9 @@ static inline void remove_block(WorldData& world, TilePos pos) {
     world.blocks[index] = std::nullopt;
 }
 
-static inline void set_wall(WorldData& world, TilePos pos, const Wall& wall) {
+static inline void set_wall(WorldData& world, TilePos pos, WallType type) {
     const size_t index = world.get_tile_index(pos);
-    world.walls[index] = wall;
+    world.walls[index] = Wall(type, world.wall_variant(pos));
 }
 
 static inline void remove_wall(WorldData& world, TilePos pos) {
@@ -37,6 +125,111 @@ static inline void remove_wall(WorldData& world, TilePos pos) {
     world.walls[index] = std::nullopt;
 }
 
+// The columns [first_column, end_column) of the playable area that `world` holds.
+// A scratch world of the lazy generation only holds a part of the playable area.
+static inline int first_column(const WorldData& world) {
+    return std::max(world.playable_area.min.x, 0);
+}
+
+static inline int end_column(const WorldData& world) {
+    return std::min(world.playable_area.max.x, world.area.width());
+}
+
+enum class NoiseRuleType : uint8_t {
+    // Removes the block where the noise is below the threshold
+    RemoveBlock = 0,
+    // Replaces stone with dirt where the noise is at or above the threshold
+    StoneToDirt,
+    // Replaces dirt and grass with stone where the noise is at or above the threshold
+    DirtToStone,
+};
+
+// A noise pass without cross-tile dependencies: the rule only reads and writes the tile the noise is evaluated at
+struct NoiseRule {
+    const char* name;
+    BatchNoise noise;
+    NoiseRuleType type;
+    int from_y;
+    int to_y;
+    double threshold = 0.0;
+    // If set, the threshold goes linearly from `ramp_from` at from_y to `ramp_to` at to_y
+    bool ramp = false;
+    float ramp_from = 0.0f;
+    float ramp_to = 0.0f;
+};
+
+static void apply_noise_rule(WorldData& world, const NoiseRule& rule, int y, int min_x, int width, const float* noise) {
+    const double threshold = rule.ramp
+        ? map_range(static_cast<float>(rule.from_y), static_cast<float>(rule.to_y), rule.ramp_from, rule.ramp_to, static_cast<float>(y))
+        : rule.threshold;
+
+    switch (rule.type) {
+    case NoiseRuleType::RemoveBlock:
+        for (int x = 0; x < width; ++x) {
+            if (noise[x] < threshold) remove_block(world, TilePos(min_x + x, y));
+        }
+    break;
+    case NoiseRuleType::StoneToDirt:
+        for (int x = 0; x < width; ++x) {
+            if (noise[x] < threshold) continue;
+
+            const TilePos pos = TilePos(min_x + x, y);
+            if (world.block_exists_with_type(pos, BlockType::Stone)) {
+                set_block(world, pos, BlockType::Dirt);
+            }
+        }
+    break;
+    case NoiseRuleType::DirtToStone:
+        for (int x = 0; x < width; ++x) {
+            if (noise[x] < threshold) continue;
+
+            const TilePos pos = TilePos(min_x + x, y);
+            const std::optional<BlockType> tile = world.get_block_type(pos);
+            if (!tile.has_value()) continue;
+
+            if (tile.value() == BlockType::Dirt || tile.value() == BlockType::Grass) {
+                remove_block(world, pos);
+                set_block(world, pos, BlockType::Stone);
+            }
+        }
+    break;
+    }
+}
+
+// Applies the rules in one sweep over the union of their rows: every row gets all of its rules in their order
+// before the band moves to the next row, so the row stays in the cache. Since every rule only touches
+// the tile it's evaluated at, the world is the same as with one sweep per rule.
+// Returns how many bytes of the block array the sweep streamed.
+static uint64_t world_sweep_noise_rules(WorldData& world, const NoiseRule* rules, size_t count, uint32_t thread_count) {
+    if (count == 0) return 0;
+
+    int from_y = rules[0].from_y;
+    int to_y = rules[0].to_y;
+    for (size_t i = 1; i < count; ++i) {
+        from_y = std::min(from_y, rules[i].from_y);
+        to_y = std::max(to_y, rules[i].to_y);
+    }
+
+    const int min_x = first_column(world);
+    const int width = end_column(world) - min_x;
+
+    parallel_rows(thread_count, from_y, to_y, [&](int band_from, int band_to) {
+        std::vector<float> noise(width);
+
+        for (int y = band_from; y < band_to; ++y) {
+            for (size_t i = 0; i < count; ++i) {
+                const NoiseRule& rule = rules[i];
+                if (y < rule.from_y || y >= rule.to_y) continue;
+
+                rule.noise.row(world.origin_x + min_x, y, width, noise.data());
+                apply_noise_rule(world, rule, y, min_x, width, noise.data());
+            }
+        }
+    });
+
+    return static_cast<uint64_t>(std::max(to_y - from_y, 0)) * width * sizeof(std::optional<Block>);
+}
+
 static void update_tile_sprite_index(WorldData& world, const TilePos& pos) {
     if (!world.is_tilepos_valid(pos)) return;
 
@@ -49,7 +242,7 @@ static void update_tile_sprite_index(WorldData& world, const TilePos& pos) {
     }
 
     if (wall.has_value()) {
-        const Neighbors<Wall> neighbors = world.get_wall_neighbors(pos);
+        const Neighbors<WallType> neighbors = world.get_wall_type_neighbors(pos);
         update_wall_sprite_index(wall.value(), neighbors);
     }
 }
@@ -57,11 +250,11 @@ static void update_tile_sprite_index(WorldData& world, const TilePos& pos) {
 static void fill_line_vertical(WorldData& world, BlockType block, int from_y, int to_y, int x) {
     if (from_y < to_y) {
         for (int y = from_y; y < to_y; ++y) {
-            set_block(world, {x, y}, Block(block));
+            set_block(world, {x, y}, block);
         }
     } else {
         for (int y = from_y; y > to_y; --y) {
-            set_block(world, {x, y}, Block(block));
+            set_block(world, {x, y}, block);
         }
     }
 }
@@ -94,11 +287,11 @@ static int get_surface_wall(const WorldData &world, int x) {
 
 static void world_generate_terrain(WorldData& world) {
     for (int y = world.playable_area.min.y; y < world.playable_area.max.y; ++y) {
-        for (int x = world.playable_area.min.x; x < world.playable_area.max.x; ++x) {
+        for (int x = first_column(world); x < end_column(world); ++x) {
             if (y >= world.layers.underground) {
-                set_block(world, {x, y}, Block(BlockType::Stone));
+                set_block(world, {x, y}, BlockType::Stone);
             } else if (y >= world.layers.underground - world.layers.dirt_height) {
-                set_block(world, {x, y}, Block(BlockType::Dirt));
+                set_block(world, {x, y}, BlockType::Dirt);
             }
         }
     }
@@ -109,15 +302,127 @@ static void world_generate_walls(WorldData& world) {
     const int underground_level = world.layers.underground;
 
     for (int y = dirt_level; y < underground_level; ++y) {
-        for (int x = world.playable_area.min.x; x < world.playable_area.max.x; ++x) {
-            set_wall(world, {x, y}, Wall(WallType::DirtWall));
+        for (int x = first_column(world); x < end_column(world); ++x) {
+            set_wall(world, {x, y}, WallType::DirtWall);
+        }
+    }
+}
+
+// A run of tiles [from_x, to_x] of a row that a scanline flood fill has already claimed
+struct FillSpan {
+    int from_x;
+    int to_x;
+    int y;
+};
+
+// Packs `func(x, y)` of the tiles of the row `y` into `row`, 64 tiles at a time.
+// The padding bits past the right edge get `padding`.
+template <typename Func>
+static void pack_row(const WorldData& world, uint64_t* row, int y, bool padding, const Func& func) {
+    const int width = world.area.width();
+    const int words = (width + 63) / 64;
+
+    for (int w = 0; w < words; ++w) {
+        const int from_x = w * 64;
+        const int count = std::min(width - from_x, 64);
+
+        uint64_t word = padding && count < 64 ? ~uint64_t(0) << count : 0;
+        for (int i = 0; i < count; ++i) {
+            word |= static_cast<uint64_t>(func(from_x + i, y)) << i;
+        }
+        row[w] = word;
+    }
+}
+
+// Sets the bit of every tile whose left or right neighbor is set, the tiles outside of the row count as set
+static inline uint64_t dilate_horizontally(const uint64_t* row, int w, int words) {
+    const uint64_t left = w > 0 ? row[w - 1] : ~uint64_t(0);
+    const uint64_t right = w + 1 < words ? row[w + 1] : ~uint64_t(0);
+    return row[w] | (row[w] << 1) | (left >> 63) | (row[w] >> 1) | (right << 63);
+}
+
+// The tiles a flood fill may enter: the ones `func(x, y)` accepts that are empty or have an empty neighbor,
+// the tiles outside of the world count as empty. The neighbors are checked a word at a time on the occupancy bitplane
+// instead of fetching 8 blocks per tile, and a row is only packed once the fill gets next to it, so the rows
+// the fill never reaches cost nothing. A fill clears the bits of the tiles it visits.
+template <typename Func>
+class FillableTiles {
+public:
+    FillableTiles(const WorldData& world, const Func& func) :
+        m_world(world),
+        m_func(func),
+        m_empty(world.area.width(), world.area.height()),
+        m_bits(world.area.width(), world.area.height()),
+        m_empty_packed(world.area.height(), false),
+        m_packed(world.area.height(), false) {}
+
+    // Only the rows passed to prepare are valid
+    [[nodiscard]]
+    inline TileBitmap& bits() noexcept {
+        return m_bits;
+    }
+
+    // Packs the row if it hasn't been yet. The blocks must not be added or removed while the fill runs.
+    void prepare(int y) {
+        if (y < 0 || y >= m_bits.height() || m_packed[y]) return;
+        m_packed[y] = true;
+
+        const int words = m_bits.words_per_row();
+        const uint64_t* above = empty_row(y - 1);
+        const uint64_t* row = empty_row(y);
+        const uint64_t* below = empty_row(y + 1);
+
+        uint64_t* out = m_bits.row(y);
+        pack_row(m_world, out, y, false, m_func);
+
+        for (int w = 0; w < words; ++w) {
+            uint64_t exposed = dilate_horizontally(row, w, words);
+            exposed |= above != nullptr ? dilate_horizontally(above, w, words) : ~uint64_t(0);
+            exposed |= below != nullptr ? dilate_horizontally(below, w, words) : ~uint64_t(0);
+            out[w] &= exposed;
+        }
+    }
+
+private:
+    const uint64_t* empty_row(int y) {
+        if (y < 0 || y >= m_empty.height()) return nullptr;
+
+        uint64_t* row = m_empty.row(y);
+        if (!m_empty_packed[y]) {
+            m_empty_packed[y] = true;
+
+            const int width = m_world.area.width();
+            pack_row(m_world, row, y, true, [this, width](int tile_x, int tile_y) {
+                return !m_world.blocks[tile_y * width + tile_x].has_value();
+            });
         }
+
+        return row;
     }
+
+private:
+    const WorldData& m_world;
+    Func m_func;
+    TileBitmap m_empty;
+    TileBitmap m_bits;
+    std::vector<bool> m_empty_packed;
+    std::vector<bool> m_packed;
+};
+
+// Claims the run of fillable tiles around `x` together with `x` itself
+static FillSpan claim_span(TileBitmap& fillable, int x, int y) {
+    const FillSpan span = {
+        .from_x = fillable.run_begin(x, y),
+        .to_x = fillable.run_end(x + 1, y) - 1,
+        .y = y
+    };
+    fillable.clear_range(span.from_x, span.to_x, y);
+    return span;
 }
 
 static bool tile_pos_in_bounds(WorldData& world, TilePos pos) {
     if (pos.x <= world.playable_area.min.x || pos.x >= world.playable_area.max.x - 1) return false;
-    if (pos.x <= world.playable_area.min.y || pos.y >= world.playable_area.max.y - 1) return false;
+    if (pos.y <= world.playable_area.min.y || pos.y >= world.playable_area.max.y - 1) return false;
     return true;
 }
 
@@ -134,7 +439,7 @@ static bool remove_walls_is_valid(WorldData& world, TilePos pos) {
     return true;
 }
 
-static void remove_walls_flood_fill(WorldData& world, TilePos start) {
+static void remove_walls_flood_fill_per_tile(WorldData& world, TilePos start) {
     std::vector<std::pair<TilePos, glm::ivec2>> queue;
     queue.emplace_back(start, glm::ivec2(0));
 
@@ -225,18 +530,95 @@ static void remove_walls_flood_fill(WorldData& world, TilePos start) {
     }
 }
 
-static void world_remove_walls_from_surface(WorldData& world) {
-    const int min_x = world.playable_area.min.x;
-    const int max_x = world.playable_area.max.x;
+// The same walls as remove_walls_flood_fill_per_tile. The depth of a tile there is its offset from the start,
+// so the fill only spreads up and down inside a cone under the start and can be done a span at a time.
+// `fillable` has the tiles remove_walls_is_valid accepts, a cleared bit marks the tile as visited.
+template <typename Func>
+static void remove_walls_flood_fill(WorldData& world, FillableTiles<Func>& tiles, std::vector<FillSpan>& stack, TilePos start) {
+    TileBitmap& fillable = tiles.bits();
 
-    for (int x = min_x; x <= max_x; ++x) {
-        const int y = get_surface_wall(world, x);
+    const auto remove_span = [&](const FillSpan& span) {
+        for (int x = span.from_x; x <= span.to_x; ++x) {
+            remove_wall(world, TilePos(x, span.y));
+        }
+    };
 
-        const TilePos pos = TilePos(x, y);
+    const auto remove_in_bounds = [&](int from_x, int to_x, int y) {
+        for (int x = from_x; x <= to_x; ++x) {
+            const TilePos pos = TilePos(x, y);
+            if (tile_pos_in_bounds(world, pos)) {
+                remove_wall(world, pos);
+                fillable.clear(x, y);
+            }
+        }
+    };
+
+    tiles.prepare(start.y);
+    fillable.clear(start.x, start.y);
+
+    const FillSpan first = claim_span(fillable, start.x, start.y);
+    remove_span(first);
+    stack.push_back(first);
+
+    while (!stack.empty()) {
+        const FillSpan span = stack.back();
+        stack.pop_back();
+
+        remove_in_bounds(span.from_x - 1, span.from_x - 1, span.y);
+        remove_in_bounds(span.to_x + 1, span.to_x + 1, span.y);
 
-        if (world.block_exists(pos)) continue;
+        const int reach = (span.y - start.y) / 2 + 5;
+        const int from_x = std::max(span.from_x, start.x - reach + 1);
+        const int to_x = std::min(span.to_x, start.x + reach - 1);
+        if (from_x > to_x) continue;
 
-        remove_walls_flood_fill(world, pos);
+        for (const int y : { span.y - 1, span.y + 1 }) {
+            tiles.prepare(y);
+
+            // The tiles above or below and the diagonal ones
+            int x = fillable.find_set(from_x - 1, to_x + 1, y);
+            while (x <= to_x + 1) {
+                const FillSpan next = claim_span(fillable, x, y);
+                remove_span(next);
+                stack.push_back(next);
+
+                x = fillable.find_set(next.to_x + 1, to_x + 1, y);
+            }
+
+            remove_in_bounds(from_x, to_x, y);
+        }
+    }
+}
+
+static void world_remove_walls_from_surface(WorldData& world, bool scanline) {
+    const int min_x = first_column(world);
+    const int max_x = std::min(world.playable_area.max.x, world.area.width() - 1);
+
+    if (scanline) {
+        // The blocks don't change in this pass
+        const int width = world.area.width();
+        FillableTiles tiles(world, [&world, width](int x, int y) {
+            return world.walls[y * width + x].has_value() && tile_pos_in_bounds(world, TilePos(x, y));
+        });
+
+        std::vector<FillSpan> stack;
+
+        for (int x = min_x; x <= max_x; ++x) {
+            const TilePos pos = TilePos(x, get_surface_wall(world, x));
+            if (world.block_exists(pos)) continue;
+
+            remove_walls_flood_fill(world, tiles, stack, pos);
+        }
+    } else {
+        for (int x = min_x; x <= max_x; ++x) {
+            const int y = get_surface_wall(world, x);
+
+            const TilePos pos = TilePos(x, y);
+
+            if (world.block_exists(pos)) continue;
+
+            remove_walls_flood_fill_per_tile(world, pos);
+        }
     }
 
     for (int x = 0; x <= max_x; ++x) {
@@ -250,13 +632,15 @@ static void world_remove_walls_from_surface(WorldData& world) {
 }
 
 static void world_place_tree(WorldData& world, TreeType tree_type, TilePos pos) {
-    using namespace sge::random;
+    const uint32_t seed = world.seed;
+    // The random numbers are keyed by the position in the whole world
+    const int world_x = pos.x + world.origin_x;
 
     if (pos.x >= world.playable_area.max.x - 2 || pos.x <= world.playable_area.min.x + 2) {
         return;
     }
 
-    const int height = rand_int(5, 16);
+    const int height = 5 + static_cast<int>(hash_rng_below(seed, world_x, pos.y, RngPurpose::TreeHeight, 11));
 
     for (int x = pos.x - 2; x <= pos.x + 2; ++x) {
         for (int y = pos.y - height; y < pos.y; ++y) {
@@ -272,15 +656,15 @@ static void world_place_tree(WorldData& world, TreeType tree_type, TilePos pos)
     const bool right_block = world.block_exists_with_type(pos.offset(TileOffset::BottomRight), BlockType::Dirt) || 
                              world.block_exists_with_type(pos.offset(TileOffset::BottomRight), BlockType::Grass);
 
-    const bool left_root = rand_bool() && left_block;
-    const bool right_root = rand_bool() && right_block;
+    const bool left_root = hash_rng_chance(seed, world_x, pos.y, RngPurpose::TreeRoot, 0.5f, 0) && left_block;
+    const bool right_root = hash_rng_chance(seed, world_x, pos.y, RngPurpose::TreeRoot, 0.5f, 1) && right_block;
 
     // Base
     if (left_root)
-        set_block(world, pos.offset(TileOffset::Left), Block::Tree(tree_type, TreeFrameType::RootLeft));
+        set_tree(world, pos.offset(TileOffset::Left), tree_type, TreeFrameType::RootLeft);
 
     if (right_root)
-        set_block(world, pos.offset(TileOffset::Right), Block::Tree(tree_type, TreeFrameType::RootRight));
+        set_tree(world, pos.offset(TileOffset::Right), tree_type, TreeFrameType::RootRight);
 
     TreeFrameType frame = TreeFrameType::Trunk;
 
@@ -292,63 +676,60 @@ static void world_place_tree(WorldData& world, TreeType tree_type, TilePos pos)
         frame = TreeFrameType::BaseRight;
     }
 
-    set_block(world, pos, Block::Tree(tree_type, frame));
+    set_tree(world, pos, tree_type, frame);
     for (int y = pos.y - height; y < pos.y; ++y) {
-        const bool branch_left = rand_bool(1.0f / 7.0f);
-        const bool branch_right = rand_bool(1.0f / 7.0f);
+        const bool branch_left = hash_rng_chance(seed, world_x, y, RngPurpose::TreeBranch, 1.0f / 7.0f, 0);
+        const bool branch_right = hash_rng_chance(seed, world_x, y, RngPurpose::TreeBranch, 1.0f / 7.0f, 1);
 
         if (branch_left && !world.block_exists({pos.x - 1, y - 1})) {
-            const bool bare = rand_bool(1.0f / 5.0f);
+            const bool bare = hash_rng_chance(seed, world_x - 1, y, RngPurpose::TreeBranchBare, 1.0f / 5.0f);
             const TreeFrameType frame_type = bare ? TreeFrameType::BranchLeftBare : TreeFrameType::BranchLeftLeaves;
-            set_block(world, {pos.x - 1, y}, Block::Tree(tree_type, frame_type));
+            set_tree(world, {pos.x - 1, y}, tree_type, frame_type);
         }
 
         if (branch_right && !world.block_exists({pos.x + 1, y - 1})) {
-            const bool bare = rand_bool(1.0f / 5.0f);
+            const bool bare = hash_rng_chance(seed, world_x + 1, y, RngPurpose::TreeBranchBare, 1.0f / 5.0f);
             const TreeFrameType frame_type = bare ? TreeFrameType::BranchRightBare : TreeFrameType::BranchRightLeaves;
-            set_block(world, {pos.x + 1, y}, Block::Tree(tree_type, frame_type));
+            set_tree(world, {pos.x + 1, y}, tree_type, frame_type);
         }
 
         // Hollow to the left
-        if (!branch_left && rand_bool(1.0f / 10.0f)) {
-            set_block(world, {pos.x, y}, Block::Tree(tree_type, TreeFrameType::TrunkHollowLeft));
+        if (!branch_left && hash_rng_chance(seed, world_x, y, RngPurpose::TreeTrunkFrame, 1.0f / 10.0f, 0)) {
+            set_tree(world, {pos.x, y}, tree_type, TreeFrameType::TrunkHollowLeft);
         // Hollow to the right
-        } else if (!branch_right && rand_bool(1.0f / 10.0f)) {
-            set_block(world, {pos.x, y}, Block::Tree(tree_type, TreeFrameType::TrunkHollowRight));
+        } else if (!branch_right && hash_rng_chance(seed, world_x, y, RngPurpose::TreeTrunkFrame, 1.0f / 10.0f, 1)) {
+            set_tree(world, {pos.x, y}, tree_type, TreeFrameType::TrunkHollowRight);
         // Branch collar to the left
-        } else if (!branch_left && rand_bool(1.0f / 10.0f)) {
-            set_block(world, {pos.x, y}, Block::Tree(tree_type, TreeFrameType::TrunkBranchCollarLeft));
+        } else if (!branch_left && hash_rng_chance(seed, world_x, y, RngPurpose::TreeTrunkFrame, 1.0f / 10.0f, 2)) {
+            set_tree(world, {pos.x, y}, tree_type, TreeFrameType::TrunkBranchCollarLeft);
         // Branch collar to the right
-        } else if (!branch_right && rand_bool(1.0f / 10.0f)) {
-            set_block(world, {pos.x, y}, Block::Tree(tree_type, TreeFrameType::TrunkBranchCollarRight));
+        } else if (!branch_right && hash_rng_chance(seed, world_x, y, RngPurpose::TreeTrunkFrame, 1.0f / 10.0f, 3)) {
+            set_tree(world, {pos.x, y}, tree_type, TreeFrameType::TrunkBranchCollarRight);
         // Regular trunk
         } else {
-            set_block(world, {pos.x, y}, Block::Tree(tree_type, TreeFrameType::Trunk));
+            set_tree(world, {pos.x, y}, tree_type, TreeFrameType::Trunk);
         }
     }
 
     // ------------- Crown -------------
 
+    const TilePos crown_pos = TilePos(pos.x, pos.y - height - 1);
+
     TreeFrameType frame_type = TreeFrameType::TopLeaves;
 
-    if (rand_bool(1.0f / 3.0f))
+    if (hash_rng_chance(seed, world_x, crown_pos.y, RngPurpose::TreeCrown, 1.0f / 3.0f, 0))
         frame_type = TreeFrameType::TopBareJagged;
-    else if (rand_bool(1.0f / 5.0f))
+    else if (hash_rng_chance(seed, world_x, crown_pos.y, RngPurpose::TreeCrown, 1.0f / 5.0f, 1))
         frame_type = TreeFrameType::TopBare;
 
-    set_block(world, {pos.x, pos.y - height - 1}, Block::Tree(tree_type, frame_type));
+    set_tree(world, crown_pos, tree_type, frame_type);
 }
 
 static void world_grow_trees(WorldData& world) {
-    using namespace sge::random;
-
-    const int playable_area_min_x = world.playable_area.min.x;
-    const int playable_area_max_x = world.playable_area.max.x;
-
-    for (int x = playable_area_min_x; x < playable_area_max_x; ++x) {
+    for (int x = first_column(world); x < end_column(world); ++x) {
         const int y = get_surface_block(world, x);
 
-        const bool grow = rand_bool(1.0f / 10.0f);
+        const bool grow = hash_rng_chance(world.seed, x + world.origin_x, y, RngPurpose::TreeGrow, 1.0f / 10.0f);
 
         if (grow) {
             // Trees can only grow on dirt or grass
@@ -372,7 +753,7 @@ static void world_make_hills(WorldData& world) {
     fbm.SetFractalGain(2.0);
     fbm.SetFractalLacunarity(0.5);
     fbm.SetFrequency(0.005);
-    fbm.SetSeed(rand());
+    fbm.SetSeed(static_cast<int>(hash_rng(world.seed, 0, 0, RngPurpose::HillsNoiseSeed)));
 
     // FastNoiseLite gradient;
     // gradient.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
@@ -391,12 +772,12 @@ static void world_make_hills(WorldData& world) {
     gradient.SetFractalLacunarity(0.4);
     gradient.SetFractalGain(2.7);
     gradient.SetFractalWeightedStrength(-1.);
-    gradient.SetSeed(rand());
+    gradient.SetSeed(static_cast<int>(hash_rng(world.seed, 0, 0, RngPurpose::HillsGradientSeed)));
 
+    // The noise starts at the left edge of the playable area, also in a scratch world that doesn't hold it
     const int min_x = world.playable_area.min.x;
-    const int max_x = world.playable_area.max.x;
 
-    for (int x = min_x; x < max_x; ++x) {
+    for (int x = first_column(world); x < end_column(world); ++x) {
         const float coord = static_cast<float>(x - min_x);
         const float fbm_value = fbm.GetNoise(coord, 0.0f) * 0.5 + 0.5;
         const float gradient_value = gradient.GetNoise(coord, 0.0f) * 0.5 + 0.5;
@@ -407,75 +788,60 @@ static void world_make_hills(WorldData& world) {
     }
 }
 
-static void world_small_caves(WorldData& world, int seed) {
+static void world_small_caves(const WorldData& world, int seed, std::vector<NoiseRule>& rules) {
     const int underground = world.layers.underground;
     const int dirt_level = world.layers.underground - world.layers.dirt_height - DIRT_HILL_HEIGHT;
-
-    FastNoiseLite noise;
-    noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
-    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
-    noise.SetSeed(seed);
-    noise.SetFractalOctaves(1);
-    noise.SetFrequency(0.05);
-
-    const int min_x = world.playable_area.min.x;
-    const int max_x = world.playable_area.max.x;
     const int max_y = world.playable_area.max.y;
 
-    for (int y = dirt_level; y < max_y; ++y) {
-        for (int x = min_x; x < max_x; ++x) {
-            const float noise_value = noise.GetNoise(static_cast<float>(x), static_cast<float>(y));
-
-            if (noise_value < -0.5) {
-                remove_block(world, {x, y});
-            }
-        }
-    }
-
-    noise.SetNoiseType(FastNoiseLite::NoiseType_OpenSimplex2);
-    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
-    noise.SetSeed(seed);
-    noise.SetFractalOctaves(3);
-    noise.SetFractalLacunarity(2.5);
-    noise.SetFractalGain(0.65);
-    noise.SetFrequency(0.05);
-
-    for (int y = underground; y < max_y; ++y) {
-        for (int x = min_x; x < max_x; ++x) {
-            const float noise_value = noise.GetNoise(static_cast<float>(x), static_cast<float>(y));
-
-            if (noise_value < -0.5) {
-                remove_block(world, {x, y});
-            }
-        }
-    }
+    rules.push_back({
+        .name = "small caves",
+        .noise = BatchNoise({
+            .type = BatchNoiseType::Perlin,
+            .seed = seed,
+            .frequency = 0.05f,
+            .octaves = 1
+        }),
+        .type = NoiseRuleType::RemoveBlock,
+        .from_y = dirt_level,
+        .to_y = max_y,
+        .threshold = -0.5
+    });
+
+    rules.push_back({
+        .name = "small caves 2",
+        .noise = BatchNoise({
+            .type = BatchNoiseType::OpenSimplex2,
+            .seed = seed,
+            .frequency = 0.05f,
+            .octaves = 3,
+            .lacunarity = 2.5f,
+            .gain = 0.65f
+        }),
+        .type = NoiseRuleType::RemoveBlock,
+        .from_y = underground,
+        .to_y = max_y,
+        .threshold = -0.5
+    });
 }
 
-static void world_big_caves(WorldData& world, int seed) {
+static void world_big_caves(const WorldData& world, int seed, std::vector<NoiseRule>& rules) {
     const int dirt_level = world.layers.underground - world.layers.dirt_height - DIRT_HILL_HEIGHT;
 
-    FastNoiseLite noise;
-    noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
-    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
-    noise.SetSeed(seed);
-    noise.SetFractalOctaves(3);
-    noise.SetFractalGain(0.0);
-    noise.SetFractalLacunarity(0.0);
-    noise.SetFrequency(0.06);
-
-    const int min_x = world.playable_area.min.x;
-    const int max_x = world.playable_area.max.x;
-    const int max_y = world.playable_area.max.y;
-
-    for (int y = dirt_level; y < max_y; ++y) {
-        for (int x = min_x; x < max_x; ++x) {
-            const float noise_value = noise.GetNoise(static_cast<float>(x), static_cast<float>(y));
-
-            if (noise_value < -0.4) {
-                remove_block(world, {x, y});
-            }
-        }
-    }
+    rules.push_back({
+        .name = "big caves",
+        .noise = BatchNoise({
+            .type = BatchNoiseType::Perlin,
+            .seed = seed,
+            .frequency = 0.06f,
+            .octaves = 3,
+            .lacunarity = 0.0f,
+            .gain = 0.0f
+        }),
+        .type = NoiseRuleType::RemoveBlock,
+        .from_y = dirt_level,
+        .to_y = world.playable_area.max.y,
+        .threshold = -0.4
+    });
 }
 
 static void world_rough_cavern_layer_border(WorldData& world) {
@@ -489,13 +855,12 @@ static void world_rough_cavern_layer_border(WorldData& world) {
     fbm.SetFractalLacunarity(0.5);
     fbm.SetFractalGain(1.5);
     fbm.SetFractalWeightedStrength(-2.);
-    fbm.SetSeed(rand());
+    fbm.SetSeed(static_cast<int>(hash_rng(world.seed, 0, 0, RngPurpose::CavernBorderNoiseSeed)));
 
     constexpr float ROUGHNESS = 10.;
     const int min_x = world.playable_area.min.x;
-    const int max_x = world.playable_area.max.x;
 
-    for (int x = min_x; x < max_x; ++x) {
+    for (int x = first_column(world); x < end_column(world); ++x) {
         const float noise_value = fbm.GetNoise(static_cast<float>(x - min_x), 0.0f);
 
         const int height = glm::abs(noise_value) * ROUGHNESS;
@@ -508,76 +873,51 @@ static void world_rough_cavern_layer_border(WorldData& world) {
     }
 }
 
-static void world_generate_rocks_in_dirt(WorldData& world, int seed) {
-    const int dirt_level = world.layers.underground - world.layers.dirt_height - DIRT_HILL_HEIGHT;
-    const int underground_level = world.layers.underground;
-
-    FastNoiseLite noise;
-    noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
-    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
-    noise.SetSeed(seed);
-    noise.SetFractalOctaves(3);
-    noise.SetFrequency(0.15);
-    noise.SetFractalGain(0.4);
-    noise.SetFractalLacunarity(2.);
-
-    const int min_x = world.playable_area.min.x;
-    const int max_x = world.playable_area.max.x;
-
-    for (int y = dirt_level; y < underground_level; ++y) {
-        for (int x = min_x; x < max_x; ++x) {
-            const float noise_value = noise.GetNoise(static_cast<float>(x), static_cast<float>(y));
-
-            if (noise_value >= 0.4) {
-                auto pos = TilePos(x, y);
-                const std::optional<BlockType> tile = world.get_block_type(pos);
-                if (!tile.has_value()) continue;
-
-                if (tile.value() == BlockType::Dirt || tile.value() == BlockType::Grass) {
-                    remove_block(world, pos);
-                    set_block(world, pos, Block(BlockType::Stone));
-                }
-            }
-        }
-    }
+static void world_generate_rocks_in_dirt(const WorldData& world, int seed, std::vector<NoiseRule>& rules) {
+    rules.push_back({
+        .name = "rocks in dirt",
+        .noise = BatchNoise({
+            .type = BatchNoiseType::Perlin,
+            .seed = seed,
+            .frequency = 0.15f,
+            .octaves = 3,
+            .lacunarity = 2.0f,
+            .gain = 0.4f
+        }),
+        .type = NoiseRuleType::DirtToStone,
+        .from_y = world.layers.underground - world.layers.dirt_height - DIRT_HILL_HEIGHT,
+        .to_y = world.layers.underground,
+        .threshold = 0.4
+    });
 }
 
-static void world_generate_dirt(WorldData& world, int seed, int from, int to, float noise_freq, float from_freq, float to_freq) {
-    const int min_x = world.playable_area.min.x;
-    const int max_x = world.playable_area.max.x;
-
-    FastNoiseLite noise;
-    noise.SetNoiseType(FastNoiseLite::NoiseType_Perlin);
-    noise.SetFractalType(FastNoiseLite::FractalType_FBm);
-    noise.SetFrequency(noise_freq);
-    noise.SetSeed(seed);
-    noise.SetFractalGain(2.0);
-    noise.SetFractalLacunarity(0.5);
-    noise.SetFractalOctaves(3);
-    noise.SetFractalWeightedStrength(-0.63);
-
-    for (int y = from; y < to; ++y) {
-        for (int x = min_x; x < max_x; ++x) {
-            const float f = map_range(static_cast<float>(from), static_cast<float>(to), from_freq, to_freq, static_cast<float>(y));
-
-            const float noise_value = noise.GetNoise(static_cast<float>(x), static_cast<float>(y));
-
-            if (noise_value >= f) {
-                const TilePos pos = TilePos(x, y);
-                if (world.block_exists_with_type(pos, BlockType::Stone)) {
-                    set_block(world, pos, Block(BlockType::Dirt));
-                }
-            }
-        }
-    }
+static void world_generate_dirt(int seed, int from, int to, float noise_freq, float from_freq, float to_freq, std::vector<NoiseRule>& rules) {
+    rules.push_back({
+        .name = "dirt in rocks",
+        .noise = BatchNoise({
+            .type = BatchNoiseType::Perlin,
+            .seed = seed,
+            .frequency = noise_freq,
+            .octaves = 3,
+            .lacunarity = 0.5f,
+            .gain = 2.0f,
+            .weighted_strength = -0.63f
+        }),
+        .type = NoiseRuleType::StoneToDirt,
+        .from_y = from,
+        .to_y = to,
+        .ramp = true,
+        .ramp_from = from_freq,
+        .ramp_to = to_freq
+    });
 }
 
-static void world_generate_dirt_in_rocks(WorldData& world, int seed) {
+static void world_generate_dirt_in_rocks(const WorldData& world, int seed, std::vector<NoiseRule>& rules) {
     const int underground = world.layers.underground;
     const int cavern = world.layers.cavern;
 
-    world_generate_dirt(world, seed, underground, cavern, 0.4, 0.3, 0.7);
-    world_generate_dirt(world, seed, underground, world.area.height(), 0.7, 0.5, 0.5);
+    world_generate_dirt(seed, underground, cavern, 0.4, 0.3, 0.7, rules);
+    world_generate_dirt(seed, underground, world.area.height(), 0.7, 0.5, 0.5, rules);
 }
 
 static glm::ivec2 world_get_spawn_point(const WorldData &world) {
@@ -587,7 +927,7 @@ static glm::ivec2 world_get_spawn_point(const WorldData &world) {
     return {x, y};
 }
 
-static void world_update_tile_sprite_index(WorldData& world) {
+static void world_update_tile_sprite_index_serial(WorldData& world) {
     for (int y = 0; y < world.area.height(); ++y) {
         for (int x = 0; x < world.area.width(); ++x) {
             update_tile_sprite_index(world, {x, y});
@@ -601,6 +941,125 @@ static void world_update_tile_sprite_index(WorldData& world) {
     }
 }
 
+// The types of the neighbors of a tile. Only the types are read, so other threads can set the sprites of the neighbors meanwhile.
+template <typename Tile>
+static inline Neighbors<decltype(Tile::type)> type_neighbors(const WorldData& world, const std::optional<Tile>* tiles, TilePos pos) {
+    const auto type = [&](TilePos neighbor) -> std::optional<decltype(Tile::type)> {
+        if (!world.is_tilepos_valid(neighbor)) return std::nullopt;
+        const std::optional<Tile>& tile = tiles[world.get_tile_index(neighbor)];
+        if (!tile.has_value()) return std::nullopt;
+        return tile->type;
+    };
+
+    return Neighbors<decltype(Tile::type)> {
+        .top = type(pos.offset(TileOffset::Top)),
+        .bottom = type(pos.offset(TileOffset::Bottom)),
+        .left = type(pos.offset(TileOffset::Left)),
+        .right = type(pos.offset(TileOffset::Right)),
+        .top_left = type(pos.offset(TileOffset::TopLeft)),
+        .top_right = type(pos.offset(TileOffset::TopRight)),
+        .bottom_left = type(pos.offset(TileOffset::BottomLeft)),
+        .bottom_right = type(pos.offset(TileOffset::BottomRight)),
+    };
+}
+
+// The same sprites as world_update_tile_sprite_index_serial, which runs update_tile_sprite_index on every tile twice.
+// In the first sweep a block can only merge if none of the blocks it merges with is to its right or below, since those
+// have no merge id yet. The second sweep merges the rest with the final merge ids to the left and above and the first
+// sweep merge ids to the right and below.
+static void world_update_tile_sprite_index(WorldData& world, uint32_t thread_count) {
+    static constexpr uint8_t MERGES_RIGHT = 0x1;
+    static constexpr uint8_t MERGES_TOP = 0x2;
+    static constexpr uint8_t MERGES_LEFT = 0x4;
+    static constexpr uint8_t MERGES_BOTTOM = 0x8;
+
+    const int width = world.area.width();
+    const int height = world.area.height();
+
+    std::vector<BlockAutotileMasks> masks(static_cast<size_t>(width) * height);
+
+    const auto merge_id = [&](TilePos pos, uint8_t merging, uint8_t side) -> uint8_t {
+        if ((merging & side) == 0) return 0xFF;
+        return world.blocks[world.get_tile_index(pos)]->merge_id;
+    };
+
+    // The masks of every block, the sprites of the walls, torches and trees,
+    // and the sprites of the blocks the first sweep doesn't merge
+    parallel_rows(thread_count, 0, height, [&](int from_y, int to_y) {
+        for (int y = from_y; y < to_y; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const TilePos pos = TilePos(x, y);
+                const size_t index = world.get_tile_index(pos);
+
+                std::optional<Block>& block = world.blocks[index];
+                if (block.has_value()) {
+                    const Neighbors<BlockType> neighbors = type_neighbors(world, world.blocks, pos);
+
+                    if (!block_is_autotiled(block->type)) {
+                        update_fixed_block_sprite_index(block.value(), neighbors);
+                    } else {
+                        masks[index] = block_autotile_masks(block->type, neighbors);
+                        if (masks[index].merging & (MERGES_RIGHT | MERGES_BOTTOM)) {
+                            resolve_block_sprite_index(block.value(), masks[index], nullptr);
+                        }
+                    }
+                }
+
+                std::optional<Wall>& wall = world.walls[index];
+                if (wall.has_value()) {
+                    update_wall_sprite_index(wall.value(), type_neighbors(world, world.walls, pos));
+                }
+            }
+        }
+    });
+
+    // The blocks the first sweep merges. The blocks they merge with to the left and above aren't merged
+    // in the first sweep, because this block is to their right or below, so they already have their merge ids.
+    parallel_rows(thread_count, 0, height, [&](int from_y, int to_y) {
+        for (int y = from_y; y < to_y; ++y) {
+            for (int x = 0; x < width; ++x) {
+                const TilePos pos = TilePos(x, y);
+                const size_t index = world.get_tile_index(pos);
+
+                std::optional<Block>& block = world.blocks[index];
+                if (!block.has_value() || !block_is_autotiled(block->type)) continue;
+
+                const BlockAutotileMasks& block_masks = masks[index];
+                if (block_masks.merging & (MERGES_RIGHT | MERGES_BOTTOM)) continue;
+
+                const uint8_t merge_ids[4] = {
+                    0xFF,
+                    merge_id(pos.offset(TileOffset::Top), block_masks.merging, MERGES_TOP),
+                    merge_id(pos.offset(TileOffset::Left), block_masks.merging, MERGES_LEFT),
+                    0xFF
+                };
+
+                resolve_block_sprite_index(block.value(), block_masks, merge_ids);
+            }
+        }
+    });
+
+    // The second sweep depends on the tiles to the left and above, so it runs as a wavefront
+    wavefront_rows(thread_count, width, height, [&](int x, int y) {
+        const TilePos pos = TilePos(x, y);
+        const size_t index = world.get_tile_index(pos);
+
+        std::optional<Block>& block = world.blocks[index];
+        if (!block.has_value() || !block_is_autotiled(block->type) || block->is_merged) return;
+
+        const BlockAutotileMasks& block_masks = masks[index];
+
+        const uint8_t merge_ids[4] = {
+            merge_id(pos.offset(TileOffset::Right), block_masks.merging, MERGES_RIGHT),
+            merge_id(pos.offset(TileOffset::Top), block_masks.merging, MERGES_TOP),
+            merge_id(pos.offset(TileOffset::Left), block_masks.merging, MERGES_LEFT),
+            merge_id(pos.offset(TileOffset::Bottom), block_masks.merging, MERGES_BOTTOM)
+        };
+
+        resolve_block_sprite_index(block.value(), block_masks, merge_ids);
+    });
+}
+
 static bool grassify_is_valid(const WorldData& world, const TilePos& pos) {
     if (pos.x >= world.area.width()) return false;
     if (pos.y >= world.area.height()) return false;
@@ -611,11 +1070,11 @@ static bool grassify_is_valid(const WorldData& world, const TilePos& pos) {
     return neighbors.any_not_exists();
 }
 
-static void grassify_flood_fill(WorldData &world, TilePos start) {
+static void grassify_flood_fill_per_tile(WorldData &world, TilePos start) {
     std::vector<TilePos> queue;
     queue.push_back(start);
 
-    set_block(world, start, Block(BlockType::Grass));
+    set_block(world, start, BlockType::Grass);
 
     while (!queue.empty()) {
         const TilePos pos = queue.back();
@@ -628,19 +1087,77 @@ static void grassify_flood_fill(WorldData &world, TilePos start) {
         for (const TileOffset offset : DIRECTIONS) {
             const TilePos new_pos = pos.offset(offset);
             if (grassify_is_valid(world, new_pos)) {
-                set_block(world, new_pos, Block(BlockType::Grass));
+                set_block(world, new_pos, BlockType::Grass);
                 queue.push_back(new_pos);
             }
         }
     }
 }
 
-static void world_grassify(WorldData& world) {
+// The same grass as grassify_flood_fill_per_tile, a span at a time.
+// `fillable` has the tiles grassify_is_valid accepts, a cleared bit marks the tile as visited.
+template <typename Func>
+static void grassify_flood_fill(WorldData& world, FillableTiles<Func>& tiles, std::vector<FillSpan>& stack, TilePos start) {
+    TileBitmap& fillable = tiles.bits();
+
+    const auto grassify_span = [&](const FillSpan& span) {
+        for (int x = span.from_x; x <= span.to_x; ++x) {
+            set_block(world, TilePos(x, span.y), BlockType::Grass);
+        }
+    };
+
+    tiles.prepare(start.y);
+    fillable.clear(start.x, start.y);
+
+    const FillSpan first = claim_span(fillable, start.x, start.y);
+    grassify_span(first);
+    stack.push_back(first);
+
+    while (!stack.empty()) {
+        const FillSpan span = stack.back();
+        stack.pop_back();
+
+        for (const int y : { span.y - 1, span.y + 1 }) {
+            tiles.prepare(y);
+
+            int x = fillable.find_set(span.from_x - 1, span.to_x + 1, y);
+            while (x <= span.to_x + 1) {
+                const FillSpan next = claim_span(fillable, x, y);
+                grassify_span(next);
+                stack.push_back(next);
+
+                x = fillable.find_set(next.to_x + 1, span.to_x + 1, y);
+            }
+        }
+    }
+}
+
+static void world_grassify(WorldData& world, bool scanline) {
+    if (!scanline) {
+        for (int x = 0; x < world.area.width(); ++x) {
+            const int y = get_surface_block(world, x);
+            const TilePos pos = TilePos(x, y);
+            if (world.block_exists_with_type(pos, BlockType::Dirt)) {
+                grassify_flood_fill_per_tile(world, pos);
+            }
+        }
+        return;
+    }
+
+    // Turning dirt into grass doesn't add or remove blocks
+    const int width = world.area.width();
+    FillableTiles tiles(world, [&world, width](int x, int y) {
+        const std::optional<Block>& block = world.blocks[y * width + x];
+        return block.has_value() && block->type == BlockType::Dirt;
+    });
+
+    std::vector<FillSpan> stack;
+
     for (int x = 0; x < world.area.width(); ++x) {
         const int y = get_surface_block(world, x);
         const TilePos pos = TilePos(x, y);
         if (world.block_exists_with_type(pos, BlockType::Dirt)) {
-            grassify_flood_fill(world, pos);
+            grassify_flood_fill(world, tiles, stack, pos);
         }
     }
 }
@@ -650,17 +1167,31 @@ static void world_generate_lightmap(WorldData& world) {
     world.lightmap_blur_area_sync(world.area);
 }
 
-void world_generate(WorldData& world, uint32_t width, uint32_t height, uint32_t seed) {
-    world.destroy();
+// The world is this many tiles larger than the requested size, the edges of the playable area are inside of it
+static constexpr uint32_t WORLD_PADDING = 16;
+
+bool world_size_is_valid(uint32_t width, uint32_t height) {
+    if (width == 0 || height < WORLD_MIN_HEIGHT) return false;
+
+    const uint64_t area_width = static_cast<uint64_t>(width) + WORLD_PADDING;
+    const uint64_t area_height = static_cast<uint64_t>(height) + WORLD_PADDING;
+
+    // The chunk instances keep the tile position in 16 bits
+    if (area_width > UINT16_MAX + 1u || area_height > UINT16_MAX + 1u) return false;
 
-    srand(seed);
+    // The lightmap is indexed with an int, it's the largest of the planes indexed by position
+    return area_width * area_height * SUBDIVISION * SUBDIVISION <= INT32_MAX;
+}
+
+static void world_init(WorldData& world, uint32_t width, uint32_t height, uint32_t seed) {
+    world.destroy();
 
-    const sge::IRect area = sge::IRect::from_corners(glm::vec2(0), glm::ivec2(width, height) + glm::ivec2(16));
+    const sge::IRect area = sge::IRect::from_corners(glm::vec2(0), glm::ivec2(width, height) + glm::ivec2(WORLD_PADDING));
     const sge::IRect playable_area = area.inset(-8);
 
     const int surface_level = playable_area.min.y;
-    const int underground_level = surface_level + 350;
-    const int cavern_level = underground_level + 130;
+    const int underground_level = surface_level + WORLD_UNDERGROUND_DEPTH;
+    const int cavern_level = surface_level + WORLD_CAVERN_DEPTH;
     const int dirt_height = 50;
 
     const Layers layers = {
@@ -676,39 +1207,353 @@ void world_generate(WorldData& world, uint32_t width, uint32_t height, uint32_t
     SGE_LOG_DEBUG("  Cavern: {}", layers.cavern);
     SGE_LOG_DEBUG("  Dirt Height: {}", layers.dirt_height);
 
-    world.blocks = new std::optional<Block>[static_cast<size_t>(area.width() * area.height())];
-    world.walls = new std::optional<Wall>[static_cast<size_t>(area.width() * area.height())];
+    const size_t tile_count = static_cast<size_t>(area.width()) * area.height();
+
+    world.blocks = new std::optional<Block>[tile_count];
+    world.walls = new std::optional<Wall>[tile_count];
     world.lightmap = LightMap(area.width(), area.height());
     world.playable_area = playable_area;
     world.area = area;
+    world.seed = seed;
+    world.origin_x = 0;
     world.layers = layers;
+}
 
-    world_generate_terrain(world);
+static uint32_t resolve_thread_count(uint32_t thread_count) {
+    return thread_count != 0 ? thread_count : std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+// The tile passes of world_generate_tiles, as counted by WorldGenProgress
+static constexpr uint32_t TILE_PASS_COUNT = 9;
+static_assert(WORLD_GEN_PASS_COUNT == TILE_PASS_COUNT + 2, "The autotiling and the lightmap follow the tile passes");
+
+static inline void begin_pass(WorldGenProgress* progress, const char* name) {
+    if (progress != nullptr) progress->pass.store(name, std::memory_order_relaxed);
+}
+
+static inline void end_pass(WorldGenProgress* progress) {
+    if (progress != nullptr) progress->passes_done.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename Func>
+static void timed_pass(std::vector<WorldGenPassTime>* pass_times, WorldGenProgress* progress, const char* name, const Func& func) {
+    begin_pass(progress, name);
+
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t tile_bytes = func();
+    if (pass_times != nullptr) {
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        pass_times->push_back({ .name = name, .time = elapsed.count(), .tile_bytes = tile_bytes });
+    }
+
+    end_pass(progress);
+}
+
+// Places the blocks and the walls, every pass but the autotiling and the lightmap
+static void world_generate_tiles(WorldData& world, const WorldGenOptions& options, uint32_t thread_count) {
+    const uint32_t seed = world.seed;
 
-    world_make_hills(world);
+    const auto pass = [&options](const char* name, const auto& func) {
+        timed_pass(options.pass_times, options.progress, name, func);
+    };
 
-    world_generate_walls(world);
+    // Runs the noise rules fused into one sweep, or one sweep per rule to measure the difference
+    const auto noise_pass = [&](const char* name, const std::vector<NoiseRule>& rules) {
+        if (options.fuse_noise_passes) {
+            pass(name, [&] { return world_sweep_noise_rules(world, rules.data(), rules.size(), thread_count); });
+        } else {
+            begin_pass(options.progress, name);
+            for (const NoiseRule& rule : rules) {
+                timed_pass(options.pass_times, nullptr, rule.name, [&] { return world_sweep_noise_rules(world, &rule, 1, thread_count); });
+            }
+            end_pass(options.progress);
+        }
+    };
 
-    world_rough_cavern_layer_border(world);
+    const auto serial_pass = [&](const char* name, const auto& func) {
+        pass(name, [&]() -> uint64_t { func(); return 0; });
+    };
 
-    world_big_caves(world, seed);
-    world_small_caves(world, seed);
+    serial_pass("terrain", [&] { world_generate_terrain(world); });
+    serial_pass("hills", [&] { world_make_hills(world); });
+    serial_pass("walls", [&] { world_generate_walls(world); });
+    serial_pass("cavern border", [&] { world_rough_cavern_layer_border(world); });
 
-    world_generate_dirt_in_rocks(world, seed);
+    // Every sweep is a barrier, the next one only starts once every band is done.
+    // Grassify flood fills across tiles, so the rocks in dirt can't join the first sweep.
+    std::vector<NoiseRule> rules;
+    world_big_caves(world, seed, rules);
+    world_small_caves(world, seed, rules);
+    world_generate_dirt_in_rocks(world, seed, rules);
+    noise_pass("caves and dirt", rules);
 
-    world_grassify(world);
+    serial_pass("grassify", [&] { world_grassify(world, options.scanline_flood_fills); });
 
-    world_generate_rocks_in_dirt(world, seed);
+    rules.clear();
+    world_generate_rocks_in_dirt(world, seed, rules);
+    noise_pass("rocks in dirt", rules);
 
-    world_remove_walls_from_surface(world);
+    serial_pass("surface walls", [&] { world_remove_walls_from_surface(world, options.scanline_flood_fills); });
+    serial_pass("trees", [&] { world_grow_trees(world); });
+}
 
-    world_grow_trees(world);
+void world_generate(WorldData& world, uint32_t width, uint32_t height, uint32_t seed, const WorldGenOptions& options) {
+    const uint32_t thread_count = resolve_thread_count(options.thread_count);
 
-    world_update_tile_sprite_index(world);
+    if (options.progress != nullptr) {
+        options.progress->passes_done.store(0, std::memory_order_relaxed);
+        options.progress->pass_count.store(WORLD_GEN_PASS_COUNT, std::memory_order_relaxed);
+    }
 
-    world_generate_lightmap(world);
+    world_init(world, width, height, seed);
+    world_generate_tiles(world, options, thread_count);
+
+    const auto serial_pass = [&](const char* name, const auto& func) {
+        timed_pass(options.pass_times, options.progress, name, [&]() -> uint64_t { func(); return 0; });
+    };
+
+    if (options.two_phase_autotile) {
+        serial_pass("autotile", [&] { world_update_tile_sprite_index(world, thread_count); });
+    } else {
+        serial_pass("autotile", [&] { world_update_tile_sprite_index_serial(world); });
+    }
+    serial_pass("lightmap", [&] { world_generate_lightmap(world); });
+
+    world.spawn_point = world_get_spawn_point(world);
+}
+
+// The union of the column ranges, either can be empty
+static sge::IRect merge_columns(const sge::IRect& a, const sge::IRect& b) {
+    if (a.width() <= 0) return b;
+    if (b.width() <= 0) return a;
+    return sge::IRect::from_corners(glm::min(a.min, b.min), glm::max(a.max, b.max));
+}
+
+void LazyWorldGenerator::init(WorldData& world, uint32_t width, uint32_t height, uint32_t seed, uint32_t thread_count, WorldGenProgress* progress) {
+    stop_background();
+
+    world_init(world, width, height, seed);
+
+    const uint32_t strip_count = (world.area.width() + STRIP_WIDTH - 1) / STRIP_WIDTH;
+
+    m_thread_count = resolve_thread_count(thread_count);
+    m_bounds = Bounds {
+        .area = world.area,
+        .playable_area = world.playable_area,
+        .layers = world.layers,
+        .seed = world.seed
+    };
+    m_generated.assign(strip_count, false);
+    m_claimed.assign(strip_count, false);
+    m_finished.clear();
+    m_stats = LazyWorldGenStats();
+
+    // The spawn point is the surface of the middle column, so its strip has to be there first
+    const int spawn_x = world.playable_area.min.x + world.playable_area.width() / 2;
+    const int from_x = spawn_x - SPAWN_RADIUS;
+    const int to_x = spawn_x + SPAWN_RADIUS;
+
+    m_focus_x.store(spawn_x, std::memory_order_relaxed);
+
+    if (progress != nullptr) {
+        const uint32_t spawn_strips = (to_x + STRIP_WIDTH - 1) / STRIP_WIDTH - std::max(from_x, 0) / STRIP_WIDTH;
+        // Every strip is autotiled after its tile passes, the lightmap is baked once
+        progress->passes_done.store(0, std::memory_order_relaxed);
+        progress->pass_count.store(spawn_strips * (TILE_PASS_COUNT + 1) + 1, std::memory_order_relaxed);
+    }
+
+    const sge::IRect area = generate_columns(world, from_x, to_x, progress);
+
+    timed_pass(nullptr, progress, "lightmap", [&]() -> uint64_t {
+        world.lightmap_init_area(area);
+        world.lightmap_blur_area_sync(area);
+        return 0;
+    });
 
     world.spawn_point = world_get_spawn_point(world);
+}
+
+sge::IRect LazyWorldGenerator::generate_columns(WorldData& world, int from_x, int to_x, WorldGenProgress* progress) {
+    const int first_strip = std::max(from_x, 0) / STRIP_WIDTH;
+    const int end_strip = std::min((std::max(to_x, 0) + STRIP_WIDTH - 1) / STRIP_WIDTH, static_cast<int>(m_generated.size()));
+
+    sge::IRect area;
+
+    for (int strip = first_strip; strip < end_strip; ++strip) {
+        if (m_generated[strip]) continue;
+
+        bool in_background;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            in_background = m_claimed[strip];
+            m_claimed[strip] = true;
+        }
+
+        if (in_background) {
+            // Nothing may see or edit the strip before it is there, so wait for the background thread to finish it
+            area = merge_columns(area, commit_strip(world, wait_for_strip(strip)));
+        } else {
+            area = merge_columns(area, commit_strip(world, generate_strip(strip, m_thread_count, progress)));
+        }
+    }
+
+    return area;
+}
+
+LazyWorldGenerator::Strip LazyWorldGenerator::wait_for_strip(int strip) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // The background thread always finishes the strip it has claimed, even when it is stopped
+    std::vector<Strip>::iterator it;
+    m_strip_finished.wait(lock, [&] {
+        it = std::find_if(m_finished.begin(), m_finished.end(), [strip](const Strip& finished) { return finished.index == strip; });
+        return it != m_finished.end();
+    });
+
+    Strip result = std::move(*it);
+    m_finished.erase(it);
+
+    m_stats.waited_strips++;
+
+    return result;
+}
+
+void LazyWorldGenerator::start_background() {
+    if (m_background.joinable()) return;
+
+    m_stop.store(false);
+    m_background = std::thread(&LazyWorldGenerator::background_loop, this);
+}
 
-    srand(time(nullptr));
-};
\ No newline at end of file
+void LazyWorldGenerator::stop_background() {
+    m_stop.store(true);
+    if (m_background.joinable()) m_background.join();
+}
+
+sge::IRect LazyWorldGenerator::commit_background(WorldData& world) {
+    std::vector<Strip> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finished.swap(m_finished);
+    }
+
+    sge::IRect area;
+    for (const Strip& strip : finished) {
+        area = merge_columns(area, commit_strip(world, strip));
+    }
+    return area;
+}
+
+void LazyWorldGenerator::background_loop() {
+    const int strip_count = static_cast<int>(m_claimed.size());
+
+    while (!m_stop.load()) {
+        int strip = -1;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            const int focus = std::clamp(m_focus_x.load(std::memory_order_relaxed) / STRIP_WIDTH, 0, strip_count - 1);
+
+            // The closest strip nobody has claimed yet
+            for (int distance = 0; distance < strip_count && strip < 0; ++distance) {
+                if (focus - distance >= 0 && !m_claimed[focus - distance]) {
+                    strip = focus - distance;
+                } else if (focus + distance < strip_count && !m_claimed[focus + distance]) {
+                    strip = focus + distance;
+                }
+            }
+
+            if (strip < 0) return;
+
+            m_claimed[strip] = true;
+        }
+
+        Strip result = generate_strip(strip, BACKGROUND_THREAD_COUNT, nullptr);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished.push_back(std::move(result));
+        }
+        m_strip_finished.notify_all();
+    }
+}
+
+LazyWorldGenerator::Strip LazyWorldGenerator::generate_strip(int strip, uint32_t thread_count, WorldGenProgress* progress) const {
+    const auto start = std::chrono::steady_clock::now();
+
+    const int width = m_bounds.area.width();
+    const int height = m_bounds.area.height();
+
+    const int strip_from = strip * STRIP_WIDTH;
+    const int strip_to = std::min(strip_from + STRIP_WIDTH, width);
+
+    // The scratch world is the strip with its halo, addressed from its left edge
+    const int from_x = std::max(strip_from - HALO, 0);
+    const int to_x = std::min(strip_to + HALO, width);
+    const int scratch_width = to_x - from_x;
+    const glm::ivec2 origin = glm::ivec2(from_x, 0);
+
+    WorldData scratch;
+    scratch.area = sge::IRect::from_corners(glm::ivec2(0), glm::ivec2(scratch_width, height));
+    scratch.playable_area = sge::IRect::from_corners(m_bounds.playable_area.min - origin, m_bounds.playable_area.max - origin);
+    scratch.layers = m_bounds.layers;
+    scratch.seed = m_bounds.seed;
+    scratch.origin_x = from_x;
+    scratch.blocks = new std::optional<Block>[static_cast<size_t>(scratch_width) * height];
+    scratch.walls = new std::optional<Wall>[static_cast<size_t>(scratch_width) * height];
+
+    world_generate_tiles(scratch, { .thread_count = thread_count, .progress = progress }, thread_count);
+
+    // The halo holds the neighbors of the strip, so its sprites are the same as if the whole world was autotiled
+    // and the strip doesn't depend on the strips generated before it
+    timed_pass(nullptr, progress, "autotile", [&]() -> uint64_t {
+        world_update_tile_sprite_index(scratch, thread_count);
+        return 0;
+    });
+
+    const int count = strip_to - strip_from;
+
+    Strip result = {
+        .index = strip,
+        .blocks = std::vector<std::optional<Block>>(static_cast<size_t>(count) * height),
+        .walls = std::vector<std::optional<Wall>>(static_cast<size_t>(count) * height),
+        .time = 0.0
+    };
+
+    for (int y = 0; y < height; ++y) {
+        const size_t scratch_index = static_cast<size_t>(y) * scratch_width + (strip_from - from_x);
+        const size_t index = static_cast<size_t>(y) * count;
+
+        std::copy_n(scratch.blocks + scratch_index, count, result.blocks.begin() + index);
+        std::copy_n(scratch.walls + scratch_index, count, result.walls.begin() + index);
+    }
+
+    result.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return result;
+}
+
+sge::IRect LazyWorldGenerator::commit_strip(WorldData& world, const Strip& strip) {
+    const int width = world.area.width();
+    const int height = world.area.height();
+
+    const int strip_from = strip.index * STRIP_WIDTH;
+    const int count = std::min(strip_from + STRIP_WIDTH, width) - strip_from;
+
+    for (int y = 0; y < height; ++y) {
+        const size_t strip_index = static_cast<size_t>(y) * count;
+        const size_t index = static_cast<size_t>(y) * width + strip_from;
+
+        std::copy_n(strip.blocks.begin() + strip_index, count, world.blocks + index);
+        std::copy_n(strip.walls.begin() + strip_index, count, world.walls + index);
+    }
+
+    m_generated[strip.index] = true;
+
+    m_stats.strips++;
+    m_stats.total_time += strip.time;
+    m_stats.max_time = std::max(m_stats.max_time, strip.time);
+
+    return sge::IRect::from_corners(glm::ivec2(strip_from, 0), glm::ivec2(strip_from + count, height));
+}
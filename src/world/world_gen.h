@@ -3,8 +3,204 @@
 #ifndef WORLD_WORLD_GEN_H_
 #define WORLD_WORLD_GEN_H_
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
 #include "world_data.hpp"
 
-void world_generate(WorldData& world, uint32_t width, uint32_t height, uint32_t seed);
+struct WorldGenPassTime {
+    const char* name;
+    // In seconds
+    double time;
+    // How many bytes of the block array the noise sweeps streamed, 0 for the other passes
+    uint64_t tile_bytes = 0;
+};
+
+// The progress of a generation running on another thread. Only the generating thread writes it.
+struct WorldGenProgress {
+    // The pass being run, null before the first one
+    std::atomic<const char*> pass = nullptr;
+    std::atomic<uint32_t> passes_done = 0;
+    // Set before the first pass
+    std::atomic<uint32_t> pass_count = 0;
+
+    // From 0 to 1
+    [[nodiscard]]
+    inline float fraction() const noexcept {
+        const uint32_t count = pass_count.load(std::memory_order_relaxed);
+        if (count == 0) return 0.0f;
+        return std::min(static_cast<float>(passes_done.load(std::memory_order_relaxed)) / count, 1.0f);
+    }
+};
+
+// The passes world_generate reports to WorldGenProgress. The noise sweeps count as one pass each, fused or not.
+inline constexpr uint32_t WORLD_GEN_PASS_COUNT = 11;
+
+struct WorldGenOptions {
+    // The noise passes are split into bands of rows across this many threads, 0 uses every hardware thread
+    uint32_t thread_count = 0;
+    // Apply the noise passes without cross-tile dependencies in a single sweep.
+    // Only turned off to measure the difference, the world is the same either way.
+    bool fuse_noise_passes = true;
+    // Do the grassify and surface wall flood fills a span at a time on bitmaps instead of a tile at a time.
+    // Only turned off to measure the difference, the world is the same either way.
+    bool scanline_flood_fills = true;
+    // Autotile the whole world in parallel from precomputed neighbor masks instead of two serial sweeps.
+    // Only turned off to measure the difference, the world is the same either way.
+    bool two_phase_autotile = true;
+    // If not null, the duration of every pass is appended to it
+    std::vector<WorldGenPassTime>* pass_times = nullptr;
+    // If not null, updated as the passes finish
+    WorldGenProgress* progress = nullptr;
+};
+
+// The underground and the cavern layers are at fixed depths below the surface
+inline constexpr int WORLD_UNDERGROUND_DEPTH = 350;
+inline constexpr int WORLD_CAVERN_DEPTH = WORLD_UNDERGROUND_DEPTH + 130;
+
+// The cavern layer is the deepest one the passes write to, so it has to be inside the world
+inline constexpr uint32_t WORLD_MIN_HEIGHT = WORLD_CAVERN_DEPTH + 1;
+
+// Whether a world of that size can be generated and every tile and light of it can be addressed.
+// The sizes passed to world_generate and LazyWorldGenerator::init must pass it.
+[[nodiscard]]
+bool world_size_is_valid(uint32_t width, uint32_t height);
+
+// The result is the same for every thread count.
+void world_generate(WorldData& world, uint32_t width, uint32_t height, uint32_t seed, const WorldGenOptions& options = {});
+
+struct LazyWorldGenStats {
+    uint32_t strips = 0;
+    // The visible strips that were still being generated by the background thread and had to be waited for
+    uint32_t waited_strips = 0;
+    // In seconds
+    double total_time = 0.0;
+    double max_time = 0.0;
+};
+
+// Generates the world a strip of columns at a time, the first time the strip is needed, instead of all at once.
+// A strip is generated in a scratch world that reaches HALO columns past both of its sides and only the strip itself
+// is copied into the world, so the strips don't depend on the order they are generated in.
+// The strip is autotiled in the scratch world too, since the halo holds all of its neighbors.
+// The passes without cross-tile dependencies place the same tiles as world_generate. The flood fills and the trees
+// only see the halo, so where a cave carries a flood fill further than that, the strip can differ from world_generate.
+class LazyWorldGenerator {
+public:
+    static constexpr int STRIP_WIDTH = 256;
+    // Wider than the cone the surface walls are removed in, which is at most 80 columns to either side of the start
+    static constexpr int HALO = 128;
+    // How far the strips generated by init reach to either side of the spawn point
+    static constexpr int SPAWN_RADIUS = STRIP_WIDTH;
+    // The threads the background thread generates a strip with. The game and the mesh workers run next to it,
+    // so it doesn't take every hardware thread like the strips the game waits for.
+    static constexpr uint32_t BACKGROUND_THREAD_COUNT = 1;
+
+    LazyWorldGenerator() = default;
+    LazyWorldGenerator(const LazyWorldGenerator&) = delete;
+    LazyWorldGenerator& operator=(const LazyWorldGenerator&) = delete;
+
+    ~LazyWorldGenerator() {
+        stop_background();
+    }
+
+    // Allocates the world, generates the strips around the spawn point and bakes their lightmap.
+    // If `progress` isn't null, it follows the passes of every strip.
+    void init(WorldData& world, uint32_t width, uint32_t height, uint32_t seed, uint32_t thread_count = 0, WorldGenProgress* progress = nullptr);
+
+    // Generates the strips overlapping the columns [from_x, to_x) that aren't generated yet.
+    // Returns the columns of the generated strips over the whole height, empty if there were none.
+    // The lightmap of those tiles is left to the caller.
+    // Waits for the strips the background thread is generating and commits them too.
+    inline sge::IRect generate_columns(WorldData& world, int from_x, int to_x) {
+        return generate_columns(world, from_x, to_x, nullptr);
+    }
+
+    // Generates the remaining strips on a background thread with BACKGROUND_THREAD_COUNT threads, the closest to the focus first.
+    // The world isn't read there, the strips are copied into it by commit_background.
+    void start_background();
+    void stop_background();
+
+    [[nodiscard]]
+    inline bool is_background_running() const noexcept {
+        return m_background.joinable();
+    }
+
+    // Copies the strips the background thread has finished into the world.
+    // Returns their columns like generate_columns.
+    sge::IRect commit_background(WorldData& world);
+
+    // The column the background thread generates the strips around, usually the center of the camera
+    inline void set_focus(int x) noexcept {
+        m_focus_x.store(x, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]]
+    inline bool is_generated(int x) const noexcept {
+        const int strip = x / STRIP_WIDTH;
+        return x >= 0 && strip < static_cast<int>(m_generated.size()) && m_generated[strip];
+    }
+
+    [[nodiscard]]
+    inline const LazyWorldGenStats& stats() const noexcept {
+        return m_stats;
+    }
+
+    // How many strips the world is split into
+    [[nodiscard]]
+    inline uint32_t strip_count() const noexcept {
+        return m_generated.size();
+    }
+
+private:
+    // A strip generated outside of the world
+    struct Strip {
+        int index;
+        std::vector<std::optional<Block>> blocks;
+        std::vector<std::optional<Wall>> walls;
+        // In seconds
+        double time;
+    };
+
+    // What a strip is generated from, copied so the background thread doesn't read the world
+    struct Bounds {
+        sge::IRect area;
+        sge::IRect playable_area;
+        Layers layers;
+        uint32_t seed;
+    };
+
+    sge::IRect generate_columns(WorldData& world, int from_x, int to_x, WorldGenProgress* progress);
+
+    // Takes the strip the background thread has claimed out of m_finished once it's there
+    Strip wait_for_strip(int strip);
+
+    Strip generate_strip(int strip, uint32_t thread_count, WorldGenProgress* progress) const;
+    sge::IRect commit_strip(WorldData& world, const Strip& strip);
+
+    void background_loop();
+
+private:
+    std::vector<bool> m_generated;
+    LazyWorldGenStats m_stats;
+    Bounds m_bounds;
+    uint32_t m_thread_count = 1;
+
+    // Guards m_claimed and m_finished
+    std::mutex m_mutex;
+    // The strips that are being generated or are generated already, by either thread
+    std::vector<bool> m_claimed;
+    std::vector<Strip> m_finished;
+    // Notified when the background thread adds a strip to m_finished
+    std::condition_variable m_strip_finished;
+    std::thread m_background;
+    std::atomic<bool> m_stop = false;
+    std::atomic<int> m_focus_x = 0;
+};
 
 #endif
\ No newline at end of file